@@ -1,12 +1,21 @@
 #pragma once
 #include <windows.h>
 
+#include <memory>
+#include <string>
+#include <unordered_map>
+
 namespace overlay {
 namespace core {
 
 struct Client {
+  std::string id;
   DWORD process_id;
 };
 
+// Clients are immutable once registered so they can be shared without locking
+typedef std::unordered_map<std::string, std::shared_ptr<const Client>>
+    ClientsMap;
+
 }  // namespace core
 }  // namespace overlay
\ No newline at end of file
@@ -4,6 +4,8 @@
 
 #include <loguru/loguru.hpp>
 
+#include "utils/timestamp.h"
+
 namespace overlay {
 namespace core {
 
@@ -22,21 +24,50 @@ void Core::MainThread() {
   LOG_SCOPE_F(INFO, "Initializing overlay");
 #endif
 
+  uint64_t start_timestamp = utils::timestamp::GetTimestamp();
+  uint64_t phase_timestamp = start_timestamp;
+
+  // Logs the time that passed since the previous phase ended
+  auto end_phase = [&phase_timestamp](const char *phase) {
+    uint64_t timestamp = utils::timestamp::GetTimestamp();
+
+    DLOG_F(INFO, "Startup phase '%s' took %.3f ms.", phase,
+           (timestamp - phase_timestamp) / 1000.0);
+    phase_timestamp = timestamp;
+  };
+
+  // Start the RPC server in the background so the hooks won't wait for it,
+  // the events service is only published to the hooks once it's running
+  std::thread rpc_server_thread([this]() {
+#ifdef DEBUG
+    loguru::set_thread_name("rpc server start");
+#endif
+
+    rpc_server_.Start();
+  });
+
   // Init MinHook
   MH_Initialize();
+  end_phase("MinHook");
 
   // Hook graphics
   if (!graphics_manager_.Hook()) {
     DLOG_F(ERROR, "Unable to hook graphics!");
   }
+  end_phase("Graphics hooks");
 
   // Hook input
   if (!input_manager_.Hook()) {
     DLOG_F(ERROR, "Unable to hook input!");
   }
+  end_phase("Input hooks");
 
-  // Start the RPC server
-  rpc_server_.Start();
+  // Wait for the RPC server to start
+  rpc_server_thread.join();
+  end_phase("RPC server (remaining)");
+
+  DLOG_F(INFO, "Overlay started in %.3f ms.",
+         (phase_timestamp - start_timestamp) / 1000.0);
 }
 
 bool Core::HookWindow(HWND window) { return input_manager_.HookWindow(window); }
@@ -71,5 +102,7 @@ input::InputManager *Core::get_input_manager() { return &input_manager_; }
 
 ipc::RpcServer *Core::get_rpc_server() { return &rpc_server_; }
 
+utils::Scheduler *Core::get_scheduler() { return &scheduler_; }
+
 }  // namespace core
 }  // namespace overlay
@@ -5,6 +5,7 @@
 #include "graphics/graphics_manager.h"
 #include "input/input_manager.h"
 #include "ipc/rpc_server.h"
+#include "utils/scheduler.h"
 #include "utils/singleton.h"
 
 namespace overlay {
@@ -27,6 +28,7 @@ class Core : public utils::Singleton<Core> {
   graphics::GraphicsManager *get_graphics_manager();
   input::InputManager *get_input_manager();
   ipc::RpcServer *get_rpc_server();
+  utils::Scheduler *get_scheduler();
 
  private:
   HINSTANCE instance_;
@@ -36,6 +38,8 @@ class Core : public utils::Singleton<Core> {
   HWND inject_window_;
   HWND graphics_window_;
 
+  utils::Scheduler scheduler_;
+
   ipc::RpcServer rpc_server_;
 
   graphics::GraphicsManager graphics_manager_;
@@ -0,0 +1,88 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+
+namespace overlay {
+namespace core {
+namespace graphics {
+namespace blend {
+
+enum class BlendMode {
+  Opaque,        // The source replaces the destination
+  UniformAlpha,  // An opaque source blended with a single alpha
+  PerPixelAlpha  // The source's alpha multiplied by a single alpha
+};
+
+// Converts an opacity to the alpha the sprites are drawn with
+inline uint32_t OpacityToAlpha(double opacity) {
+  if (opacity <= 0) {
+    return 0;
+  } else if (opacity >= 1) {
+    return 0xff;
+  }
+
+  return (uint32_t)(opacity * 0xff + 0.5);
+}
+
+// Blends a pixel with a 0-256 alpha. All of the channels are blended with the
+// source's alpha and its inverse, just like the GPU blends the sprites, with
+// the red and blue channels and the alpha and green channels in parallel
+inline uint32_t BlendPixel(uint32_t destination, uint32_t source,
+                           uint32_t alpha) {
+  uint32_t inverse_alpha = 256 - alpha;
+
+  uint32_t red_blue = (((source & 0x00ff00ff) * alpha +
+                        (destination & 0x00ff00ff) * inverse_alpha) >>
+                       8) &
+                      0x00ff00ff;
+  uint32_t alpha_green = (((source >> 8) & 0x00ff00ff) * alpha +
+                          ((destination >> 8) & 0x00ff00ff) * inverse_alpha) &
+                         0xff00ff00;
+
+  return red_blue | alpha_green;
+}
+
+// Blends a row of A8R8G8B8 pixels over the destination. The blend mode is a
+// template argument so that each kernel's loop has no per-pixel branches on
+// the mode and can be vectorized by the compiler
+template <BlendMode mode>
+inline void BlendRow(uint32_t *destination, const uint32_t *source,
+                     size_t pixels, uint32_t alpha);
+
+template <>
+inline void BlendRow<BlendMode::Opaque>(uint32_t *destination,
+                                        const uint32_t *source, size_t pixels,
+                                        uint32_t alpha) {
+  memcpy(destination, source, pixels * sizeof(uint32_t));
+}
+
+template <>
+inline void BlendRow<BlendMode::UniformAlpha>(uint32_t *destination,
+                                              const uint32_t *source,
+                                              size_t pixels, uint32_t alpha) {
+  // Scale the alpha to 0-256 so that the division is a shift
+  alpha += alpha >> 7;
+
+  for (size_t i = 0; i < pixels; i++) {
+    destination[i] = BlendPixel(destination[i], source[i] | 0xff000000, alpha);
+  }
+}
+
+template <>
+inline void BlendRow<BlendMode::PerPixelAlpha>(uint32_t *destination,
+                                               const uint32_t *source,
+                                               size_t pixels, uint32_t alpha) {
+  uint32_t pixel_alpha = 0;
+
+  for (size_t i = 0; i < pixels; i++) {
+    pixel_alpha = ((source[i] >> 24) * alpha + 0x80) * 0x101 >> 16;
+    pixel_alpha += pixel_alpha >> 7;
+
+    destination[i] = BlendPixel(destination[i], source[i], pixel_alpha);
+  }
+}
+
+}  // namespace blend
+}  // namespace graphics
+}  // namespace core
+}  // namespace overlay
@@ -247,7 +247,13 @@ void Dx9Hook::BeforePresent(IDirect3DDevice9 *device) {
   }
 
   Core::Get()->get_graphics_manager()->Render();
-  Core::Get()->get_graphics_manager()->get_stats_calculator()->Frame();
+}
+
+void Dx9Hook::AfterPresent(HRESULT result) {
+  if (graphics_initiated_) {
+    Core::Get()->get_graphics_manager()->OnPresent(result ==
+                                                   S_PRESENT_OCCLUDED);
+  }
 }
 
 void Dx9Hook::OnReset(IDirect3DDevice9 *device,
@@ -299,6 +305,8 @@ HRESULT Dx9Hook::DevicePresentHook(IDirect3DDevice9 *device,
   ret = present_hook_.get_trampoline().CallStdMethod<HRESULT>(
       device, source_rect, dest_rect, dest_window_override, dirty_region);
 
+  AfterPresent(ret);
+
   return ret;
 }
 
@@ -323,6 +331,8 @@ HRESULT Dx9Hook::SwapChainPresentHook(IDirect3DSwapChain9 *swap_chain,
       swap_chain, source_rect, dest_rect, dest_window_override, dirty_region,
       flags);
 
+  AfterPresent(ret);
+
   return ret;
 }
 
@@ -351,6 +361,8 @@ HRESULT Dx9Hook::DevicePresentExHook(IDirect3DDevice9Ex *device,
       device, source_rect, dest_rect, dest_window_override, dirty_region,
       flags);
 
+  AfterPresent(ret);
+
   return ret;
 }
 
@@ -36,6 +36,7 @@ class Dx9Hook : public IGraphicsHook {
   bool InitGraphics(IDirect3DDevice9 *device);
 
   void BeforePresent(IDirect3DDevice9 *device);
+  void AfterPresent(HRESULT result);
   void OnReset(IDirect3DDevice9 *device,
                D3DPRESENT_PARAMETERS *presentation_parameters);
 
@@ -1,7 +1,12 @@
 #include "dx9_renderer.h"
 
+#include <algorithm>
 #include <loguru/loguru.hpp>
 
+#include "blend.h"
+#include "core.h"
+#include "utils/timestamp.h"
+
 namespace overlay {
 namespace core {
 namespace graphics {
@@ -9,7 +14,8 @@ namespace graphics {
 Dx9Renderer::Dx9Renderer(IDirect3DDevice9 *device)
     : d3dx9_module_(LoadLibraryA("d3dx9_43.dll")),
       device_(device),
-      sprite_drawer_(nullptr) {}
+      sprite_drawer_(nullptr),
+      remaining_upload_budget_(0) {}
 
 Dx9Renderer::~Dx9Renderer() {
   if (d3dx9_module_) {
@@ -63,19 +69,15 @@ bool Dx9Renderer::Init() {
   return true;
 }
 
-IDirect3DTexture9 *Dx9Renderer::CreateTextureFromSolidColor(Rect rect,
-                                                            Color color) {
+IDirect3DTexture9 *Dx9Renderer::CreateTextureFromSolidColor(Color color) {
   IDirect3DTexture9 *sprite_texture = nullptr;
 
   uint32_t rgba_color = ((uint32_t)0xff << 24) + ((uint32_t)color.red << 16) +
                         ((uint32_t)color.green << 8) + color.blue;
-  std::string buffer;
+  std::string buffer((const char *)&rgba_color, sizeof(rgba_color));
 
-  // Create buffer with the color
-  buffer.resize(rect.width * rect.height * sizeof(uint32_t));
-  for (size_t i = 0; i < rect.width * rect.height; i++) {
-    *((uint32_t *)buffer.data() + i) = rgba_color;
-  }
+  // A single pixel is enough since the texture is scaled to the sprite's rect
+  Rect rect = {1, 1, 0, 0};
 
   // Create the texture
   if (FAILED(device_->CreateTexture((UINT)rect.width, (UINT)rect.height, 1,
@@ -93,29 +95,24 @@ IDirect3DTexture9 *Dx9Renderer::CreateTextureFromSolidColor(Rect rect,
   return sprite_texture;
 }
 
-IDirect3DTexture9 *Dx9Renderer::CreateTextureFromBuffer(Rect rect,
-                                                        std::string &buffer) {
-  IDirect3DTexture9 *sprite_texture = nullptr;
+IDirect3DTexture9 *Dx9Renderer::CreateTexture(uint32_t width, uint32_t height,
+                                              D3DPOOL pool, bool mipmaps) {
+  IDirect3DTexture9 *texture = nullptr;
 
-  // Verify buffer size
-  if (buffer.size() != (rect.width * rect.height * sizeof(uint32_t))) {
-    return nullptr;
-  }
-
-  // Create the texture
-  if (FAILED(device_->CreateTexture((UINT)rect.width, (UINT)rect.height, 1,
-                                    D3DUSAGE_DYNAMIC, D3DFMT_A8R8G8B8,
-                                    D3DPOOL_DEFAULT, &sprite_texture, 0))) {
-    return nullptr;
+  // Let the GPU generate the downscaled levels so that windows which are
+  // drawn smaller than their buffer are filtered properly
+  if (mipmaps && SUCCEEDED(device_->CreateTexture(
+                     (UINT)width, (UINT)height, 0, D3DUSAGE_AUTOGENMIPMAP,
+                     D3DFMT_A8R8G8B8, pool, &texture, 0))) {
+    return texture;
   }
 
-  // Copy the buffer data to the texture
-  if (!CopyBufferToTexture(sprite_texture, rect, buffer)) {
-    sprite_texture->Release();
+  if (FAILED(device_->CreateTexture((UINT)width, (UINT)height, 1, 0,
+                                    D3DFMT_A8R8G8B8, pool, &texture, 0))) {
     return nullptr;
   }
 
-  return sprite_texture;
+  return texture;
 }
 
 bool Dx9Renderer::CopyBufferToTexture(IDirect3DTexture9 *texture, Rect rect,
@@ -142,23 +139,111 @@ bool Dx9Renderer::CopyBufferToTexture(IDirect3DTexture9 *texture, Rect rect,
   return true;
 }
 
+void Dx9Renderer::StageBuffer(const std::shared_ptr<Sprite> &sprite,
+                              RenderStats &render_stats) {
+  size_t row_size = sprite->texture_width * sizeof(uint32_t);
+  size_t rows = 0;
+
+  D3DLOCKED_RECT staging_rect;
+  RECT lock_rect;
+
+  // Start uploading the new buffer
+  if (!sprite->uploading) {
+    sprite->uploading = true;
+    sprite->staged_rows = 0;
+    sprite->buffer_updated = false;
+  }
+
+  // The budget of the frame was used by other sprites
+  if (remaining_upload_budget_ <= 0) {
+    return;
+  }
+
+  // Create the staging texture on the first upload
+  if (sprite->staging_texture == nullptr &&
+      (sprite->staging_texture =
+           CreateTexture(sprite->texture_width, sprite->texture_height,
+                         D3DPOOL_SYSTEMMEM, false)) == nullptr) {
+    sprite->uploading = false;
+    return;
+  }
+
+  // Copy as many rows as the budget allows, at least a single row so buffers
+  // larger than the budget still progress
+  rows = std::min<size_t>(
+      sprite->texture_height - sprite->staged_rows,
+      std::max<size_t>((size_t)(remaining_upload_budget_ / row_size), 1));
+
+  lock_rect = {0, (LONG)sprite->staged_rows, (LONG)sprite->texture_width,
+               (LONG)(sprite->staged_rows + rows)};
+  if (FAILED(((IDirect3DTexture9 *)sprite->staging_texture)
+                 ->LockRect(0, &staging_rect, &lock_rect, 0))) {
+    sprite->uploading = false;
+    return;
+  }
+
+  for (size_t row = 0; row < rows; row++) {
+    memcpy((uint8_t *)staging_rect.pBits + row * staging_rect.Pitch,
+           sprite->buffer.data() + (sprite->staged_rows + row) * row_size,
+           row_size);
+  }
+
+  ((IDirect3DTexture9 *)sprite->staging_texture)->UnlockRect(0);
+
+  sprite->staged_rows += rows;
+  remaining_upload_budget_ -= rows * row_size;
+  render_stats.uploaded_bytes += rows * row_size;
+
+  // Copy the complete buffer to the texture in the GPU
+  if (sprite->staged_rows == sprite->texture_height) {
+    sprite->uploading = false;
+    sprite->texture_ready = SUCCEEDED(device_->UpdateTexture(
+        (IDirect3DTexture9 *)sprite->staging_texture,
+        (IDirect3DTexture9 *)sprite->texture));
+    ((IDirect3DTexture9 *)sprite->texture)->GenerateMipSubLevels();
+  }
+}
+
 void Dx9Renderer::RenderSprites(
-    const std::vector<std::shared_ptr<Sprite>> &sprites) {
+    const std::vector<std::shared_ptr<Sprite>> &sprites,
+    RenderStats &render_stats) {
+  uint64_t start_timestamp =
+      render_stats.measured ? utils::timestamp::GetTimestamp() : 0;
+
+  uint64_t upload_budget =
+      Core::Get()->get_graphics_manager()->get_upload_budget();
+
   // Release old textures
   ReleaseTextures();
 
+  // A budget of 0 doesn't limit the uploads
+  remaining_upload_budget_ = upload_budget ? upload_budget : INT64_MAX;
+
   // Start rendering
   device_->BeginScene();
   sprite_drawer_->Begin(D3DXSPRITE_ALPHABLEND);
 
+  // Filter the scaled sprites, the sprite drawer restores the game's states
+  device_->SetSamplerState(0, D3DSAMP_MINFILTER, D3DTEXF_LINEAR);
+  device_->SetSamplerState(0, D3DSAMP_MAGFILTER, D3DTEXF_LINEAR);
+  device_->SetSamplerState(0, D3DSAMP_MIPFILTER, D3DTEXF_LINEAR);
+
   // Draw sprites
   for (const auto &sprite : sprites) {
-    DrawSprite(sprite);
+    DrawSprite(sprite, render_stats);
   }
 
   // End rendering
   sprite_drawer_->End();
   device_->EndScene();
+
+  // Everything that isn't creating or uploading textures is drawing
+  if (render_stats.measured) {
+    render_stats.draw_time = utils::timestamp::GetTimestamp() -
+                             start_timestamp -
+                             render_stats.texture_creation_time -
+                             render_stats.upload_time;
+  }
 }
 
 void Dx9Renderer::OnResize(uint32_t width, uint32_t height, bool fullscreen) {
@@ -177,7 +262,10 @@ void Dx9Renderer::OnResize(uint32_t width, uint32_t height, bool fullscreen) {
   }
 }
 
-void Dx9Renderer::DrawSprite(const std::shared_ptr<Sprite> &sprite) {
+void Dx9Renderer::DrawSprite(const std::shared_ptr<Sprite> &sprite,
+                             RenderStats &render_stats) {
+  uint64_t start_timestamp = 0;
+
   if (sprite == nullptr || sprite->opacity == 0) {
     return;
   }
@@ -186,31 +274,67 @@ void Dx9Renderer::DrawSprite(const std::shared_ptr<Sprite> &sprite) {
     sprite->rect = TargetFillRect();
   }
 
-  D3DXVECTOR3 sprite_pos((FLOAT)sprite->rect.x, (FLOAT)sprite->rect.y, 0);
-  RECT sprite_rect = {0, 0, (LONG)sprite->rect.width,
-                      (LONG)sprite->rect.height};
+  // Recreate the texture if the resolution of the buffer changed
+  if (sprite->texture != nullptr && !sprite->solid_color &&
+      (sprite->texture_width != sprite->buffer_width ||
+       sprite->texture_height != sprite->buffer_height)) {
+    sprite->FreeTexture();
+  }
 
   // Create texture if needed
   if (sprite->texture == nullptr) {
+    start_timestamp = utils::timestamp::GetTimestamp();
+
     if (sprite->solid_color) {
-      sprite->texture =
-          CreateTextureFromSolidColor(sprite->rect, sprite->color);
-    } else {
-      sprite->texture = CreateTextureFromBuffer(sprite->rect, sprite->buffer);
+      sprite->texture = CreateTextureFromSolidColor(sprite->color);
+      sprite->texture_width = 1;
+      sprite->texture_height = 1;
+      sprite->texture_ready = sprite->texture != nullptr;
+    } else if (sprite->buffer_width && sprite->buffer_height &&
+               sprite->buffer.size() == ((size_t)sprite->buffer_width *
+                                         sprite->buffer_height *
+                                         sizeof(uint32_t))) {
+      // The buffer is staged into the new texture
+      sprite->texture = CreateTexture(sprite->buffer_width,
+                                      sprite->buffer_height, D3DPOOL_DEFAULT,
+                                      true);
+      sprite->texture_width = sprite->buffer_width;
+      sprite->texture_height = sprite->buffer_height;
+      sprite->buffer_updated = true;
     }
-  } else if (!sprite->solid_color && sprite->buffer_updated &&
-             (sprite->buffer.size() ==
-              (sprite->rect.width * sprite->rect.height * sizeof(uint32_t)))) {
-    CopyBufferToTexture((IDirect3DTexture9 *)sprite->texture, sprite->rect,
-                        sprite->buffer);
-    sprite->buffer_updated = false;
+
+    render_stats.texture_creation_time +=
+        utils::timestamp::GetTimestamp() - start_timestamp;
+    if (sprite->texture != nullptr) {
+      render_stats.created_textures++;
+    }
+  }
+
+  // Upload the new buffer or continue uploading the current buffer
+  if (!sprite->solid_color && sprite->texture != nullptr &&
+      (sprite->uploading || sprite->buffer_updated)) {
+    start_timestamp = utils::timestamp::GetTimestamp();
+
+    StageBuffer(sprite, render_stats);
+
+    render_stats.upload_time +=
+        utils::timestamp::GetTimestamp() - start_timestamp;
   }
 
-  // Draw the sprite
-  if (sprite->texture != nullptr) {
+  // Draw the sprite, scaling the texture to the sprite's rect
+  if (sprite->texture != nullptr && sprite->texture_ready) {
+    D3DXMATRIX transform(
+        (FLOAT)sprite->rect.width / sprite->texture_width, 0, 0, 0, 0,
+        (FLOAT)sprite->rect.height / sprite->texture_height, 0, 0, 0, 0, 1, 0,
+        (FLOAT)sprite->rect.x, (FLOAT)sprite->rect.y, 0, 1);
+    RECT texture_rect = {0, 0, (LONG)sprite->texture_width,
+                         (LONG)sprite->texture_height};
+
+    sprite_drawer_->SetTransform(&transform);
     sprite_drawer_->Draw(
-        (IDirect3DTexture9 *)sprite->texture, &sprite_rect, NULL, &sprite_pos,
-        0x00ffffff + ((uint32_t)(sprite->opacity * 0xff) << 24));
+        (IDirect3DTexture9 *)sprite->texture, &texture_rect, NULL, NULL,
+        0x00ffffff + (blend::OpacityToAlpha(sprite->opacity) << 24));
+    render_stats.drawn_sprites++;
   }
 }
 
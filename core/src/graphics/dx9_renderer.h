@@ -19,7 +19,8 @@ class Dx9Renderer : public IGraphicsRenderer {
 
   virtual bool Init();
   virtual void RenderSprites(
-      const std::vector<std::shared_ptr<Sprite>> &sprites);
+      const std::vector<std::shared_ptr<Sprite>> &sprites,
+      RenderStats &render_stats);
 
   virtual void OnResize(uint32_t width, uint32_t height, bool fullscreen);
 
@@ -29,10 +30,17 @@ class Dx9Renderer : public IGraphicsRenderer {
   IDirect3DDevice9 *device_;
   ID3DXSprite *sprite_drawer_;
 
-  void DrawSprite(const std::shared_ptr<Sprite> &sprite);
+  // Bytes that can still be uploaded in the current frame
+  int64_t remaining_upload_budget_;
 
-  IDirect3DTexture9 *CreateTextureFromSolidColor(Rect rect, Color color);
-  IDirect3DTexture9 *CreateTextureFromBuffer(Rect rect, std::string &buffer);
+  void DrawSprite(const std::shared_ptr<Sprite> &sprite,
+                  RenderStats &render_stats);
+  void StageBuffer(const std::shared_ptr<Sprite> &sprite,
+                   RenderStats &render_stats);
+
+  IDirect3DTexture9 *CreateTextureFromSolidColor(Color color);
+  IDirect3DTexture9 *CreateTexture(uint32_t width, uint32_t height,
+                                   D3DPOOL pool, bool mipmaps);
   bool CopyBufferToTexture(IDirect3DTexture9 *texture, Rect rect,
                            std::string &buffer) const;
 };
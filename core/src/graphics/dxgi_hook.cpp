@@ -198,7 +198,13 @@ void DxgiHook::BeforePresent(IDXGISwapChain *swap_chain) {
   }
 
   Core::Get()->get_graphics_manager()->Render();
-  Core::Get()->get_graphics_manager()->get_stats_calculator()->Frame();
+}
+
+void DxgiHook::AfterPresent(HRESULT result) {
+  if (graphics_initiated_) {
+    Core::Get()->get_graphics_manager()->OnPresent(result ==
+                                                   DXGI_STATUS_OCCLUDED);
+  }
 }
 
 bool DxgiHook::HookSwapChain(IDXGISwapChain *swap_chain) {
@@ -274,6 +280,9 @@ HRESULT DxgiHook::PresentHook(IDXGISwapChain *swap_chain, UINT sync_interval,
   ret = present_hook_.get_trampoline().CallStdMethod<HRESULT>(
       swap_chain, sync_interval, flags);
 
+  // Call after present handler
+  AfterPresent(ret);
+
   return ret;
 }
 
@@ -314,6 +323,9 @@ HRESULT DxgiHook::Present1Hook(
   ret = present1_hook_.get_trampoline().CallStdMethod<HRESULT>(
       swap_chain, sync_interval, present_flags, present_parameters_ptr);
 
+  // Call after present handler
+  AfterPresent(ret);
+
   return ret;
 }
 
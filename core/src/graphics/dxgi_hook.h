@@ -48,6 +48,7 @@ class DxgiHook : public IGraphicsHook {
   bool InitGraphics(IDXGISwapChain *swap_chain);
 
   void BeforePresent(IDXGISwapChain *swap_chain);
+  void AfterPresent(HRESULT result);
 
   HRESULT PresentHook(IDXGISwapChain *swap_chain, UINT sync_interval,
                       UINT flags);
@@ -1,17 +1,30 @@
 #include "graphics_manager.h"
 
+#include <dwmapi.h>
 #include <windows.h>
 
 #include <loguru/loguru.hpp>
 
 #include "core.h"
 #include "events.pb.h"
+#include "utils/timestamp.h"
+#include "utils/trace_recorder.h"
 
 namespace overlay {
 namespace core {
 namespace graphics {
 
-GraphicsManager::GraphicsManager() : renderer_(nullptr) {}
+GraphicsManager::GraphicsManager()
+    : renderer_(nullptr),
+      last_present_timestamp_(0),
+      upload_budget_(DEFAULT_UPLOAD_BUDGET),
+      frame_(0),
+      last_frame_event_timestamp_(0),
+      frame_interval_(0),
+      vblank_counter_(0),
+      refresh_period_counter_(0),
+      vsync_timing_timestamp_(0),
+      vsync_timing_stale_(true) {}
 
 bool GraphicsManager::Hook() {
   bool hooked = false;
@@ -43,7 +56,8 @@ bool GraphicsManager::Hook() {
   return hooked;
 }
 
-void GraphicsManager::BroadcastApplicationStats(double frame_time, double fps) {
+void GraphicsManager::SendApplicationStats(std::string client_id,
+                                           const FrameStats &frame_stats) {
   EventResponse event;
   EventResponse::ApplicationStatsEvent *stats_event =
       event.mutable_applicationstatsevent();
@@ -54,18 +68,121 @@ void GraphicsManager::BroadcastApplicationStats(double frame_time, double fps) {
       renderer_ != nullptr ? (uint32_t)renderer_->get_height() : 0);
   stats_event->set_fullscreen(renderer_ != nullptr ? renderer_->is_fullscreen()
                                                    : false);
-  stats_event->set_frametime(frame_time);
-  stats_event->set_fps(fps);
+  stats_event->set_frametime(frame_stats.frame_time);
+  stats_event->set_fps(frame_stats.fps);
+  stats_event->set_frametimep50(frame_stats.frame_time_p50);
+  stats_event->set_frametimep95(frame_stats.frame_time_p95);
+  stats_event->set_frametimep99(frame_stats.frame_time_p99);
+  stats_event->set_frametimemax(frame_stats.frame_time_max);
+  stats_event->set_onepercentlowfps(frame_stats.one_percent_low_fps);
+  for (auto bound : StatsCalculator::kFrameTimeHistogramBounds) {
+    stats_event->add_frametimehistogrambounds(bound);
+  }
+  for (auto count : frame_stats.frame_time_histogram) {
+    stats_event->add_frametimehistogram(count);
+  }
+
+  Core::Get()->get_rpc_server()->get_events_service()->SendEventToClient(
+      client_id, event);
+}
+
+void GraphicsManager::SendOverlayStats(std::string client_id,
+                                       const OverlayStats &overlay_stats) {
+  EventResponse event;
+  EventResponse::OverlayStatsEvent *stats_event =
+      event.mutable_overlaystatsevent();
 
-  Core::Get()->get_rpc_server()->get_events_service()->BroadcastEvent(event);
+  stats_event->set_frames(overlay_stats.frames);
+  stats_event->set_framesoverbudget(overlay_stats.frames_over_budget);
+  stats_event->set_budget(OVERLAY_FRAME_BUDGET / 1000.0);
+  stats_event->set_rendertime(overlay_stats.render_time);
+  stats_event->set_rendertimemax(overlay_stats.render_time_max);
+  stats_event->set_snapshottime(overlay_stats.snapshot_time);
+  stats_event->set_texturecreationtime(overlay_stats.texture_creation_time);
+  stats_event->set_uploadtime(overlay_stats.upload_time);
+  stats_event->set_drawtime(overlay_stats.draw_time);
+  stats_event->set_uploadedbytes(overlay_stats.uploaded_bytes);
+  stats_event->set_createdtextures(overlay_stats.created_textures);
+  stats_event->set_drawnsprites(overlay_stats.drawn_sprites);
+  stats_event->set_inputevents(overlay_stats.input_events);
+  stats_event->set_inputlatencyp50(overlay_stats.input_latency_p50);
+  stats_event->set_inputlatencyp95(overlay_stats.input_latency_p95);
+  stats_event->set_inputlatencyp99(overlay_stats.input_latency_p99);
+  stats_event->set_inputlatencymax(overlay_stats.input_latency_max);
+
+  Core::Get()->get_rpc_server()->get_events_service()->SendEventToClient(
+      client_id, event);
 }
 
 void GraphicsManager::Render() {
+  TRACE_SCOPE("graphics", "Render");
+  RenderStats render_stats = {0};
+  uint64_t start_timestamp = 0;
+
+  // Measure the cost of the overlay only if someone is interested in it
+  render_stats.measured = stats_calculator_.is_overlay_stats_subscribed();
+  if (render_stats.measured) {
+    start_timestamp = utils::timestamp::GetTimestamp();
+  }
+
+  // Send the mouse moves that were coalesced during the frame
+  Core::Get()->get_input_manager()->RequestInputFlush();
+
   if (renderer_) {
-    window_mananger_.RenderWindows(renderer_);
+    window_mananger_.RenderWindows(renderer_, render_stats);
+  }
+
+  last_present_timestamp_ = utils::timestamp::GetTimestamp();
+  stats_calculator_.Frame(last_present_timestamp_);
+
+  if (render_stats.measured) {
+    render_stats.render_time = last_present_timestamp_ - start_timestamp;
+    stats_calculator_.RenderFrame(render_stats);
   }
 }
 
+void GraphicsManager::OnPresent(bool occluded) {
+  EventResponse event;
+  EventResponse::FrameEvent *frame_event = event.mutable_frameevent();
+  ipc::EventsServiceImpl *events_service =
+      Core::Get()->get_rpc_server()->get_events_service();
+  uint64_t present_counter = 0, present_timestamp = 0, interval = 0;
+
+  frame_++;
+
+  // Don't build the event if no client is waiting for frames
+  if (!events_service ||
+      !events_service->IsSubscribed(EventResponse::EventCase::kFrameEvent)) {
+    last_frame_event_timestamp_ = 0;
+    return;
+  }
+
+  present_counter = utils::timestamp::GetCounter();
+  present_timestamp = utils::timestamp::CounterToTimestamp(present_counter);
+
+  // Smooth the interval between the game's frames, restarting it after a
+  // long pause such as a loading screen
+  interval = present_timestamp - last_frame_event_timestamp_;
+  if (last_frame_event_timestamp_ == 0 ||
+      interval > FRAME_INTERVAL_RESET_THRESHOLD) {
+    frame_interval_ = 0;
+  } else if (frame_interval_ == 0) {
+    frame_interval_ = interval;
+  } else {
+    frame_interval_ = (frame_interval_ * 7 + interval) / 8;
+  }
+  last_frame_event_timestamp_ = present_timestamp;
+
+  frame_event->set_frame(frame_);
+  frame_event->set_presenttime(present_timestamp);
+  frame_event->set_nextvsynctime(
+      PredictNextVsync(present_counter, present_timestamp));
+  frame_event->set_frameinterval(frame_interval_);
+  frame_event->set_occluded(occluded);
+
+  events_service->BroadcastEvent(event);
+}
+
 void GraphicsManager::OnResize(uint32_t width, uint32_t height,
                                bool fullscreen) {
   window_mananger_.OnResize();
@@ -73,8 +190,66 @@ void GraphicsManager::OnResize(uint32_t width, uint32_t height,
   if (renderer_) {
     renderer_->OnResize(width, height, fullscreen);
   }
+
+  // Switching to or from fullscreen may change the display mode
+  InvalidateVsyncTiming();
+}
+
+void GraphicsManager::InvalidateVsyncTiming() { vsync_timing_stale_ = true; }
+
+void GraphicsManager::UpdateVsyncTiming(uint64_t timestamp) {
+  DWM_TIMING_INFO timing_info = {sizeof(timing_info)};
+
+  vblank_counter_ = 0;
+  refresh_period_counter_ = 0;
+  vsync_timing_timestamp_ = timestamp;
+  if (FAILED(DwmGetCompositionTimingInfo(NULL, &timing_info)) ||
+      timing_info.qpcRefreshPeriod == 0) {
+    return;
+  }
+
+  vblank_counter_ = timing_info.qpcVBlank;
+  refresh_period_counter_ = timing_info.qpcRefreshPeriod;
 }
 
+uint64_t GraphicsManager::PredictNextVsync(uint64_t present_counter,
+                                           uint64_t present_timestamp) {
+  uint64_t vblank = 0;
+
+  // The refresh period only changes with the display, so the compositor
+  // isn't asked on every frame
+  if (vsync_timing_stale_.exchange(false) ||
+      present_timestamp - vsync_timing_timestamp_ >
+          VSYNC_TIMING_REFRESH_INTERVAL) {
+    UpdateVsyncTiming(present_timestamp);
+  }
+
+  // Without the compositor's timing assume the game keeps its pace
+  if (refresh_period_counter_ == 0) {
+    return frame_interval_ ? present_timestamp + frame_interval_ : 0;
+  }
+
+  // Find the first vblank after the present in counter ticks, so the
+  // rounding of the refresh period doesn't add up over the vblanks
+  vblank = vblank_counter_;
+  if (vblank <= present_counter) {
+    vblank += ((present_counter - vblank) / refresh_period_counter_ + 1) *
+              refresh_period_counter_;
+  }
+
+  return utils::timestamp::CounterToTimestamp(vblank);
+}
+
+uint64_t GraphicsManager::get_last_present_timestamp() const {
+  return last_present_timestamp_;
+}
+
+void GraphicsManager::set_upload_budget(uint64_t upload_budget) {
+  upload_budget_ = upload_budget;
+}
+
+uint64_t GraphicsManager::get_upload_budget() const { return upload_budget_; }
+
 WindowManager *GraphicsManager::get_window_manager() {
   return &window_mananger_;
 }
@@ -1,5 +1,7 @@
 #pragma once
+#include <atomic>
 #include <memory>
+#include <string>
 
 #include "dx9_hook.h"
 #include "dxgi_hook.h"
@@ -7,6 +9,10 @@
 #include "stats_calculator.h"
 #include "window_manager.h"
 
+#define FRAME_INTERVAL_RESET_THRESHOLD 1000000  // Microseconds
+#define DEFAULT_UPLOAD_BUDGET (8 * 1024 * 1024)  // Bytes per frame
+#define VSYNC_TIMING_REFRESH_INTERVAL 1000000  // Microseconds
+
 namespace overlay {
 namespace core {
 namespace graphics {
@@ -17,10 +23,23 @@ class GraphicsManager {
 
   bool Hook();
 
-  void BroadcastApplicationStats(double frame_time, double fps);
+  void SendApplicationStats(std::string client_id,
+                            const FrameStats &frame_stats);
+  void SendOverlayStats(std::string client_id,
+                        const OverlayStats &overlay_stats);
 
   void Render();
+  void OnPresent(bool occluded);
   void OnResize(uint32_t width, uint32_t height, bool fullscreen);
+  // Reads the compositor's timing again on the next frame, called when the
+  // display or its mode changes. It's also read again periodically since the
+  // compositor's clock drifts from the counter
+  void InvalidateVsyncTiming();
+
+  uint64_t get_last_present_timestamp() const;
+
+  void set_upload_budget(uint64_t upload_budget);
+  uint64_t get_upload_budget() const;
 
   WindowManager *get_window_manager();
 
@@ -41,6 +60,26 @@ class GraphicsManager {
   std::unique_ptr<IGraphicsRenderer> renderer_;
 
   StatsCalculator stats_calculator_;
+
+  std::atomic<uint64_t> last_present_timestamp_;
+  std::atomic<uint64_t> upload_budget_;
+
+  // Only accessed by the game's render thread
+  uint64_t frame_;
+  uint64_t last_frame_event_timestamp_;
+  uint64_t frame_interval_;
+
+  // A vblank of the compositor and its refresh period in performance counter
+  // ticks, 0 if its timing isn't available. Cached by the game's render
+  // thread until they're invalidated or get too old
+  uint64_t vblank_counter_;
+  uint64_t refresh_period_counter_;
+  uint64_t vsync_timing_timestamp_;
+  std::atomic<bool> vsync_timing_stale_;
+
+  void UpdateVsyncTiming(uint64_t timestamp);
+  uint64_t PredictNextVsync(uint64_t present_counter,
+                            uint64_t present_timestamp);
 };
 
 }  // namespace graphics
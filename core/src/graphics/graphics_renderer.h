@@ -10,13 +10,29 @@ namespace overlay {
 namespace core {
 namespace graphics {
 
+// Cost of the overlay in a single frame, times are in microseconds
+struct RenderStats {
+  bool measured;  // The stages are only timed if set
+
+  uint64_t render_time;
+  uint64_t snapshot_time;
+  uint64_t texture_creation_time;
+  uint64_t upload_time;
+  uint64_t draw_time;
+
+  uint64_t uploaded_bytes;
+  uint64_t created_textures;
+  uint64_t drawn_sprites;
+};
+
 class IGraphicsRenderer {
  public:
   inline virtual ~IGraphicsRenderer() {}
 
   virtual bool Init() = 0;
   virtual void RenderSprites(
-      const std::vector<std::shared_ptr<Sprite>>& sprites) = 0;
+      const std::vector<std::shared_ptr<Sprite>>& sprites,
+      RenderStats& render_stats) = 0;
 
   virtual void OnResize(uint32_t width, uint32_t height, bool fullscreen) = 0;
 
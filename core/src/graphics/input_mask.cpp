@@ -0,0 +1,103 @@
+#include "input_mask.h"
+
+#include <algorithm>
+
+namespace overlay {
+namespace core {
+namespace graphics {
+
+std::atomic<uint64_t> InputMask::next_id_(1);
+
+InputMask::InputMask(InputMaskType type)
+    : id_(next_id_++),
+      type_(type),
+      bounds_(),
+      width_(0),
+      height_(0),
+      alpha_threshold_(0),
+      row_words_(0) {}
+
+std::shared_ptr<const InputMask> InputMask::FromRects(std::vector<Rect> rects) {
+  std::shared_ptr<InputMask> mask(new InputMask(InputMaskType::Rects));
+  int64_t left = INT64_MAX, top = INT64_MAX, right = INT64_MIN,
+          bottom = INT64_MIN;
+
+  // Remove the empty rects and find the bounds of the rest
+  rects.erase(std::remove_if(rects.begin(), rects.end(),
+                             [](const Rect &rect) {
+                               return !rect.width || !rect.height;
+                             }),
+              rects.end());
+  for (auto &rect : rects) {
+    left = std::min<int64_t>(left, rect.x);
+    top = std::min<int64_t>(top, rect.y);
+    right = std::max<int64_t>(right, (int64_t)rect.x + rect.width);
+    bottom = std::max<int64_t>(bottom, (int64_t)rect.y + rect.height);
+  }
+
+  if (!rects.empty()) {
+    mask->bounds_ = {(uint32_t)(bottom - top), (uint32_t)(right - left),
+                     (int32_t)left, (int32_t)top};
+  }
+  mask->rects_ = std::move(rects);
+
+  return mask;
+}
+
+std::shared_ptr<const InputMask> InputMask::FromAlpha(const std::string &buffer,
+                                                      uint32_t width,
+                                                      uint32_t height,
+                                                      uint8_t alpha_threshold) {
+  const uint32_t *pixels = (const uint32_t *)buffer.data();
+  size_t row_words = ((size_t)width + 63) / 64;
+  std::vector<uint64_t> bitmap(row_words * height);
+
+  if (buffer.size() != (size_t)width * height * sizeof(uint32_t)) {
+    return nullptr;
+  }
+
+  // Set the bit of each pixel that is opaque enough
+  for (uint32_t y = 0; y < height; y++) {
+    uint64_t *row = bitmap.data() + y * row_words;
+
+    for (uint32_t x = 0; x < width; x++) {
+      row[x / 64] |= (uint64_t)((*pixels++ >> 24) >= alpha_threshold)
+                     << (x % 64);
+    }
+  }
+
+  return FromBitmap(width, height, std::move(bitmap), alpha_threshold);
+}
+
+std::shared_ptr<const InputMask> InputMask::FromBitmap(
+    uint32_t width, uint32_t height, std::vector<uint64_t> bitmap,
+    uint8_t alpha_threshold) {
+  std::shared_ptr<InputMask> mask(new InputMask(InputMaskType::Alpha));
+
+  mask->width_ = width;
+  mask->height_ = height;
+  mask->alpha_threshold_ = alpha_threshold;
+  mask->row_words_ = ((size_t)width + 63) / 64;
+
+  // Verify the size of the bitmap
+  if (bitmap.size() != mask->row_words_ * height) {
+    return nullptr;
+  }
+  mask->bitmap_ = std::move(bitmap);
+
+  return mask;
+}
+
+bool InputMask::ContainsInRects(int64_t x, int64_t y) const {
+  auto contains = [x, y](const Rect &rect) {
+    return x >= rect.x && x < (int64_t)rect.x + rect.width && y >= rect.y &&
+           y < (int64_t)rect.y + rect.height;
+  };
+
+  return !rects_.empty() && contains(bounds_) &&
+         std::any_of(rects_.begin(), rects_.end(), contains);
+}
+
+}  // namespace graphics
+}  // namespace core
+}  // namespace overlay
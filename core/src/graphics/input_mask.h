@@ -0,0 +1,85 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "rect.h"
+
+namespace overlay {
+namespace core {
+namespace graphics {
+
+enum class InputMaskType : uint8_t { Rects = 0, Alpha = 1 };
+
+// The parts of a window that take mouse input, the input outside of them falls
+// through to the windows below it or to the game. Masks are immutable so the
+// routing can share them without locking
+class InputMask {
+ public:
+  // The rects are relative to the window
+  static std::shared_ptr<const InputMask> FromRects(std::vector<Rect> rects);
+
+  // The pixels of the A8R8G8B8 buffer with at least the threshold alpha take
+  // input, the buffer is scaled to the window like it's drawn
+  static std::shared_ptr<const InputMask> FromAlpha(const std::string &buffer,
+                                                    uint32_t width,
+                                                    uint32_t height,
+                                                    uint8_t alpha_threshold);
+
+  // The point is relative to the window, and the window's size scales the
+  // alpha mask
+  inline bool Contains(int64_t x, int64_t y, uint32_t window_width,
+                       uint32_t window_height) const {
+    if (type_ == InputMaskType::Rects) {
+      return ContainsInRects(x, y);
+    }
+
+    if (bitmap_.empty() || x < 0 || y < 0 || x >= window_width ||
+        y >= window_height) {
+      return false;
+    }
+
+    // Sample the nearest pixel of the buffer
+    x = x * width_ / window_width;
+    y = y * height_ / window_height;
+    return (bitmap_[(size_t)y * row_words_ + (size_t)x / 64] >> (x % 64)) & 1;
+  }
+
+  inline uint64_t get_id() const { return id_; }
+  inline InputMaskType get_type() const { return type_; }
+  inline const std::vector<Rect> &get_rects() const { return rects_; }
+  inline uint32_t get_width() const { return width_; }
+  inline uint32_t get_height() const { return height_; }
+  inline uint8_t get_alpha_threshold() const { return alpha_threshold_; }
+  inline const std::vector<uint64_t> &get_bitmap() const { return bitmap_; }
+
+ private:
+  static std::atomic<uint64_t> next_id_;
+
+  uint64_t id_;  // Unique for the process, even after the mask is freed
+  InputMaskType type_;
+
+  // The bounds skip the rects for most of the points outside of them
+  std::vector<Rect> rects_;
+  Rect bounds_;
+
+  // A bit for each pixel of the buffer, each row starts at a new word
+  uint32_t width_, height_;
+  uint8_t alpha_threshold_;  // 0 for the rects
+  size_t row_words_;
+  std::vector<uint64_t> bitmap_;
+
+  InputMask(InputMaskType type);
+
+  static std::shared_ptr<const InputMask> FromBitmap(
+      uint32_t width, uint32_t height, std::vector<uint64_t> bitmap,
+      uint8_t alpha_threshold);
+
+  bool ContainsInRects(int64_t x, int64_t y) const;
+};
+
+}  // namespace graphics
+}  // namespace core
+}  // namespace overlay
@@ -0,0 +1,92 @@
+#include "mouse_routing.h"
+
+#include "utils/rect.h"
+
+namespace overlay {
+namespace core {
+namespace graphics {
+
+void RouteMouseEvent(
+    const std::vector<WindowInputRegion> &window_regions,
+    const WindowUniqueId &focused_window_id,
+    const WindowUniqueId &captured_window_id,
+    EventResponse::WindowEvent::MouseInputEvent::MouseInputType type,
+    POINT point, bool buttons_down, MouseEventRoute &route) {
+  bool pressed =
+      type == EventResponse::WindowEvent::MouseInputEvent::MOUSE_BUTTON_DOWN ||
+      type == EventResponse::WindowEvent::MouseInputEvent::
+                  MOUSE_BUTTON_DOUBLE_CLICK;
+
+  route = {nullptr, 0, 0, false, nullptr, nullptr, nullptr};
+
+  // The captured window gets every event without hit-testing, and keeps the
+  // capture while any button is held
+  if (captured_window_id) {
+    for (auto region_it = window_regions.rbegin();
+         region_it != window_regions.rend(); region_it++) {
+      if (region_it->id == captured_window_id) {
+        route.window_id = &region_it->id;
+        route.x = point.x - region_it->rect.x;
+        route.y = point.y - region_it->rect.y;
+        route.hovered_window_id = &region_it->id;
+        route.capture_window_id = buttons_down ? &region_it->id : nullptr;
+        return;
+      }
+    }
+
+    // The captured window was closed or hidden, route the event by its point
+  }
+
+  for (auto region_it = window_regions.rbegin();
+       region_it != window_regions.rend(); region_it++) {
+    bool focused = region_it->id == focused_window_id;
+
+    // The parts of the window outside of its mask are skipped like the
+    // outside of its rect
+    if (!IsPointInRegion(*region_it, point)) {
+      // Blur the focused window when pressing outside of it
+      if (focused &&
+          type ==
+              EventResponse::WindowEvent::MouseInputEvent::MOUSE_BUTTON_DOWN) {
+        route.blur_focused_window = true;
+      }
+
+      continue;
+    }
+
+    // Button ups that weren't captured only reach the focused window
+    if (region_it->id &&
+        (focused || type != EventResponse::WindowEvent::MouseInputEvent::
+                                MOUSE_BUTTON_UP)) {
+      route.window_id = &region_it->id;
+      route.x = point.x - region_it->rect.x;
+      route.y = point.y - region_it->rect.y;
+    }
+
+    // Focus on the window that was pressed and capture the pointer until its
+    // buttons are released
+    if (type ==
+        EventResponse::WindowEvent::MouseInputEvent::MOUSE_BUTTON_DOWN) {
+      route.focus_window_id = &region_it->id;
+    }
+    if (pressed && buttons_down && region_it->id) {
+      route.capture_window_id = &region_it->id;
+    }
+
+    // Stop at the top window the event occurred in
+    route.hovered_window_id = &region_it->id;
+    break;
+  }
+}
+
+bool IsPointInRegion(const WindowInputRegion &region, POINT point) {
+  return utils::Rect::PointInRect(point, region.rect) &&
+         (!region.mask ||
+          region.mask->Contains(point.x - region.rect.x,
+                                point.y - region.rect.y, region.rect.width,
+                                region.rect.height));
+}
+
+}  // namespace graphics
+}  // namespace core
+}  // namespace overlay
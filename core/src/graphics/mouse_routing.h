@@ -0,0 +1,41 @@
+#pragma once
+#include <Windows.h>
+
+#include <vector>
+
+#include "events.pb.h"
+#include "window.h"
+
+namespace overlay {
+namespace core {
+namespace graphics {
+
+// The window a mouse event is sent to and the focus and capture changes it
+// causes, the ids point into the window regions the route was made from
+struct MouseEventRoute {
+  const WindowUniqueId *window_id;  // Null if no window gets the event
+  int64_t x;
+  int64_t y;
+
+  bool blur_focused_window;
+  const WindowUniqueId *focus_window_id;  // The pressed window
+  const WindowUniqueId *hovered_window_id;
+  const WindowUniqueId *capture_window_id;  // Captures the following events
+};
+
+// Routes a mouse event to the window capturing the pointer, or else to the
+// top window whose mask is under the pointer, the regions are ordered from
+// the bottom window to the top window. Nothing is changed by the routing, so
+// it's shared by the window manager and the input replayer
+void RouteMouseEvent(
+    const std::vector<WindowInputRegion> &window_regions,
+    const WindowUniqueId &focused_window_id,
+    const WindowUniqueId &captured_window_id,
+    EventResponse::WindowEvent::MouseInputEvent::MouseInputType type,
+    POINT point, bool buttons_down, MouseEventRoute &route);
+
+bool IsPointInRegion(const WindowInputRegion &region, POINT point);
+
+}  // namespace graphics
+}  // namespace core
+}  // namespace overlay
@@ -0,0 +1,113 @@
+#include "software_compositor.h"
+
+#include <algorithm>
+
+namespace overlay {
+namespace core {
+namespace graphics {
+
+bool SoftwareCompositor::Composite(
+    const std::vector<std::shared_ptr<Sprite>> &sprites, uint32_t width,
+    uint32_t height, std::string &target) {
+  if (target.size() != (size_t)width * height * sizeof(uint32_t)) {
+    return false;
+  }
+
+  for (const auto &sprite : sprites) {
+    if (sprite != nullptr) {
+      CompositeSprite(*sprite, width, height, target);
+    }
+  }
+
+  return true;
+}
+
+void SoftwareCompositor::CompositeSprite(const Sprite &sprite, uint32_t width,
+                                         uint32_t height,
+                                         std::string &target) {
+  uint32_t alpha = blend::OpacityToAlpha(sprite.opacity);
+  Rect rect = sprite.rect;
+
+  if (alpha == 0) {
+    return;
+  }
+
+  if (sprite.fill_target) {
+    rect = {height, width, 0, 0};
+  }
+
+  // Choose the kernel once for the entire sprite
+  if (sprite.solid_color) {
+    if (alpha == 0xff) {
+      BlendSprite<blend::BlendMode::Opaque>(sprite, rect, alpha, width, height,
+                                            target);
+    } else {
+      BlendSprite<blend::BlendMode::UniformAlpha>(sprite, rect, alpha, width,
+                                                  height, target);
+    }
+  } else if (sprite.buffer_width && sprite.buffer_height &&
+             sprite.buffer.size() == (size_t)sprite.buffer_width *
+                                         sprite.buffer_height *
+                                         sizeof(uint32_t)) {
+    BlendSprite<blend::BlendMode::PerPixelAlpha>(sprite, rect, alpha, width,
+                                                 height, target);
+  }
+}
+
+template <blend::BlendMode mode>
+void SoftwareCompositor::BlendSprite(const Sprite &sprite, const Rect &rect,
+                                     uint32_t alpha, uint32_t width,
+                                     uint32_t height, std::string &target) {
+  uint32_t *target_pixels = (uint32_t *)target.data();
+  const uint32_t *source_pixels = (const uint32_t *)sprite.buffer.data();
+  std::vector<uint32_t> row;
+
+  // Clip the sprite to the target
+  int64_t left = std::max<int64_t>(rect.x, 0);
+  int64_t top = std::max<int64_t>(rect.y, 0);
+  int64_t right = std::min<int64_t>((int64_t)rect.x + rect.width, width);
+  int64_t bottom = std::min<int64_t>((int64_t)rect.y + rect.height, height);
+  size_t pixels = 0;
+
+  if (left >= right || top >= bottom) {
+    return;
+  }
+  pixels = (size_t)(right - left);
+
+  // A solid color is the same row for all of the lines
+  if (sprite.solid_color) {
+    row.assign(pixels, 0xff000000 | ((uint32_t)sprite.color.red << 16) |
+                           ((uint32_t)sprite.color.green << 8) |
+                           sprite.color.blue);
+  } else if (sprite.buffer_width != rect.width) {
+    row.resize(pixels);
+  }
+
+  for (int64_t y = top; y < bottom; y++) {
+    const uint32_t *source = row.data();
+
+    if (!sprite.solid_color) {
+      const uint32_t *source_line =
+          source_pixels + (size_t)((y - rect.y) * sprite.buffer_height /
+                                   rect.height) *
+                              sprite.buffer_width;
+
+      // Sample the nearest pixels of the line if the buffer is scaled
+      if (sprite.buffer_width == rect.width) {
+        source = source_line + (left - rect.x);
+      } else {
+        for (size_t i = 0; i < pixels; i++) {
+          row[i] = source_line[(left - rect.x + i) * sprite.buffer_width /
+                               rect.width];
+        }
+      }
+    }
+
+    blend::BlendRow<mode>(target_pixels + y * width + left, source, pixels,
+                          alpha);
+  }
+}
+
+}  // namespace graphics
+}  // namespace core
+}  // namespace overlay
@@ -0,0 +1,35 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "blend.h"
+#include "sprite.h"
+
+namespace overlay {
+namespace core {
+namespace graphics {
+
+// Composites the sprites on the CPU for when there is no renderer, the
+// buffers are scaled with the nearest pixel
+class SoftwareCompositor {
+ public:
+  // The target is an A8R8G8B8 buffer of width x height pixels, the sprites
+  // are blended over it in their order
+  static bool Composite(const std::vector<std::shared_ptr<Sprite>> &sprites,
+                        uint32_t width, uint32_t height, std::string &target);
+
+ private:
+  static void CompositeSprite(const Sprite &sprite, uint32_t width,
+                              uint32_t height, std::string &target);
+
+  template <blend::BlendMode mode>
+  static void BlendSprite(const Sprite &sprite, const Rect &rect,
+                          uint32_t alpha, uint32_t width, uint32_t height,
+                          std::string &target);
+};
+
+}  // namespace graphics
+}  // namespace core
+}  // namespace overlay
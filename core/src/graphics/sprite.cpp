@@ -1,5 +1,7 @@
 #include "sprite.h"
 
+#include <initializer_list>
+
 #include "core.h"
 
 namespace overlay {
@@ -8,26 +10,53 @@ namespace graphics {
 
 Sprite::Sprite()
     : texture(nullptr),
+      texture_width(0),
+      texture_height(0),
+      texture_ready(false),
+      staging_texture(nullptr),
+      staged_rows(0),
+      uploading(false),
       fill_target(false),
       solid_color(false),
-      buffer_updated(false) {}
+      buffer_width(0),
+      buffer_height(0),
+      buffer_generation(0),
+      buffer_updated(false),
+      pending_buffer_width(0),
+      pending_buffer_height(0),
+      pending_buffer_generation(0),
+      has_pending_buffer(false),
+      pending_buffer_timestamp(0),
+      buffer_stats({0}),
+      buffer_updates(0) {}
 
 Sprite::~Sprite() { FreeTexture(); }
 
 void Sprite::FreeTexture() {
-  if (texture) {
-    std::unique_ptr<IGraphicsRenderer> &renderer =
-        Core::Get()->get_graphics_manager()->get_renderer();
+  std::unique_ptr<IGraphicsRenderer> &renderer =
+      Core::Get()->get_graphics_manager()->get_renderer();
+
+  for (IUnknown **sprite_texture : {&texture, &staging_texture}) {
+    if (*sprite_texture == nullptr) {
+      continue;
+    }
 
     if (renderer) {
       // Queue the texture to be released in the main D3D9 device thread
-      renderer->QueueTextureRelease(texture);
+      renderer->QueueTextureRelease(*sprite_texture);
     } else {
-      texture->Release();
+      (*sprite_texture)->Release();
     }
 
-    texture = nullptr;
+    *sprite_texture = nullptr;
   }
+
+  // The buffer will be uploaded again to the new texture
+  texture_width = 0;
+  texture_height = 0;
+  texture_ready = false;
+  staged_rows = 0;
+  uploading = false;
 }
 
 }  // namespace graphics
@@ -1,6 +1,9 @@
 #pragma once
 #include <unknwn.h>
 
+#include <atomic>
+#include <cstdint>
+#include <mutex>
 #include <string>
 
 #include "color.h"
@@ -10,6 +13,15 @@ namespace overlay {
 namespace core {
 namespace graphics {
 
+// The latencies are in microseconds from receiving a buffer to rendering it
+struct BufferStats {
+  uint64_t received_buffers;
+  uint64_t presented_buffers;
+  uint64_t dropped_buffers;  // Replaced by a newer buffer before rendered
+  uint64_t latency;          // Smoothed over the recent buffers
+  uint64_t latency_max;
+};
+
 struct Sprite {
   Sprite();
   ~Sprite();
@@ -21,13 +33,37 @@ struct Sprite {
 
   double opacity;
 
+  // The buffer's resolution may differ from the rect, it's scaled when drawn
   std::string buffer;
+  uint32_t buffer_width, buffer_height;
+  uint64_t buffer_generation;  // Set by the client, deltas name their base
   bool buffer_updated;
 
+  // Mailbox of the latest buffer received, it's moved into the buffer by the
+  // render thread so a newer buffer simply replaces an unrendered one
+  std::string pending_buffer;
+  uint32_t pending_buffer_width, pending_buffer_height;
+  uint64_t pending_buffer_generation;
+  bool has_pending_buffer;
+  uint64_t pending_buffer_timestamp;
+  BufferStats buffer_stats;
+  std::mutex pending_buffer_mutex;
+  // Counts the buffers put in the mailbox, so the alpha input mask built from
+  // them can tell that it's stale without locking
+  std::atomic<uint64_t> buffer_updates;
+
   bool solid_color;
   Color color;
 
   IUnknown *texture;
+  uint32_t texture_width, texture_height;
+  bool texture_ready;  // The texture holds a complete buffer
+
+  // A system memory copy of the buffer which is filled over as many frames as
+  // the upload budget requires, and then copied to the texture by the GPU
+  IUnknown *staging_texture;
+  size_t staged_rows;
+  bool uploading;
 };
 
 }  // namespace graphics
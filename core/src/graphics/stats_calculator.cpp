@@ -1,75 +1,423 @@
 #include "stats_calculator.h"
 
+#include <algorithm>
+#include <cmath>
+
 #include "core.h"
 
 namespace overlay {
 namespace core {
 namespace graphics {
 
+// Adds to a total that has a single writer
+static inline void AddToTotal(std::atomic<uint64_t> &total, uint64_t value) {
+  total.store(total.load(std::memory_order_relaxed) + value,
+              std::memory_order_relaxed);
+}
+
+// Nearest rank percentile of sorted values
+template <typename T>
+static inline T Percentile(const std::vector<T> &values, double p) {
+  size_t rank = (size_t)std::ceil(p * values.size());
+
+  return values[std::max<size_t>(rank, 1) - 1];
+}
+
 StatsCalculator::StatsCalculator()
-    : frame_render_start_(std::chrono::high_resolution_clock::now()),
-      last_calc_time_(std::chrono::high_resolution_clock::now()),
-      calc_thread_(&StatsCalculator::CalculateStats, this),
-      frame_samples_cap_(INITIAL_FRAME_SAMPLES_CAP) {}
+    : frames_count_(0),
+      first_subscribed_frame_(0),
+      render_stats_totals_(),
+      frame_stats_subscribers_(0),
+      overlay_stats_subscribers_(0) {}
 
-void StatsCalculator::Frame() {
-  std::unique_lock lk(frame_times_mutex_);
+void StatsCalculator::Frame(uint64_t timestamp) {
+  if (!is_frame_stats_subscribed()) {
+    return;
+  }
 
-  // Calculate current frame time
-  frame_times_.push_back(std::chrono::high_resolution_clock::now() -
-                         frame_render_start_);
-  lk.unlock();
+  uint64_t frames_count = frames_count_.load(std::memory_order_relaxed);
 
-  // If we reached the max samples, calculate stats
-  if (std::chrono::high_resolution_clock::now() - last_calc_time_ >=
-      STATS_CALC_TIME) {
-    calc_cv_.notify_one();
+  // Order the write of the reused slot after the previous frame was
+  // published, so a reader that copied the new timestamp also sees that the
+  // slot is being written
+  std::atomic_thread_fence(std::memory_order_release);
 
-    // Reset current sample
-    last_calc_time_ = std::chrono::high_resolution_clock::now();
+  // Save the timestamp of the frame and publish it once it's written
+  frame_timestamps_[frames_count & (FRAME_TIMESTAMPS_CAPACITY - 1)].store(
+      timestamp, std::memory_order_relaxed);
+  frames_count_.store(frames_count + 1, std::memory_order_release);
+}
+
+void StatsCalculator::RenderFrame(const RenderStats &render_stats) {
+  uint64_t frames = render_stats_totals_.frames.load(std::memory_order_relaxed);
+
+  render_times_[frames & (FRAME_TIMESTAMPS_CAPACITY - 1)].store(
+      render_stats.render_time, std::memory_order_relaxed);
+
+  AddToTotal(render_stats_totals_.render_time, render_stats.render_time);
+  AddToTotal(render_stats_totals_.snapshot_time, render_stats.snapshot_time);
+  AddToTotal(render_stats_totals_.texture_creation_time,
+             render_stats.texture_creation_time);
+  AddToTotal(render_stats_totals_.upload_time, render_stats.upload_time);
+  AddToTotal(render_stats_totals_.draw_time, render_stats.draw_time);
+  AddToTotal(render_stats_totals_.uploaded_bytes, render_stats.uploaded_bytes);
+  AddToTotal(render_stats_totals_.created_textures,
+             render_stats.created_textures);
+  AddToTotal(render_stats_totals_.drawn_sprites, render_stats.drawn_sprites);
+
+  if (render_stats.render_time > OVERLAY_FRAME_BUDGET) {
+    AddToTotal(render_stats_totals_.frames_over_budget, 1);
   }
 
-  // Prepare next frame timing
-  frame_render_start_ = std::chrono::high_resolution_clock::now();
+  // Publish the frame
+  render_stats_totals_.frames.store(frames + 1, std::memory_order_release);
 }
 
-void StatsCalculator::CalculateStats() {
-  double avg_frame_time = 0, avg_fps = 0;
+void StatsCalculator::Subscribe(EventResponse::EventCase event_type,
+                                std::string client_id, uint32_t interval) {
+  std::shared_ptr<StatsSubscription> subscription =
+      std::make_shared<StatsSubscription>();
 
-  uint64_t frame_time_sum = 0;
-  std::deque<std::chrono::nanoseconds> frame_times;
+  if (event_type != EventResponse::EventCase::kApplicationStatsEvent &&
+      event_type != EventResponse::EventCase::kOverlayStatsEvent) {
+    return;
+  }
 
-  // TODO: Handle stopping threads
-  while (true) {
-    std::deque<std::chrono::nanoseconds> new_frame_times;
+  std::lock_guard subscriptions_lk(subscriptions_mutex_);
 
-    // Wait for new data
-    std::unique_lock lk(frame_times_mutex_);
-    calc_cv_.wait(lk);
+  // Replace the previous subscription of the client
+  RemoveSubscription(event_type, client_id);
 
-    std::swap(frame_times_, new_frame_times);
-    lk.unlock();
+  subscription->event_type = event_type;
+  subscription->client_id = client_id;
 
-    for (auto& frame_time : new_frame_times) {
-      frame_times.push_back(frame_time);
-      frame_time_sum += frame_time.count();
+  if (event_type == EventResponse::EventCase::kApplicationStatsEvent) {
+    // Frames weren't recorded while there were no subscribers
+    if (frame_stats_subscribers_ == 0) {
+      first_subscribed_frame_ = frames_count_.load();
     }
+    frame_stats_subscribers_++;
+
+    subscription->last_frames_count = frames_count_;
+    subscription->frame_times.reserve(FRAME_TIMESTAMPS_CAPACITY);
+  } else {
+    overlay_stats_subscribers_++;
+
+    LoadRenderStatsTotals(subscription->last_render_stats_totals,
+                          subscription->last_render_frames,
+                          subscription->last_render_frames_over_budget);
+  }
+
+  subscription->task_id = Core::Get()->get_scheduler()->SchedulePeriodicTask(
+      std::chrono::milliseconds(
+          interval == 0 ? STATS_DEFAULT_INTERVAL
+                        : std::max<uint32_t>(interval, STATS_MIN_INTERVAL)),
+      [this, subscription]() { CalculateStats(*subscription); });
+
+  subscriptions_[std::make_pair(event_type, client_id)] = subscription;
+}
+
+void StatsCalculator::Unsubscribe(EventResponse::EventCase event_type,
+                                  std::string client_id) {
+  std::lock_guard subscriptions_lk(subscriptions_mutex_);
+
+  RemoveSubscription(event_type, client_id);
+}
+
+void StatsCalculator::AddInputLatencies(
+    const std::string &client_id,
+    const google::protobuf::RepeatedField<uint32_t> &latencies) {
+  std::lock_guard subscriptions_lk(subscriptions_mutex_);
+
+  // Ignore clients that don't get the overlay stats
+  if (!subscriptions_.count(std::make_pair(
+          EventResponse::EventCase::kOverlayStatsEvent, client_id))) {
+    return;
+  }
+
+  std::lock_guard input_latencies_lk(input_latencies_mutex_);
+  std::vector<uint32_t> &client_latencies = input_latencies_[client_id];
+
+  client_latencies.insert(
+      client_latencies.end(), latencies.begin(),
+      latencies.begin() +
+          std::min<size_t>(latencies.size(), INPUT_LATENCIES_CAPACITY -
+                                                 client_latencies.size()));
+}
+
+bool StatsCalculator::is_frame_stats_subscribed() const {
+  return frame_stats_subscribers_.load(std::memory_order_relaxed) != 0;
+}
+
+bool StatsCalculator::is_overlay_stats_subscribed() const {
+  return overlay_stats_subscribers_.load(std::memory_order_relaxed) != 0;
+}
+
+void StatsCalculator::CalculateStats(StatsSubscription &subscription) {
+  OverlayStats overlay_stats;
+
+  switch (subscription.event_type) {
+    case EventResponse::EventCase::kApplicationStatsEvent:
+      // Wait for new frames
+      if (CollectFrameTimes(subscription.last_frames_count,
+                            subscription.frame_times)) {
+        Core::Get()->get_graphics_manager()->SendApplicationStats(
+            subscription.client_id,
+            CalculateFrameStats(subscription.frame_times));
+      }
+      break;
+
+    case EventResponse::EventCase::kOverlayStatsEvent:
+      // Wait for rendered frames
+      if (CalculateOverlayStats(subscription, overlay_stats)) {
+        Core::Get()->get_graphics_manager()->SendOverlayStats(
+            subscription.client_id, overlay_stats);
+      }
+      break;
+
+    default:
+      break;
+  }
+}
+
+void StatsCalculator::RemoveSubscription(EventResponse::EventCase event_type,
+                                         std::string client_id) {
+  auto subscription =
+      subscriptions_.find(std::make_pair(event_type, client_id));
+
+  if (subscription == subscriptions_.end()) {
+    return;
+  }
+
+  Core::Get()->get_scheduler()->CancelTask(subscription->second->task_id);
+
+  if (event_type == EventResponse::EventCase::kApplicationStatsEvent) {
+    frame_stats_subscribers_--;
+  } else {
+    overlay_stats_subscribers_--;
+
+    std::lock_guard input_latencies_lk(input_latencies_mutex_);
+    input_latencies_.erase(client_id);
+  }
+
+  subscriptions_.erase(subscription);
+}
+
+bool StatsCalculator::CollectFrameTimes(
+    uint64_t &last_frames_count, std::vector<uint64_t> &frame_times) const {
+  uint64_t frames_count = frames_count_.load(std::memory_order_acquire);
+
+  // The slot of the next frame, at the published count, may be being written
+  // so only the other slots of the ring are copied
+  uint64_t first_frame = std::max<uint64_t>(
+      frames_count >= FRAME_TIMESTAMPS_CAPACITY
+          ? frames_count - (FRAME_TIMESTAMPS_CAPACITY - 1)
+          : 0,
+      first_subscribed_frame_);
 
-    // Remove old samples
-    while (frame_times.size() > frame_samples_cap_) {
-      frame_time_sum -= frame_times.front().count();
-      frame_times.pop_front();
+  std::array<uint64_t, FRAME_TIMESTAMPS_CAPACITY> timestamps;
+
+  if (frames_count == last_frames_count || frames_count < first_frame + 2) {
+    return false;
+  }
+  last_frames_count = frames_count;
+
+  for (uint64_t frame = first_frame; frame < frames_count; frame++) {
+    timestamps[frame - first_frame] =
+        frame_timestamps_[frame & (FRAME_TIMESTAMPS_CAPACITY - 1)].load(
+            std::memory_order_relaxed);
+  }
+
+  // Skip the timestamps that were overwritten while they were copied,
+  // including the slot that is being written for the next frame
+  std::atomic_thread_fence(std::memory_order_acquire);
+  frames_count = frames_count_.load(std::memory_order_relaxed);
+  if (frames_count >= FRAME_TIMESTAMPS_CAPACITY &&
+      frames_count - (FRAME_TIMESTAMPS_CAPACITY - 1) > first_frame) {
+    uint64_t overwritten =
+        frames_count - (FRAME_TIMESTAMPS_CAPACITY - 1) - first_frame;
+
+    // All of the copied timestamps were overwritten
+    if (overwritten + 2 > last_frames_count - first_frame) {
+      return false;
     }
 
-    avg_frame_time = frame_time_sum / (1000000.0 * frame_times.size());
-    avg_fps = 1 / avg_frame_time * 1000.0;
-    frame_samples_cap_ = (uint64_t)avg_fps;
+    std::copy(timestamps.begin() + overwritten,
+              timestamps.begin() + (last_frames_count - first_frame),
+              timestamps.begin());
+    first_frame += overwritten;
+  }
+
+  if (last_frames_count - first_frame < 2) {
+    return false;
+  }
+
+  // Calculate the frame times from the timestamps
+  frame_times.clear();
+  for (uint64_t i = 1; i < last_frames_count - first_frame; i++) {
+    frame_times.push_back(timestamps[i] - timestamps[i - 1]);
+  }
+
+  return true;
+}
+
+FrameStats StatsCalculator::CalculateFrameStats(
+    std::vector<uint64_t> &frame_times) const {
+  FrameStats stats = {0};
+
+  uint64_t average_time_sum = 0, average_frames = 0, low_frames_sum = 0;
+  size_t low_frames = std::max<size_t>(frame_times.size() / 100, 1);
+
+  // Calculate the averages from the last frames
+  for (auto it = frame_times.rbegin();
+       it != frame_times.rend() && average_time_sum < FRAME_STATS_AVERAGE_TIME;
+       it++) {
+    average_time_sum += *it;
+    average_frames++;
+  }
+  stats.frame_time = average_time_sum / (1000.0 * average_frames);
+  stats.fps = 1000.0 / stats.frame_time;
+
+  // Count the frames in each of the histogram buckets
+  for (auto frame_time : frame_times) {
+    stats.frame_time_histogram[std::upper_bound(
+                                   kFrameTimeHistogramBounds.begin(),
+                                   kFrameTimeHistogramBounds.end(),
+                                   frame_time / 1000.0) -
+                               kFrameTimeHistogramBounds.begin()]++;
+  }
+
+  std::sort(frame_times.begin(), frame_times.end());
+
+  stats.frame_time_p50 = Percentile(frame_times, 0.5) / 1000.0;
+  stats.frame_time_p95 = Percentile(frame_times, 0.95) / 1000.0;
+  stats.frame_time_p99 = Percentile(frame_times, 0.99) / 1000.0;
+  stats.frame_time_max = frame_times.back() / 1000.0;
+
+  // The FPS of the slowest 1% of the frames
+  for (auto it = frame_times.rbegin(); it != frame_times.rbegin() + low_frames;
+       it++) {
+    low_frames_sum += *it;
+  }
+  stats.one_percent_low_fps =
+      1000000.0 * low_frames / std::max<uint64_t>(low_frames_sum, 1);
+
+  return stats;
+}
+
+void StatsCalculator::LoadRenderStatsTotals(
+    RenderStats &totals, uint64_t &frames,
+    uint64_t &frames_over_budget) const {
+  frames = render_stats_totals_.frames.load(std::memory_order_acquire);
+  frames_over_budget = render_stats_totals_.frames_over_budget;
+
+  totals.render_time = render_stats_totals_.render_time;
+  totals.snapshot_time = render_stats_totals_.snapshot_time;
+  totals.texture_creation_time = render_stats_totals_.texture_creation_time;
+  totals.upload_time = render_stats_totals_.upload_time;
+  totals.draw_time = render_stats_totals_.draw_time;
+  totals.uploaded_bytes = render_stats_totals_.uploaded_bytes;
+  totals.created_textures = render_stats_totals_.created_textures;
+  totals.drawn_sprites = render_stats_totals_.drawn_sprites;
+}
+
+bool StatsCalculator::CalculateOverlayStats(StatsSubscription &subscription,
+                                            OverlayStats &overlay_stats) {
+  RenderStats totals = {0};
+  const RenderStats &last_totals = subscription.last_render_stats_totals;
+
+  uint64_t frames = 0, frames_over_budget = 0, render_time_max = 0;
+
+  LoadRenderStatsTotals(totals, frames, frames_over_budget);
+  if (frames == subscription.last_render_frames) {
+    return false;
+  }
+
+  overlay_stats.frames = frames - subscription.last_render_frames;
+  overlay_stats.frames_over_budget =
+      frames_over_budget - subscription.last_render_frames_over_budget;
+
+  // Find the slowest of the new frames that are still in the ring, without
+  // the slot that may be being written for the next frame
+  for (uint64_t frame = std::max<uint64_t>(
+           subscription.last_render_frames,
+           frames >= FRAME_TIMESTAMPS_CAPACITY
+               ? frames - (FRAME_TIMESTAMPS_CAPACITY - 1)
+               : 0);
+       frame < frames; frame++) {
+    render_time_max = std::max<uint64_t>(
+        render_time_max,
+        render_times_[frame & (FRAME_TIMESTAMPS_CAPACITY - 1)].load(
+            std::memory_order_relaxed));
+  }
+
+  // Average the totals of the new frames
+  auto average = [&overlay_stats](uint64_t total, uint64_t last_total) {
+    return (double)(total - last_total) / overlay_stats.frames;
+  };
 
-    Core::Get()->get_graphics_manager()->BroadcastApplicationStats(
-        avg_frame_time, avg_fps);
+  overlay_stats.render_time =
+      average(totals.render_time, last_totals.render_time) / 1000.0;
+  overlay_stats.render_time_max = render_time_max / 1000.0;
+  overlay_stats.snapshot_time =
+      average(totals.snapshot_time, last_totals.snapshot_time) / 1000.0;
+  overlay_stats.texture_creation_time =
+      average(totals.texture_creation_time,
+              last_totals.texture_creation_time) /
+      1000.0;
+  overlay_stats.upload_time =
+      average(totals.upload_time, last_totals.upload_time) / 1000.0;
+  overlay_stats.draw_time =
+      average(totals.draw_time, last_totals.draw_time) / 1000.0;
+  overlay_stats.uploaded_bytes =
+      average(totals.uploaded_bytes, last_totals.uploaded_bytes);
+  overlay_stats.created_textures =
+      average(totals.created_textures, last_totals.created_textures);
+  overlay_stats.drawn_sprites =
+      average(totals.drawn_sprites, last_totals.drawn_sprites);
+
+  subscription.last_render_stats_totals = totals;
+  subscription.last_render_frames = frames;
+  subscription.last_render_frames_over_budget = frames_over_budget;
+
+  CalculateInputLatencies(subscription, overlay_stats);
+
+  return true;
+}
+
+void StatsCalculator::CalculateInputLatencies(StatsSubscription &subscription,
+                                              OverlayStats &overlay_stats) {
+  std::vector<uint32_t> &latencies = subscription.input_latencies;
+
+  // Take the latencies the client reported, the vectors are swapped so their
+  // memory is reused
+  latencies.clear();
+  {
+    std::lock_guard input_latencies_lk(input_latencies_mutex_);
+
+    auto client_latencies = input_latencies_.find(subscription.client_id);
+    if (client_latencies != input_latencies_.end()) {
+      latencies.swap(client_latencies->second);
+    }
+  }
+
+  overlay_stats.input_events = (uint32_t)latencies.size();
+  if (latencies.empty()) {
+    overlay_stats.input_latency_p50 = 0;
+    overlay_stats.input_latency_p95 = 0;
+    overlay_stats.input_latency_p99 = 0;
+    overlay_stats.input_latency_max = 0;
+    return;
   }
+
+  std::sort(latencies.begin(), latencies.end());
+
+  overlay_stats.input_latency_p50 = Percentile(latencies, 0.5) / 1000.0;
+  overlay_stats.input_latency_p95 = Percentile(latencies, 0.95) / 1000.0;
+  overlay_stats.input_latency_p99 = Percentile(latencies, 0.99) / 1000.0;
+  overlay_stats.input_latency_max = latencies.back() / 1000.0;
 }
 
 }  // namespace graphics
 }  // namespace core
-}  // namespace overlay
\ No newline at end of file
+}  // namespace overlay
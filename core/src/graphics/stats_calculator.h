@@ -1,38 +1,165 @@
 #pragma once
 
-#include <chrono>
-#include <condition_variable>
-#include <deque>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
 #include <mutex>
-#include <thread>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
-#define INITIAL_FRAME_SAMPLES_CAP 50
-#define STATS_CALC_TIME std::chrono::milliseconds(35)
+#include "events.pb.h"
+#include "graphics_renderer.h"
+#include "utils/scheduler.h"
+
+#define FRAME_TIMESTAMPS_CAPACITY 1024  // Must be a power of 2
+#define FRAME_STATS_AVERAGE_TIME 1000000  // Microseconds
+#define FRAME_TIME_HISTOGRAM_BUCKETS 10
+#define OVERLAY_FRAME_BUDGET 1000  // Microseconds
+#define STATS_DEFAULT_INTERVAL 35  // Milliseconds
+#define STATS_MIN_INTERVAL 10  // Milliseconds
+#define INPUT_LATENCIES_CAPACITY 4096  // Per client between stats events
 
 namespace overlay {
 namespace core {
 namespace graphics {
 
+struct FrameStats {
+  // Averages of the last second
+  double frame_time;
+  double fps;
+
+  // Distribution of all of the frames in the ring
+  double frame_time_p50;
+  double frame_time_p95;
+  double frame_time_p99;
+  double frame_time_max;
+  double one_percent_low_fps;
+  std::array<uint32_t, FRAME_TIME_HISTOGRAM_BUCKETS> frame_time_histogram;
+};
+
+// Average cost of the overlay per frame since the previous calculation, all of
+// the times are in milliseconds
+struct OverlayStats {
+  uint64_t frames;
+  uint64_t frames_over_budget;
+
+  double render_time;
+  double render_time_max;
+  double snapshot_time;
+  double texture_creation_time;
+  double upload_time;
+  double draw_time;
+
+  double uploaded_bytes;
+  double created_textures;
+  double drawn_sprites;
+
+  // Reported by the client after each of its overlay stats events
+  uint32_t input_events;
+  double input_latency_p50;
+  double input_latency_p95;
+  double input_latency_p99;
+  double input_latency_max;
+};
+
 class StatsCalculator {
  public:
+  // Upper bounds of the histogram buckets in milliseconds, the last bucket
+  // holds all of the frames above the last bound
+  static constexpr std::array<double, FRAME_TIME_HISTOGRAM_BUCKETS - 1>
+      kFrameTimeHistogramBounds = {4.167, 6.944, 8.333, 11.111, 16.667,
+                                   33.333, 50, 100, 250};
+
   StatsCalculator();
 
-  void Frame();
+  void Frame(uint64_t timestamp);
+  void RenderFrame(const RenderStats &render_stats);
+
+  // Stats are calculated separately for each subscriber in its own interval
+  void Subscribe(EventResponse::EventCase event_type, std::string client_id,
+                 uint32_t interval);
+  void Unsubscribe(EventResponse::EventCase event_type, std::string client_id);
+
+  // Adds the input latencies a client measured, in microseconds, to its next
+  // overlay stats
+  void AddInputLatencies(
+      const std::string &client_id,
+      const google::protobuf::RepeatedField<uint32_t> &latencies);
+
+  bool is_frame_stats_subscribed() const;
+  bool is_overlay_stats_subscribed() const;
 
  private:
-  std::chrono::high_resolution_clock::time_point frame_render_start_;
-  std::deque<std::chrono::nanoseconds> frame_times_;
-  std::mutex frame_times_mutex_;
+  // Totals of all of the rendered frames, written only by the presenting thread
+  struct RenderStatsTotals {
+    std::atomic<uint64_t> frames;
+    std::atomic<uint64_t> frames_over_budget;
+    std::atomic<uint64_t> render_time;
+    std::atomic<uint64_t> snapshot_time;
+    std::atomic<uint64_t> texture_creation_time;
+    std::atomic<uint64_t> upload_time;
+    std::atomic<uint64_t> draw_time;
+    std::atomic<uint64_t> uploaded_bytes;
+    std::atomic<uint64_t> created_textures;
+    std::atomic<uint64_t> drawn_sprites;
+  };
+
+  // State of a subscriber, only accessed by the scheduler thread
+  struct StatsSubscription {
+    EventResponse::EventCase event_type;
+    std::string client_id;
+    utils::ScheduledTaskId task_id;
+
+    uint64_t last_frames_count;
+    std::vector<uint64_t> frame_times;
+
+    RenderStats last_render_stats_totals;
+    uint64_t last_render_frames;
+    uint64_t last_render_frames_over_budget;
+    std::vector<uint32_t> input_latencies;
+  };
+
+  // Rings of the present timestamps and render times, written only by the
+  // presenting thread
+  std::array<std::atomic<uint64_t>, FRAME_TIMESTAMPS_CAPACITY>
+      frame_timestamps_;
+  std::atomic<uint64_t> frames_count_;
+  std::atomic<uint64_t> first_subscribed_frame_;
+
+  std::array<std::atomic<uint64_t>, FRAME_TIMESTAMPS_CAPACITY> render_times_;
+  RenderStatsTotals render_stats_totals_;
+
+  std::map<std::pair<EventResponse::EventCase, std::string>,
+           std::shared_ptr<StatsSubscription>>
+      subscriptions_;
+  std::atomic<uint32_t> frame_stats_subscribers_;
+  std::atomic<uint32_t> overlay_stats_subscribers_;
+  std::mutex subscriptions_mutex_;
+
+  // Input latencies of each client with overlay stats since its last event
+  std::unordered_map<std::string, std::vector<uint32_t>> input_latencies_;
+  std::mutex input_latencies_mutex_;
 
-  std::chrono::high_resolution_clock::time_point last_calc_time_;
-  std::thread calc_thread_;
-  std::condition_variable calc_cv_;
+  void CalculateStats(StatsSubscription &subscription);
+  void RemoveSubscription(EventResponse::EventCase event_type,
+                          std::string client_id);
 
-  uint64_t frame_samples_cap_;
+  bool CollectFrameTimes(uint64_t &last_frames_count,
+                         std::vector<uint64_t> &frame_times) const;
+  FrameStats CalculateFrameStats(std::vector<uint64_t> &frame_times) const;
 
-  void CalculateStats();
+  void LoadRenderStatsTotals(RenderStats &totals, uint64_t &frames,
+                             uint64_t &frames_over_budget) const;
+  bool CalculateOverlayStats(StatsSubscription &subscription,
+                             OverlayStats &overlay_stats);
+  void CalculateInputLatencies(StatsSubscription &subscription,
+                               OverlayStats &overlay_stats);
 };
 
 }  // namespace graphics
 }  // namespace core
-}  // namespace overlay
\ No newline at end of file
+}  // namespace overlay
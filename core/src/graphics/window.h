@@ -7,6 +7,7 @@
 #include <string>
 #include <utility>
 
+#include "input_mask.h"
 #include "rect.h"
 #include "sprite.h"
 #include "utils/guid.h"
@@ -57,11 +58,31 @@ struct Window {
 
   HCURSOR cursor;
 
+  // The parts of the window that take mouse input, null for all of it. When
+  // the threshold is set the mask is built from the alpha of the latest
+  // buffer once the routing needs it, and the buffer updates tell which
+  // buffer it was built from
+  std::shared_ptr<const InputMask> input_mask;
+  uint8_t input_mask_alpha_threshold;
+  uint64_t input_mask_buffer_updates;
+
   std::shared_ptr<Sprite> sprite;
 
   std::mutex mutex;
 };
 
+// A window's place in the mouse routing
+struct WindowInputRegion {
+  WindowUniqueId id;
+  Rect rect;
+  std::shared_ptr<const InputMask> mask;  // Null if all of the rect takes input
+
+  // The sprite of a window with an alpha mask and its buffer updates when
+  // the mask was built, the mask is stale once the sprite got another buffer
+  std::shared_ptr<Sprite> alpha_sprite;
+  uint64_t alpha_buffer_updates;
+};
+
 }  // namespace graphics
 }  // namespace core
 }  // namespace overlay
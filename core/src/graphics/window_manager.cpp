@@ -4,13 +4,22 @@
 #include <loguru/loguru.hpp>
 
 #include "core.h"
+#include "input/input_recorder.h"
+#include "software_compositor.h"
+#include "utils/buffer_codec.h"
 #include "utils/guid.h"
 #include "utils/rect.h"
+#include "utils/timestamp.h"
+#include "utils/trace_recorder.h"
 
 namespace overlay {
 namespace core {
 namespace graphics {
 
+WindowManager::WindowManager()
+    : window_regions_(
+          std::make_shared<const std::vector<WindowInputRegion>>()) {}
+
 GUID WindowManager::CreateWindowGroup(std::string client_id,
                                       WindowGroupAttributes attributes) {
   std::shared_ptr<WindowGroup> window_group = std::make_shared<WindowGroup>();
@@ -151,6 +160,9 @@ GUID WindowManager::CreateWindowInGroup(const WindowGroupUniqueId &group_id,
   window->rect = rect;
   window->attributes = attributes;
   window->cursor = LoadCursor(NULL, IDC_ARROW);
+  window->input_mask = nullptr;
+  window->input_mask_alpha_threshold = 0;
+  window->input_mask_buffer_updates = 0;
   window->sprite = std::make_shared<Sprite>();
   window->sprite->rect = rect;
   window->sprite->opacity =
@@ -202,14 +214,27 @@ bool WindowManager::UpdateWindowAttributes(const WindowUniqueId &id,
   std::shared_ptr<Window> window = GetWindowWithId(id);
 
   std::shared_ptr<Sprite> sprite = nullptr;
+  std::shared_ptr<WindowGroup> window_group = nullptr;
 
   bool update_sprites = false;
-  double old_opacity = 0;
+  double group_opacity = 0;
 
   if (!window) {
     return false;
   }
 
+  // Get the opacity of the window group
+  try {
+    std::lock_guard window_groups_lk(window_groups_mutex_);
+    window_group = window_groups_.at(id.GetGroupId());
+  } catch (...) {
+    return false;
+  }
+
+  std::unique_lock window_group_lk(window_group->mutex);
+  group_opacity = window_group->attributes.opacity;
+  window_group_lk.unlock();
+
   std::unique_lock window_lk(window->mutex);
 
   // Check if sprites needs to be updated
@@ -218,12 +243,13 @@ bool WindowManager::UpdateWindowAttributes(const WindowUniqueId &id,
   }
 
   sprite = window->sprite;
-  old_opacity = window->attributes.opacity;
   window->attributes = attributes;
   window_lk.unlock();
 
+  // Calculate the opacity from the attributes instead of the sprite's
+  // current opacity, which can't be recovered once it's 0
   sprites_lk.lock();
-  sprite->opacity = (sprite->opacity / old_opacity) * attributes.opacity;
+  sprite->opacity = attributes.opacity * group_opacity;
   sprites_lk.unlock();
 
   if (update_sprites) {
@@ -240,31 +266,23 @@ bool WindowManager::SetWindowRect(const WindowUniqueId &id, const Rect &rect) {
 
   std::shared_ptr<Sprite> sprite = nullptr;
 
-  bool regenerate_texture = false;
-  double old_opacity = 0;
-
   if (!window) {
     return false;
   }
 
   std::unique_lock window_lk(window->mutex);
-
-  // Check if the texture needs to be regenerated
-  if (window->rect.height != rect.height || window->rect.width != rect.width) {
-    regenerate_texture = true;
-  }
-
   sprite = window->sprite;
   window->rect = rect;
   window_lk.unlock();
 
+  // The texture is kept and scaled to the new rect until the client sends a
+  // buffer in the new size
   sprites_lk.lock();
-
-  if (regenerate_texture) {
-    sprite->FreeTexture();
-  }
-
   sprite->rect = rect;
+  sprites_lk.unlock();
+
+  // Route the input to the new rect
+  UpdateInputRegion(window);
 
   return true;
 }
@@ -289,6 +307,33 @@ bool WindowManager::SetWindowCursor(const WindowUniqueId &id,
   return true;
 }
 
+bool WindowManager::SetWindowInputMask(const WindowUniqueId &id,
+                                       std::vector<Rect> rects,
+                                       uint8_t alpha_threshold) {
+  std::shared_ptr<Window> window = GetWindowWithId(id);
+  std::shared_ptr<const InputMask> input_mask = nullptr;
+
+  if (!window) {
+    return false;
+  }
+
+  // The alpha mask is built from the window's buffers once the routing needs
+  // it, until then it's stale unless the window has no buffer
+  if (!alpha_threshold && !rects.empty()) {
+    input_mask = InputMask::FromRects(std::move(rects));
+  }
+
+  std::unique_lock window_lk(window->mutex);
+  window->input_mask = input_mask;
+  window->input_mask_alpha_threshold = alpha_threshold;
+  window->input_mask_buffer_updates = 0;
+  window_lk.unlock();
+
+  UpdateInputRegion(window);
+
+  return true;
+}
+
 bool WindowManager::FocusWindowInGroup(const WindowUniqueId &id) {
   std::shared_ptr<Window> window = nullptr;
   std::shared_ptr<WindowGroup> window_group = nullptr;
@@ -369,29 +414,194 @@ void WindowManager::DestroyWindowInGroup(const WindowUniqueId &id) {
   UpdateWindows();
 }
 
-void WindowManager::UpdateWindowBufferInGroup(const WindowUniqueId &id,
-                                              std::string &&buffer) {
+bool WindowManager::GetWindowBufferResolution(const WindowUniqueId &id,
+                                              uint32_t &width,
+                                              uint32_t &height) {
+  std::shared_ptr<Window> window = GetWindowWithId(id);
+
+  if (!window) {
+    return false;
+  }
+
+  // Buffers without a resolution are in the size of the window
+  if (width == 0 || height == 0) {
+    std::lock_guard window_lk(window->mutex);
+    width = window->rect.width;
+    height = window->rect.height;
+  }
+
+  return true;
+}
+
+BufferUpdateResult WindowManager::UpdateWindowBufferInGroup(
+    const WindowUniqueId &id, std::string &&buffer, uint32_t width,
+    uint32_t height, uint64_t generation, bool delta, uint64_t base_generation,
+    BufferStats &buffer_stats) {
+  TRACE_SCOPE("windows", "UpdateWindowBufferInGroup");
   std::shared_ptr<Window> window = GetWindowWithId(id);
   std::shared_ptr<Sprite> sprite = nullptr;
 
   if (!window) {
-    return;
+    return BufferUpdateResult::UnknownWindow;
   }
 
   std::unique_lock window_lk(window->mutex);
   sprite = window->sprite;
+
+  // Buffers without a resolution are in the size of the window
+  if (width == 0 || height == 0) {
+    width = window->rect.width;
+    height = window->rect.height;
+  }
   window_lk.unlock();
 
+  // Verify the size of the buffer
+  if (buffer.size() != (size_t)width * height * sizeof(uint32_t)) {
+    return BufferUpdateResult::InvalidBuffer;
+  }
+
+  // The render thread only reads the sprite's buffer and replaces it while
+  // holding the mailbox's lock, so the sprites don't need to be locked
+  std::unique_lock pending_buffer_lk(sprite->pending_buffer_mutex);
+
+  // Reconstruct the buffer from the latest buffer of the window, which has
+  // to be the delta's base. A buffer that was rejected or dropped on the way
+  // leaves another base, and the client sends a full buffer after the
+  // rejection
+  if (delta &&
+      (base_generation != (sprite->has_pending_buffer
+                               ? sprite->pending_buffer_generation
+                               : sprite->buffer_generation) ||
+       width != (sprite->has_pending_buffer ? sprite->pending_buffer_width
+                                            : sprite->buffer_width) ||
+       height != (sprite->has_pending_buffer ? sprite->pending_buffer_height
+                                             : sprite->buffer_height) ||
+       !utils::BufferCodec::ApplyXorDelta(
+           buffer, sprite->has_pending_buffer ? sprite->pending_buffer
+                                              : sprite->buffer))) {
+    buffer_stats = sprite->buffer_stats;
+    return BufferUpdateResult::BaseMismatch;
+  }
+
+  // Replace the buffer that wasn't rendered yet
+  if (sprite->has_pending_buffer) {
+    sprite->buffer_stats.dropped_buffers++;
+  }
+
+  sprite->pending_buffer = std::move(buffer);
+  sprite->pending_buffer_width = width;
+  sprite->pending_buffer_height = height;
+  sprite->pending_buffer_generation = generation;
+  sprite->has_pending_buffer = true;
+  sprite->pending_buffer_timestamp = utils::timestamp::GetTimestamp();
+  sprite->buffer_stats.received_buffers++;
+  sprite->buffer_updates.fetch_add(1, std::memory_order_relaxed);
+  buffer_stats = sprite->buffer_stats;
+  pending_buffer_lk.unlock();
+
+  return BufferUpdateResult::Updated;
+}
+
+void WindowManager::RenderWindows(std::unique_ptr<IGraphicsRenderer> &renderer,
+                                  RenderStats &render_stats) {
+  TRACE_SCOPE("graphics", "RenderWindows");
+  uint64_t start_timestamp = utils::timestamp::GetTimestamp();
+
   std::lock_guard sprites_lk(sprites_mutex_);
-  sprite->buffer = std::move(buffer);
+
+  // Take the latest buffers of the windows
+  for (auto &sprite : sprites_) {
+    TakePendingBuffer(sprite, start_timestamp);
+  }
+  if (render_stats.measured) {
+    render_stats.snapshot_time =
+        utils::timestamp::GetTimestamp() - start_timestamp;
+  }
+
+  // Render the windows' sprites
+  renderer->RenderSprites(sprites_, render_stats);
+}
+
+void WindowManager::TakePendingBuffer(const std::shared_ptr<Sprite> &sprite,
+                                      uint64_t render_timestamp) {
+  uint64_t latency = 0;
+
+  // Let the renderer finish uploading the current buffer, newer buffers
+  // keep replacing each other in the mailbox meanwhile
+  if (sprite->uploading) {
+    return;
+  }
+
+  // Don't wait for a buffer that is being received, it will be rendered in
+  // the next frame
+  std::unique_lock pending_buffer_lk(sprite->pending_buffer_mutex,
+                                     std::try_to_lock);
+  if (!pending_buffer_lk.owns_lock() || !sprite->has_pending_buffer) {
+    return;
+  }
+
+  // Keep the allocation of the previous buffer for the next buffer
+  sprite->buffer.swap(sprite->pending_buffer);
+  sprite->buffer_width = sprite->pending_buffer_width;
+  sprite->buffer_height = sprite->pending_buffer_height;
+  sprite->buffer_generation = sprite->pending_buffer_generation;
   sprite->buffer_updated = true;
+  sprite->has_pending_buffer = false;
+
+  // Update the latency of the window
+  latency = render_timestamp > sprite->pending_buffer_timestamp
+                ? render_timestamp - sprite->pending_buffer_timestamp
+                : 0;
+  sprite->buffer_stats.presented_buffers++;
+  sprite->buffer_stats.latency =
+      sprite->buffer_stats.latency
+          ? (sprite->buffer_stats.latency * 7 + latency) / 8
+          : latency;
+  sprite->buffer_stats.latency_max =
+      std::max<uint64_t>(sprite->buffer_stats.latency_max, latency);
 }
 
-void WindowManager::RenderWindows(
-    std::unique_ptr<IGraphicsRenderer> &renderer) {
-  // Render the windows' sprites
-  std::lock_guard sprites_lk(sprites_mutex_);
-  renderer->RenderSprites(sprites_);
+bool WindowManager::CompositeWindows(uint32_t width, uint32_t height,
+                                     std::string &target) {
+  TRACE_SCOPE("graphics", "CompositeWindows");
+  std::vector<std::shared_ptr<Sprite>> sprites;
+
+  // Copy the sprites so they're composited without blocking the renderer
+  {
+    std::lock_guard sprites_lk(sprites_mutex_);
+
+    sprites.reserve(sprites_.size());
+    for (auto &sprite : sprites_) {
+      sprites.push_back(CopySpriteForComposite(*sprite));
+    }
+  }
+
+  return SoftwareCompositor::Composite(sprites, width, height, target);
+}
+
+std::shared_ptr<Sprite> WindowManager::CopySpriteForComposite(Sprite &sprite) {
+  std::shared_ptr<Sprite> copy = std::make_shared<Sprite>();
+
+  copy->fill_target = sprite.fill_target;
+  copy->rect = sprite.rect;
+  copy->opacity = sprite.opacity;
+  copy->solid_color = sprite.solid_color;
+  copy->color = sprite.color;
+
+  // Copy the latest buffer without taking it from the mailbox, the renderer
+  // still takes the pending buffer in its next frame
+  std::lock_guard pending_buffer_lk(sprite.pending_buffer_mutex);
+  if (sprite.has_pending_buffer) {
+    copy->buffer = sprite.pending_buffer;
+    copy->buffer_width = sprite.pending_buffer_width;
+    copy->buffer_height = sprite.pending_buffer_height;
+  } else {
+    copy->buffer = sprite.buffer;
+    copy->buffer_width = sprite.buffer_width;
+    copy->buffer_height = sprite.buffer_height;
+  }
+
+  return copy;
 }
 
 void WindowManager::OnResize() {
@@ -416,7 +626,7 @@ const WindowUniqueId WindowManager::GetHoveredWindowId() {
   return hovered_window_id_;
 }
 
-void WindowManager::SendWindowEventToWindow(EventResponse event,
+void WindowManager::SendWindowEventToWindow(EventResponse &event,
                                             const WindowUniqueId &window_id) {
   CHECK_F(event.event_case() == EventResponse::kWindowEvent && window_id);
 
@@ -438,7 +648,7 @@ void WindowManager::SendWindowEventToWindow(EventResponse event,
       window_id.client_id, event);
 }
 
-void WindowManager::SendWindowEventToFocusedWindow(EventResponse event) {
+void WindowManager::SendWindowEventToFocusedWindow(EventResponse &event) {
   CHECK_F(event.event_case() == EventResponse::kWindowEvent);
 
   WindowUniqueId focused_window_id = GetFocusedWindowId();
@@ -449,80 +659,118 @@ void WindowManager::SendWindowEventToFocusedWindow(EventResponse event) {
   SendWindowEventToWindow(event, focused_window_id);
 }
 
-void WindowManager::HandleMouseEvent(EventResponse event, POINT point) {
+void WindowManager::SendEventToFocusedWindowClient(
+    const EventResponse &event) {
+  WindowUniqueId focused_window_id = GetFocusedWindowId();
+  if (!focused_window_id) {
+    return;
+  }
+
+  Core::Get()->get_rpc_server()->get_events_service()->SendEventToClient(
+      focused_window_id.client_id, event);
+}
+
+void WindowManager::HandleMouseEvent(EventResponse &event, POINT point,
+                                     bool buttons_down) {
   CHECK_F(event.event_case() == EventResponse::kWindowEvent);
 
-  WindowUniqueId focused_window_id = GetFocusedWindowId();
-  WindowUniqueId new_hovered_window_id;
+  UpdateAlphaInputMasks(point);
 
-  std::vector<std::pair<WindowUniqueId, Rect>> window_rects;
-  {
-    std::lock_guard window_rects_lk(window_rects_mutex_);
-    window_rects = window_rects_;
-  }
+  MouseEventRoute route;
+  std::shared_ptr<const std::vector<WindowInputRegion>> window_regions =
+      GetWindowRegions();
 
   EventResponse::WindowEvent *window_event = event.mutable_windowevent();
   EventResponse::WindowEvent::MouseInputEvent *input_event =
       window_event->mutable_mouseinputevent();
 
-  bool in_rect = false, focused = false;
+  RouteMouseEvent(*window_regions, GetFocusedWindowId(), captured_window_id_,
+                  input_event->type(), point, buttons_down, route);
 
-  for (auto window_it = window_rects.rbegin(); window_it != window_rects.rend();
-       window_it++) {
-    in_rect = utils::Rect::PointInRect(point, window_it->second);
-    focused = window_it->first == focused_window_id;
+  if (input::InputRecorder::Get()->is_recording()) {
+    input::InputRecorder::Get()->RecordMouseInput(input_event->type(), point,
+                                                  buttons_down);
+  }
 
-    if (focused && !in_rect &&
-        input_event->type() ==
-            EventResponse::WindowEvent::MouseInputEvent::MOUSE_BUTTON_DOWN) {
-      FocusWindow(nullptr);
-      focused = false;
-    }
+  // Blur the focused window when pressing outside of it
+  if (route.blur_focused_window) {
+    FocusWindow(nullptr);
+  }
 
-    // If the event is in the window or the window is the focused window
-    if (in_rect || focused) {
-      // Send mouse move and mouse button up to focused window even if not in
-      // rect or send every event except mouse button up to the window the event
-      // occurred in
-      if ((focused && !in_rect &&
-           !(input_event->type() ==
-                 EventResponse::WindowEvent::MouseInputEvent::MOUSE_MOVE ||
-             input_event->type() == EventResponse::WindowEvent::
-                                        MouseInputEvent::MOUSE_BUTTON_UP)) ||
-          (in_rect && !focused &&
-           input_event->type() ==
-               EventResponse::WindowEvent::MouseInputEvent::MOUSE_BUTTON_UP)) {
-        continue;
-      }
-
-      if (window_it->first) {
-        input_event->set_x(point.x - window_it->second.x);
-        input_event->set_y(point.y - window_it->second.y);
-
-        SendWindowEventToWindow(event, window_it->first);
-      }
-
-      // Focus on the window that was pressed
-      if (input_event->type() ==
-          EventResponse::WindowEvent::MouseInputEvent::MOUSE_BUTTON_DOWN) {
-        FocusWindowInGroup(window_it->first);
-      } else if (input_event->type() ==
-                     EventResponse::WindowEvent::MouseInputEvent::MOUSE_MOVE &&
-                 in_rect) {
-        new_hovered_window_id = window_it->first;
-      }
-
-      // If we found the window the event occurred in, break
-      if (in_rect) {
-        break;
-      }
-    }
+  if (route.window_id) {
+    input_event->set_x(route.x);
+    input_event->set_y(route.y);
+
+    SendWindowEventToWindow(event, *route.window_id);
+  }
+
+  // Focus on the window that was pressed
+  if (route.focus_window_id) {
+    FocusWindowInGroup(*route.focus_window_id);
   }
 
   // If the mouse moved, update the hovered window
   if (input_event->type() ==
       EventResponse::WindowEvent::MouseInputEvent::MOUSE_MOVE) {
-    SetHoveredWindow(new_hovered_window_id);
+    SetHoveredWindow(route.hovered_window_id ? *route.hovered_window_id
+                                             : WindowUniqueId());
+  }
+
+  // Record the events the windows got so the replay can compare them
+  if (input::InputRecorder::Get()->is_recording()) {
+    input::InputRecorder::Get()->RecordRoute(
+        route.window_id ? *route.window_id : WindowUniqueId(), route.x,
+        route.y, GetFocusedWindowId(), GetHoveredWindowId());
+  }
+
+  // Only copy the captured window's id when the capture changes
+  if (!route.capture_window_id) {
+    if (captured_window_id_) {
+      captured_window_id_ = WindowUniqueId();
+    }
+  } else if (*route.capture_window_id != captured_window_id_) {
+    captured_window_id_ = *route.capture_window_id;
+  }
+}
+
+bool WindowManager::IsMouseInputPassThrough(POINT point) {
+  bool masked = false;
+
+  // The captured window gets the input wherever it is
+  if (captured_window_id_) {
+    return false;
+  }
+
+  UpdateAlphaInputMasks(point);
+
+  std::shared_ptr<const std::vector<WindowInputRegion>> window_regions =
+      GetWindowRegions();
+
+  // Let the game get the input that fell through the masks of all the windows
+  // under the pointer, the input outside of all the windows stays blocked
+  for (auto region_it = window_regions->rbegin();
+       region_it != window_regions->rend(); region_it++) {
+    if (!utils::Rect::PointInRect(point, region_it->rect)) {
+      continue;
+    }
+
+    if (IsPointInRegion(*region_it, point)) {
+      return false;
+    }
+
+    masked = true;
+  }
+
+  return masked;
+}
+
+bool WindowManager::HasCapturedWindow() const {
+  return (bool)captured_window_id_;
+}
+
+void WindowManager::ReleaseCapturedWindow() {
+  if (captured_window_id_) {
+    captured_window_id_ = WindowUniqueId();
   }
 }
 
@@ -567,7 +815,8 @@ void WindowManager::SetHoveredWindow(const WindowUniqueId &window_id) {
 }
 
 void WindowManager::UpdateWindows() {
-  std::vector<std::pair<WindowUniqueId, Rect>> window_rects;
+  std::shared_ptr<std::vector<WindowInputRegion>> window_regions =
+      std::make_shared<std::vector<WindowInputRegion>>();
   std::vector<std::shared_ptr<Sprite>> sprites;
 
   std::vector<std::shared_ptr<WindowGroup>> window_groups;
@@ -641,7 +890,10 @@ void WindowManager::UpdateWindows() {
     std::lock_guard window_lk(window->mutex);
 
     sprites.push_back(window->sprite);
-    window_rects.push_back(std::make_pair(window->id, window->rect));
+    window_regions->push_back(
+        {window->id, window->rect, window->input_mask,
+         window->input_mask_alpha_threshold ? window->sprite : nullptr,
+         window->input_mask_buffer_updates});
   }
 
   {
@@ -651,10 +903,143 @@ void WindowManager::UpdateWindows() {
   }
 
   {
-    // Swap the rects vector
-    std::lock_guard window_rects_lk(window_rects_mutex_);
-    window_rects_.swap(window_rects);
+    // Replace the regions, the routing may still hold the old ones
+    std::lock_guard window_regions_lk(window_regions_mutex_);
+    window_regions_ = std::move(window_regions);
+
+    if (input::InputRecorder::Get()->is_recording()) {
+      input::InputRecorder::Get()->RecordScene(*window_regions_);
+    }
+  }
+}
+
+void WindowManager::UpdateInputRegion(const std::shared_ptr<Window> &window) {
+  std::unique_lock window_lk(window->mutex);
+  WindowUniqueId id = window->id;
+  Rect rect = window->rect;
+  std::shared_ptr<const InputMask> input_mask = window->input_mask;
+  std::shared_ptr<Sprite> alpha_sprite =
+      window->input_mask_alpha_threshold ? window->sprite : nullptr;
+  uint64_t alpha_buffer_updates = window->input_mask_buffer_updates;
+  window_lk.unlock();
+
+  std::lock_guard window_regions_lk(window_regions_mutex_);
+
+  // Update the window's region without rebuilding all of the windows, on a
+  // copy since the routing may still hold the current regions
+  auto region_it =
+      std::find_if(window_regions_->begin(), window_regions_->end(),
+                   [&id](const WindowInputRegion &region) {
+                     return region.id == id;
+                   });
+  if (region_it == window_regions_->end()) {
+    return;
+  }
+
+  std::shared_ptr<std::vector<WindowInputRegion>> window_regions =
+      std::make_shared<std::vector<WindowInputRegion>>(*window_regions_);
+  WindowInputRegion &region =
+      (*window_regions)[region_it - window_regions_->begin()];
+
+  region.rect = rect;
+  region.mask = std::move(input_mask);
+  region.alpha_sprite = std::move(alpha_sprite);
+  region.alpha_buffer_updates = alpha_buffer_updates;
+  window_regions_ = std::move(window_regions);
+
+  if (input::InputRecorder::Get()->is_recording()) {
+    input::InputRecorder::Get()->RecordScene(*window_regions_);
+  }
+}
+
+void WindowManager::UpdateAlphaInputMasks(POINT point) {
+  std::vector<WindowUniqueId> stale_window_ids;
+
+  std::shared_ptr<const std::vector<WindowInputRegion>> window_regions =
+      GetWindowRegions();
+
+  // Find the alpha masks under the point whose windows got another buffer
+  // since they were built
+  for (auto &region : *window_regions) {
+    if (region.alpha_sprite &&
+        region.alpha_sprite->buffer_updates.load(std::memory_order_relaxed) !=
+            region.alpha_buffer_updates &&
+        utils::Rect::PointInRect(point, region.rect)) {
+      stale_window_ids.push_back(region.id);
+    }
+  }
+
+  for (auto &id : stale_window_ids) {
+    std::shared_ptr<Window> window = GetWindowWithId(id);
+
+    if (window) {
+      UpdateAlphaInputMask(window);
+    }
+  }
+}
+
+void WindowManager::UpdateAlphaInputMask(
+    const std::shared_ptr<Window> &window) {
+  TRACE_SCOPE("windows", "UpdateAlphaInputMask");
+  std::shared_ptr<const InputMask> input_mask = nullptr;
+  uint64_t buffer_updates = 0;
+
+  std::unique_lock window_lk(window->mutex);
+  std::shared_ptr<Sprite> sprite = window->sprite;
+  uint8_t alpha_threshold = window->input_mask_alpha_threshold;
+  window_lk.unlock();
+
+  if (!alpha_threshold) {
+    return;
+  }
+
+  // Build the mask from the latest buffer of the window, a window without a
+  // buffer takes input on all of its rect
+  {
+    std::lock_guard pending_buffer_lk(sprite->pending_buffer_mutex);
+    buffer_updates = sprite->buffer_updates;
+
+    if (sprite->has_pending_buffer) {
+      input_mask = InputMask::FromAlpha(
+          sprite->pending_buffer, sprite->pending_buffer_width,
+          sprite->pending_buffer_height, alpha_threshold);
+    } else if (!sprite->buffer.empty()) {
+      input_mask =
+          InputMask::FromAlpha(sprite->buffer, sprite->buffer_width,
+                               sprite->buffer_height, alpha_threshold);
+    }
   }
+
+  // Drop the mask if the window's threshold was changed meanwhile
+  window_lk.lock();
+  if (window->input_mask_alpha_threshold != alpha_threshold) {
+    return;
+  }
+  window->input_mask = input_mask;
+  window->input_mask_buffer_updates = buffer_updates;
+  window_lk.unlock();
+
+  UpdateInputRegion(window);
+}
+
+std::shared_ptr<const std::vector<WindowInputRegion>>
+WindowManager::GetWindowRegions() {
+  std::lock_guard window_regions_lk(window_regions_mutex_);
+  return window_regions_;
+}
+
+bool WindowManager::StartInputRecording() {
+  std::lock_guard window_regions_lk(window_regions_mutex_);
+
+  // Record the scene the input starts in
+  if (!input::InputRecorder::Get()->Start()) {
+    return false;
+  }
+
+  input::InputRecorder::Get()->RecordScene(*window_regions_);
+  input::InputRecorder::Get()->RecordFocus(GetFocusedWindowId());
+
+  return true;
 }
 
 void WindowManager::UpdateBlockAppInput() {
@@ -702,6 +1087,10 @@ void WindowManager::FocusWindow(std::shared_ptr<Window> window) {
   }
 
   focused_window_id_ = window && window->id ? window->id : WindowUniqueId();
+
+  if (input::InputRecorder::Get()->is_recording()) {
+    input::InputRecorder::Get()->RecordFocus(focused_window_id_);
+  }
   focused_window_id_lk.unlock();
 
   // Send blur event
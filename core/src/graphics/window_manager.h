@@ -11,6 +11,7 @@
 #include "color.h"
 #include "events.pb.h"
 #include "graphics_renderer.h"
+#include "mouse_routing.h"
 #include "sprite.h"
 #include "utils/guid.h"
 #include "window.h"
@@ -20,8 +21,17 @@ namespace overlay {
 namespace core {
 namespace graphics {
 
+enum class BufferUpdateResult {
+  Updated,
+  UnknownWindow,  // The window was destroyed, so the buffer is ignored
+  InvalidBuffer,
+  BaseMismatch  // The delta's base isn't the window's latest buffer
+};
+
 class WindowManager {
  public:
+  WindowManager();
+
   GUID CreateWindowGroup(std::string client_id,
                          WindowGroupAttributes attributes);
   bool UpdateWindowGroupAttributes(const WindowGroupUniqueId &id,
@@ -35,19 +45,50 @@ class WindowManager {
                               const WindowAttributes &attributes);
   bool SetWindowRect(const WindowUniqueId &id, const Rect &rect);
   bool SetWindowCursor(const WindowUniqueId &id, const HCURSOR cursor);
+  // Sets the parts of the window that take mouse input to the rects, or to
+  // the pixels of its buffers with at least the alpha threshold. Without
+  // either, or without a buffer for the alpha, all of the window takes input
+  bool SetWindowInputMask(const WindowUniqueId &id, std::vector<Rect> rects,
+                          uint8_t alpha_threshold);
   bool FocusWindowInGroup(const WindowUniqueId &id);
-  void UpdateWindowBufferInGroup(const WindowUniqueId &id,
-                                 std::string &&buffer);
+  // Fills a resolution of 0 with the window's size
+  bool GetWindowBufferResolution(const WindowUniqueId &id, uint32_t &width,
+                                 uint32_t &height);
+  // A delta is only applied to the window's latest buffer if it's the base
+  // generation the delta was made from
+  BufferUpdateResult UpdateWindowBufferInGroup(
+      const WindowUniqueId &id, std::string &&buffer, uint32_t width,
+      uint32_t height, uint64_t generation, bool delta,
+      uint64_t base_generation, BufferStats &buffer_stats);
   void DestroyWindowInGroup(const WindowUniqueId &id);
 
-  void RenderWindows(std::unique_ptr<IGraphicsRenderer> &renderer);
+  void RenderWindows(std::unique_ptr<IGraphicsRenderer> &renderer,
+                     RenderStats &render_stats);
   void OnResize();
 
-  void SendWindowEventToWindow(EventResponse event,
+  // Composites the windows on the CPU to an A8R8G8B8 buffer, for captures
+  // that don't go through the renderer. The windows' buffers are copied, not
+  // taken, so the renderer isn't affected
+  bool CompositeWindows(uint32_t width, uint32_t height, std::string &target);
+
+  // The window events are modified to address the window
+  void SendWindowEventToWindow(EventResponse &event,
                                const WindowUniqueId &window_id);
-  void SendWindowEventToFocusedWindow(EventResponse event);
-  void HandleMouseEvent(EventResponse event, POINT point);
+  void SendWindowEventToFocusedWindow(EventResponse &event);
+  void SendEventToFocusedWindowClient(const EventResponse &event);
+  // Buttons down is whether any mouse button is still held after the event
+  void HandleMouseEvent(EventResponse &event, POINT point, bool buttons_down);
   void HandleWindowFocus(bool focused);
+  // Whether the mouse input at the point fell through the masks of the
+  // windows under it and should reach the game
+  bool IsMouseInputPassThrough(POINT point);
+  // Whether a window holds the pointer capture, and ending it early when the
+  // game's window loses the mouse. Used only by the window's thread
+  bool HasCapturedWindow() const;
+  void ReleaseCapturedWindow();
+
+  // Starts recording the input with the current windows and focus
+  bool StartInputRecording();
 
  private:
   std::unordered_map<WindowGroupUniqueId, std::shared_ptr<WindowGroup>>
@@ -60,13 +101,25 @@ class WindowManager {
   WindowUniqueId hovered_window_id_;
   std::mutex hovered_window_id_mutex_;
 
-  std::vector<std::pair<WindowUniqueId, Rect>> window_rects_;
-  std::mutex window_rects_mutex_;
+  // The window that got the press of the held buttons, it gets every mouse
+  // event until they are released. Used only by the window's thread
+  WindowUniqueId captured_window_id_;
+
+  // The routing takes the current snapshot under the lock and reads it
+  // without locking, the regions are replaced instead of being modified
+  std::shared_ptr<const std::vector<WindowInputRegion>> window_regions_;
+  std::mutex window_regions_mutex_;
 
   std::vector<std::shared_ptr<Sprite>> sprites_;
   std::mutex sprites_mutex_;
 
   void UpdateWindows();
+  void UpdateInputRegion(const std::shared_ptr<Window> &window);
+  std::shared_ptr<const std::vector<WindowInputRegion>> GetWindowRegions();
+  // Rebuilds the stale alpha masks of the windows under the point, so the
+  // masks are only built from the buffers the routing hits
+  void UpdateAlphaInputMasks(POINT point);
+  void UpdateAlphaInputMask(const std::shared_ptr<Window> &window);
   void UpdateBlockAppInput();
 
   void FocusWindow(std::shared_ptr<Window> window);
@@ -74,6 +127,11 @@ class WindowManager {
 
   std::shared_ptr<Window> CreateBufferWindow(Color color, double opacity);
 
+  void TakePendingBuffer(const std::shared_ptr<Sprite> &sprite,
+                         uint64_t render_timestamp);
+  // The sprites' lock is held
+  std::shared_ptr<Sprite> CopySpriteForComposite(Sprite &sprite);
+
   std::shared_ptr<Window> GetWindowWithId(const WindowUniqueId &id);
 
   const WindowUniqueId GetFocusedWindowId();
@@ -1,16 +1,30 @@
 #include "input_manager.h"
 
 #include <commctrl.h>
+#include <intrin.h>
 
+#include <algorithm>
+#include <cstdlib>
 #include <loguru/loguru.hpp>
 
 #include "core.h"
 #include "events.pb.h"
 #include "graphics/window.h"
+#include "input/input_recorder.h"
+#include "input/message_decoder.h"
 #include "utils/rect.h"
+#include "utils/timestamp.h"
+#include "utils/trace_recorder.h"
 
 #define KEY_UP_PASSTHROUGH_LPARAM ((LPARAM)0xA1B3C5D7)
 #define SUBCLASS_WINDOW_MESSAGE (WM_USER + 0xBC)
+#define FLUSH_INPUT_WINDOW_MESSAGE (WM_USER + 0xBD)
+#define RAW_INPUT_WINDOW_MESSAGE (WM_USER + 0xBE)
+
+#define HID_USAGE_PAGE_GENERIC 0x01
+#define HID_USAGE_GENERIC_MOUSE 0x02
+
+#define HOTKEY_MODIFIERS (MOD_ALT | MOD_CONTROL | MOD_SHIFT | MOD_WIN)
 
 namespace overlay {
 namespace core {
@@ -35,7 +49,30 @@ InputManager::InputManager()
     : block_app_input_(false),
       block_app_input_cursor_(LoadCursor(NULL, IDC_ARROW)),
       window_msg_hook_(NULL),
-      resizing_moving_(false) {}
+      pressed_keys_(),
+      scan_codes_(),
+      hotkey_keys_(),
+      blocked_hotkey_keys_(),
+      resizing_moving_(false),
+      app_mouse_capture_(false),
+      overlay_mouse_capture_(false),
+      last_click_(),
+      drag_origin_(),
+      dragging_(false),
+      double_click_time_(0),
+      double_click_size_(),
+      drag_threshold_(),
+      has_pending_input_(false),
+      input_flush_posted_(false),
+      raw_mouse_input_enabled_(false),
+      raw_mouse_input_registered_(false),
+      game_raw_mouse_device_(),
+      has_game_raw_mouse_device_(false),
+      input_coalesce_interval_(DEFAULT_INPUT_COALESCE_INTERVAL),
+      input_flush_task_id_(0) {
+  pending_mouse_moves_.reserve(MOUSE_MOVE_MAX_SAMPLES);
+  pending_raw_mouse_input_.reserve(RAW_MOUSE_INPUT_MAX_SAMPLES);
+}
 
 bool InputManager::Hook() {
   if (!input_hook_.Hook()) {
@@ -49,16 +86,238 @@ bool InputManager::Hook() {
 }
 
 void InputManager::ReleasePressedKeys() {
-  for (int virtual_key = 0; virtual_key < 256; virtual_key++) {
-    if (GetAsyncKeyState(virtual_key) & (1 << 15)) {
+  unsigned long bit = 0;
+
+  // Release the keys the game got a key down for, the pass-through key ups
+  // clear their bits once the game gets them
+  for (size_t word = 0; word < pressed_keys_.size(); word++) {
+    uint32_t pressed_keys = pressed_keys_[word].load(std::memory_order_relaxed);
+
+    while (_BitScanForward(&bit, pressed_keys)) {
+      pressed_keys &= pressed_keys - 1;
+
       PostMessageA(Core::Get()->get_graphics_window(), WM_KEYUP,
-                   (WPARAM)virtual_key, KEY_UP_PASSTHROUGH_LPARAM);
+                   (WPARAM)(word * 32 + bit), KEY_UP_PASSTHROUGH_LPARAM);
+    }
+  }
+}
+
+void InputManager::UpdatePressedKeys(UINT message, uint8_t virtual_key) {
+  std::atomic<uint32_t> &word = pressed_keys_[virtual_key / 32];
+  uint32_t key_bit = 1u << (virtual_key % 32);
+
+  if (message == WM_KEYDOWN || message == WM_SYSKEYDOWN) {
+    word.fetch_or(key_bit, std::memory_order_relaxed);
+  } else if (message == WM_KEYUP || message == WM_SYSKEYUP) {
+    word.fetch_and(~key_bit, std::memory_order_relaxed);
+  }
+}
+
+bool InputManager::RegisterHotkey(const std::string &client_id, uint32_t id,
+                                  uint8_t virtual_key, uint32_t modifiers,
+                                  bool block) {
+  std::lock_guard hotkeys_lk(hotkeys_mutex_);
+
+  if (!virtual_key || (modifiers & ~HOTKEY_MODIFIERS)) {
+    return false;
+  }
+
+  // The hotkeys are dropped with the client's subscription, so they can't
+  // outlive the client
+  if (!Core::Get()->get_rpc_server()->get_events_service()->IsClientSubscribed(
+          client_id, EventResponse::EventCase::kHotkeyEvent)) {
+    return false;
+  }
+
+  // Replace the client's hotkey with the same id
+  std::vector<Hotkey> &client_hotkeys = hotkeys_[client_id];
+  auto hotkey_it = std::find_if(
+      client_hotkeys.begin(), client_hotkeys.end(),
+      [id](const Hotkey &hotkey) { return hotkey.id == id; });
+  if (hotkey_it != client_hotkeys.end()) {
+    *hotkey_it = {id, virtual_key, modifiers, block};
+  } else if (client_hotkeys.size() < MAX_HOTKEYS) {
+    client_hotkeys.push_back({id, virtual_key, modifiers, block});
+  } else {
+    return false;
+  }
+
+  UpdateHotkeyKeys();
+
+  return true;
+}
+
+bool InputManager::UnregisterHotkey(const std::string &client_id,
+                                    uint32_t id) {
+  std::lock_guard hotkeys_lk(hotkeys_mutex_);
+
+  auto client_hotkeys = hotkeys_.find(client_id);
+  if (client_hotkeys == hotkeys_.end()) {
+    return false;
+  }
+
+  auto hotkey_it = std::find_if(
+      client_hotkeys->second.begin(), client_hotkeys->second.end(),
+      [id](const Hotkey &hotkey) { return hotkey.id == id; });
+  if (hotkey_it == client_hotkeys->second.end()) {
+    return false;
+  }
+
+  client_hotkeys->second.erase(hotkey_it);
+  if (client_hotkeys->second.empty()) {
+    hotkeys_.erase(client_hotkeys);
+  }
+  UpdateHotkeyKeys();
+
+  return true;
+}
+
+void InputManager::RemoveClientHotkeys(const std::string &client_id) {
+  std::lock_guard hotkeys_lk(hotkeys_mutex_);
+
+  if (hotkeys_.erase(client_id)) {
+    UpdateHotkeyKeys();
+  }
+}
+
+void InputManager::UpdateHotkeyKeys() {
+  std::array<uint32_t, 256 / 32> hotkey_keys = {};
+
+  for (auto &client_hotkeys : hotkeys_) {
+    for (auto &hotkey : client_hotkeys.second) {
+      hotkey_keys[hotkey.virtual_key / 32] |= 1u << (hotkey.virtual_key % 32);
+    }
+  }
+
+  for (size_t word = 0; word < hotkey_keys.size(); word++) {
+    hotkey_keys_[word].store(hotkey_keys[word], std::memory_order_relaxed);
+  }
+}
+
+uint32_t InputManager::GetHotkeyModifiers() const {
+  uint32_t modifiers = 0;
+
+  // The key state of the window's thread is updated with each key message it
+  // gets, so it matches the message that is being handled
+  if (GetKeyState(VK_MENU) & 0x8000) {
+    modifiers |= MOD_ALT;
+  }
+  if (GetKeyState(VK_CONTROL) & 0x8000) {
+    modifiers |= MOD_CONTROL;
+  }
+  if (GetKeyState(VK_SHIFT) & 0x8000) {
+    modifiers |= MOD_SHIFT;
+  }
+  if ((GetKeyState(VK_LWIN) | GetKeyState(VK_RWIN)) & 0x8000) {
+    modifiers |= MOD_WIN;
+  }
+
+  return modifiers;
+}
+
+bool InputManager::HandleHotkey(UINT message, uint8_t virtual_key,
+                                LPARAM long_param, DWORD message_time) {
+  uint32_t key_bit = 1u << (virtual_key % 32);
+  uint32_t &blocked_keys = blocked_hotkey_keys_[virtual_key / 32];
+  bool key_down = message == WM_KEYDOWN || message == WM_SYSKEYDOWN;
+  bool block = false;
+
+  // The other keyboard messages hold characters instead of virtual keys
+  if (!key_down && message != WM_KEYUP && message != WM_SYSKEYUP) {
+    return false;
+  }
+
+  // Block the repeats and the key up of a blocked hotkey
+  if (blocked_keys & key_bit) {
+    if (!key_down) {
+      blocked_keys &= ~key_bit;
     }
+
+    return true;
   }
+
+  // Only the first key down is matched, the repeats have the previous key
+  // state bit set
+  if (!key_down || (long_param & (1 << 30)) ||
+      !(hotkey_keys_[virtual_key / 32].load(std::memory_order_relaxed) &
+        key_bit)) {
+    return false;
+  }
+
+  TRACE_SCOPE("input", "HandleHotkey");
+  uint64_t capture_time = utils::timestamp::GetTimestamp();
+  uint32_t modifiers = GetHotkeyModifiers();
+  EventResponse::HotkeyEvent *hotkey_event =
+      hotkey_event_.mutable_hotkeyevent();
+
+  hotkey_event->set_messagetime(message_time);
+  hotkey_event->set_capturetime(capture_time);
+
+  // Send the hotkey to each client that registered the chord, the key is
+  // only blocked for the clients that got it
+  std::lock_guard hotkeys_lk(hotkeys_mutex_);
+  for (auto &client_hotkeys : hotkeys_) {
+    for (auto &hotkey : client_hotkeys.second) {
+      if (hotkey.virtual_key != virtual_key || hotkey.modifiers != modifiers) {
+        continue;
+      }
+
+      hotkey_event->set_id(hotkey.id);
+      if (Core::Get()
+              ->get_rpc_server()
+              ->get_events_service()
+              ->SendEventToClient(client_hotkeys.first, hotkey_event_)) {
+        block |= hotkey.block;
+      }
+    }
+  }
+
+  if (block) {
+    blocked_keys |= key_bit;
+  }
+
+  return block;
 }
 
-uint16_t InputManager::VirtualKeyToScanCode(uint8_t virtual_key) {
-  uint16_t scan_code = MapVirtualKey(virtual_key, MAPVK_VK_TO_VSC);
+void InputManager::UpdateScanCodes(HKL keyboard_layout) {
+  for (int virtual_key = 0; virtual_key < 256; virtual_key++) {
+    scan_codes_[virtual_key] =
+        VirtualKeyToScanCode((uint8_t)virtual_key, keyboard_layout);
+  }
+}
+
+void InputManager::UpdateMouseMetrics() {
+  double_click_time_ = GetDoubleClickTime();
+  double_click_size_ = {GetSystemMetrics(SM_CXDOUBLECLK),
+                        GetSystemMetrics(SM_CYDOUBLECLK)};
+  drag_threshold_ = {GetSystemMetrics(SM_CXDRAG), GetSystemMetrics(SM_CYDRAG)};
+}
+
+uint32_t InputManager::CountClick(
+    EventResponse::WindowEvent::MouseInputEvent::MouseButton button,
+    POINT point, DWORD message_time) {
+  // The click continues the previous clicks if it's of the same button, and
+  // it's within the double click time and rect of the previous click
+  if (last_click_.count && last_click_.button == button &&
+      message_time - last_click_.message_time <= double_click_time_ &&
+      std::abs(point.x - last_click_.point.x) <= double_click_size_.cx / 2 &&
+      std::abs(point.y - last_click_.point.y) <= double_click_size_.cy / 2) {
+    last_click_.count++;
+  } else {
+    last_click_.count = 1;
+  }
+
+  last_click_.button = button;
+  last_click_.point = point;
+  last_click_.message_time = message_time;
+
+  return last_click_.count;
+}
+
+uint16_t InputManager::VirtualKeyToScanCode(uint8_t virtual_key,
+                                            HKL keyboard_layout) {
+  uint16_t scan_code =
+      MapVirtualKeyEx(virtual_key, MAPVK_VK_TO_VSC, keyboard_layout);
 
   switch (virtual_key) {
     case VK_LEFT:
@@ -136,144 +395,388 @@ void InputManager::RestoreCursorState() {
          app_cursor_state_.cursor_pos.y, app_cursor_state_.cursor_handle);
 }
 
-void InputManager::HandleKeyboardInput(UINT message, uint32_t param) {
-  EventResponse event;
-  EventResponse::WindowEvent *window_event = event.mutable_windowevent();
+void InputManager::HandleKeyboardInput(UINT message, uint32_t param,
+                                       DWORD message_time) {
+  TRACE_SCOPE("input", "HandleKeyboardInput");
+  uint64_t capture_time = utils::timestamp::GetTimestamp();
+  EventResponse::WindowEvent::KeyboardInputEvent::KeyboardInputType type;
+
+  if (!DecodeKeyboardMessage(message, type)) {
+    return;
+  }
+
+  // Send the mouse moves that happened before the key
+  FlushMouseMoves();
+
+  // The event is reused, so every field of it is set
   EventResponse::WindowEvent::KeyboardInputEvent *input_event =
-      window_event->mutable_keyboardinputevent();
+      keyboard_event_.mutable_windowevent()->mutable_keyboardinputevent();
 
+  input_event->set_type(type);
   input_event->set_code(param);
+  input_event->set_messagetime(message_time);
+  input_event->set_capturetime(capture_time);
 
-  switch (message) {
-    case WM_KEYDOWN:
-    case WM_SYSKEYDOWN:
-      input_event->set_type(
-          EventResponse::WindowEvent::KeyboardInputEvent::KEY_DOWN);
-      break;
+  Core::Get()
+      ->get_graphics_manager()
+      ->get_window_manager()
+      ->SendWindowEventToFocusedWindow(keyboard_event_);
+}
+
+void InputManager::HandleMouseInput(UINT message, POINT point,
+                                    WPARAM word_param, DWORD message_time) {
+  TRACE_SCOPE("input", "HandleMouseInput");
+  uint64_t capture_time = utils::timestamp::GetTimestamp();
+  DecodedMouseMessage mouse_message;
+
+  if (!DecodeMouseMessage(message, word_param, mouse_message)) {
+    return;
+  }
+
+  EventResponse::WindowEvent::MouseInputEvent::MouseButton button =
+      mouse_message.button;
+  bool buttons_down = mouse_message.buttons_down;
+
+  if (mouse_message.type ==
+      EventResponse::WindowEvent::MouseInputEvent::MOUSE_MOVE) {
+    CoalesceMouseMove(point, buttons_down, message_time, capture_time);
+    return;
+  }
 
-    case WM_CHAR:
-    case WM_SYSCHAR:
-      input_event->set_type(
-          EventResponse::WindowEvent::KeyboardInputEvent::CHAR);
+  // Send the mouse moves that happened before the button or wheel
+  FlushMouseMoves();
+
+  uint32_t click_count = 0;
+  bool dragging = false;
+
+  switch (mouse_message.type) {
+    case EventResponse::WindowEvent::MouseInputEvent::MOUSE_BUTTON_DOWN:
+    case EventResponse::WindowEvent::MouseInputEvent::
+        MOUSE_BUTTON_DOUBLE_CLICK:
+      click_count = CountClick(button, point, message_time);
+
+      // Drags are measured from the press that started them
+      if (!dragging_) {
+        drag_origin_ = point;
+      }
       break;
 
-    case WM_KEYUP:
-    case WM_SYSKEYUP:
-      input_event->set_type(
-          EventResponse::WindowEvent::KeyboardInputEvent::KEY_UP);
+    case EventResponse::WindowEvent::MouseInputEvent::MOUSE_BUTTON_UP:
+      click_count = last_click_.button == button ? last_click_.count : 0;
+      dragging = dragging_;
+
+      // A drag ends the clicks
+      if (dragging_) {
+        last_click_.count = 0;
+      }
       break;
 
     default:
-      return;
+      break;
+  }
+
+  if (!buttons_down) {
+    dragging_ = false;
+  }
+
+  // The event is reused, so every field of it is set
+  EventResponse::WindowEvent::MouseInputEvent *input_event =
+      mouse_event_.mutable_windowevent()->mutable_mouseinputevent();
+
+  input_event->set_type(mouse_message.type);
+  input_event->set_button(button);
+  input_event->set_wheeldelta(mouse_message.wheel_delta);
+  input_event->set_messagetime(message_time);
+  input_event->set_capturetime(capture_time);
+  input_event->set_clickcount(click_count);
+  input_event->set_dragging(dragging);
+
+  Core::Get()->get_graphics_manager()->get_window_manager()->HandleMouseEvent(
+      mouse_event_, point, buttons_down);
+}
+
+void InputManager::UpdateOverlayMouseCapture(HWND window) {
+  bool captured = Core::Get()
+                      ->get_graphics_manager()
+                      ->get_window_manager()
+                      ->HasCapturedWindow();
+
+  if (captured == overlay_mouse_capture_) {
+    return;
+  }
+
+  // Keep getting the mouse outside of the game's window while an overlay's
+  // window holds it, and give it back once the buttons are released
+  overlay_mouse_capture_ = captured;
+  if (captured) {
+    SetCapture(window);
+  } else if (GetCapture() == window) {
+    ReleaseCapture();
+  }
+}
+
+void InputManager::ReleaseOverlayMouseCapture(HWND window) {
+  if (!overlay_mouse_capture_) {
+    return;
   }
 
+  // Cleared first, the release sends WM_CAPTURECHANGED back to the window
+  overlay_mouse_capture_ = false;
   Core::Get()
       ->get_graphics_manager()
       ->get_window_manager()
-      ->SendWindowEventToFocusedWindow(event);
+      ->ReleaseCapturedWindow();
+  if (GetCapture() == window) {
+    ReleaseCapture();
+  }
 }
 
-void InputManager::HandleMouseInput(UINT message, POINT point,
-                                    WPARAM word_param) {
-  EventResponse event;
-  EventResponse::WindowEvent *window_event = event.mutable_windowevent();
+void InputManager::CoalesceMouseMove(POINT point, bool buttons_down,
+                                     DWORD message_time, uint64_t timestamp) {
+  // Start dragging once the pointer moves past the threshold while a button
+  // is held
+  if (!buttons_down) {
+    dragging_ = false;
+  } else if (!dragging_ &&
+             (std::abs(point.x - drag_origin_.x) > drag_threshold_.cx ||
+              std::abs(point.y - drag_origin_.y) > drag_threshold_.cy)) {
+    dragging_ = true;
+  }
+
+  pending_mouse_moves_.push_back(
+      {point, buttons_down, message_time, timestamp});
+  if (!has_pending_input_.exchange(true)) {
+    ScheduleInputFlush();
+  }
+
+  if (IsCoalescingDone(pending_mouse_moves_.front().timestamp, timestamp,
+                       pending_mouse_moves_.size(), MOUSE_MOVE_MAX_SAMPLES)) {
+    FlushMouseMoves();
+  }
+}
+
+void InputManager::FlushMouseMoves() {
+  if (pending_mouse_moves_.empty()) {
+    return;
+  }
+
+  TRACE_SCOPE("input", "FlushMouseMoves");
   EventResponse::WindowEvent::MouseInputEvent *input_event =
-      window_event->mutable_mouseinputevent();
-
-  switch (message) {
-    case WM_LBUTTONDOWN:
-    case WM_LBUTTONUP:
-    case WM_LBUTTONDBLCLK:
-      input_event->set_type(message == WM_LBUTTONDBLCLK
-                                ? EventResponse::WindowEvent::MouseInputEvent::
-                                      MOUSE_BUTTON_DOUBLE_CLICK
-                                : message == WM_LBUTTONDOWN
-                                      ? EventResponse::WindowEvent::
-                                            MouseInputEvent::MOUSE_BUTTON_DOWN
-                                      : EventResponse::WindowEvent::
-                                            MouseInputEvent::MOUSE_BUTTON_UP);
-      input_event->set_button(
-          EventResponse::WindowEvent::MouseInputEvent::LEFT_BUTTON);
-      break;
+      mouse_move_event_.mutable_windowevent()->mutable_mouseinputevent();
+  EventResponse::WindowEvent::MouseInputEvent::MoveSample *sample = nullptr;
+  POINT point = pending_mouse_moves_.back().point;
+  bool buttons_down = pending_mouse_moves_.back().buttons_down;
+
+  // The event is stamped with its last move, the samples keep the rest
+  input_event->set_type(
+      EventResponse::WindowEvent::MouseInputEvent::MOUSE_MOVE);
+  input_event->set_messagetime(pending_mouse_moves_.back().message_time);
+  input_event->set_capturetime(pending_mouse_moves_.back().timestamp);
+  input_event->set_dragging(dragging_);
+
+  // Add the samples relative to the last move, so they don't depend on the
+  // window the event is sent to. Clearing the samples keeps them allocated
+  // for the next moves
+  input_event->mutable_samples()->Clear();
+  for (auto &move : pending_mouse_moves_) {
+    sample = input_event->add_samples();
+    sample->set_deltax(move.point.x - point.x);
+    sample->set_deltay(move.point.y - point.y);
+    sample->set_timestamp(move.timestamp);
+  }
 
-    case WM_MBUTTONDOWN:
-    case WM_MBUTTONUP:
-    case WM_MBUTTONDBLCLK:
-      input_event->set_type(message == WM_MBUTTONDBLCLK
-                                ? EventResponse::WindowEvent::MouseInputEvent::
-                                      MOUSE_BUTTON_DOUBLE_CLICK
-                                : message == WM_MBUTTONDOWN
-                                      ? EventResponse::WindowEvent::
-                                            MouseInputEvent::MOUSE_BUTTON_DOWN
-                                      : EventResponse::WindowEvent::
-                                            MouseInputEvent::MOUSE_BUTTON_UP);
-      input_event->set_button(
-          EventResponse::WindowEvent::MouseInputEvent::MIDDLE_BUTTON);
-      break;
+  pending_mouse_moves_.clear();
+  has_pending_input_ = !pending_raw_mouse_input_.empty();
 
-    case WM_RBUTTONDOWN:
-    case WM_RBUTTONUP:
-    case WM_RBUTTONDBLCLK:
-      input_event->set_type(message == WM_RBUTTONDBLCLK
-                                ? EventResponse::WindowEvent::MouseInputEvent::
-                                      MOUSE_BUTTON_DOUBLE_CLICK
-                                : message == WM_RBUTTONDOWN
-                                      ? EventResponse::WindowEvent::
-                                            MouseInputEvent::MOUSE_BUTTON_DOWN
-                                      : EventResponse::WindowEvent::
-                                            MouseInputEvent::MOUSE_BUTTON_UP);
-      input_event->set_button(
-          EventResponse::WindowEvent::MouseInputEvent::RIGHT_BUTTON);
-      break;
+  Core::Get()->get_graphics_manager()->get_window_manager()->HandleMouseEvent(
+      mouse_move_event_, point, buttons_down);
+}
 
-    case WM_XBUTTONDOWN:
-    case WM_XBUTTONUP:
-    case WM_XBUTTONDBLCLK:
-      input_event->set_type(message == WM_XBUTTONDBLCLK
-                                ? EventResponse::WindowEvent::MouseInputEvent::
-                                      MOUSE_BUTTON_DOUBLE_CLICK
-                                : message == WM_XBUTTONDOWN
-                                      ? EventResponse::WindowEvent::
-                                            MouseInputEvent::MOUSE_BUTTON_DOWN
-                                      : EventResponse::WindowEvent::
-                                            MouseInputEvent::MOUSE_BUTTON_UP);
-      input_event->set_button(
-          GET_XBUTTON_WPARAM(word_param) == XBUTTON1
-              ? EventResponse::WindowEvent::MouseInputEvent::X_BUTTON_1
-              : EventResponse::WindowEvent::MouseInputEvent::X_BUTTON_2);
-      break;
+void InputManager::HandleRawInput(HRAWINPUT raw_input) {
+  TRACE_SCOPE("input", "HandleRawInput");
+  RAWINPUT input;
+  UINT size = sizeof(input);
+  uint64_t timestamp = utils::timestamp::GetTimestamp();
+
+  // Only mouse input is forwarded, other devices won't fit in the buffer
+  if (GetRawInputData(raw_input, RID_INPUT, &input, &size,
+                      sizeof(RAWINPUTHEADER)) == (UINT)-1 ||
+      input.header.dwType != RIM_TYPEMOUSE) {
+    return;
+  }
 
-    case WM_MOUSEMOVE:
-      input_event->set_type(
-          EventResponse::WindowEvent::MouseInputEvent::MOUSE_MOVE);
-      break;
+  pending_raw_mouse_input_.push_back({input.data.mouse, timestamp});
+  if (!has_pending_input_.exchange(true)) {
+    ScheduleInputFlush();
+  }
 
-    case WM_MOUSEWHEEL:
-      input_event->set_type(
-          EventResponse::WindowEvent::MouseInputEvent::MOUSE_VERTICAL_WHEEL);
-      input_event->set_wheeldelta(GET_WHEEL_DELTA_WPARAM(word_param));
-      break;
+  if (IsCoalescingDone(pending_raw_mouse_input_.front().timestamp, timestamp,
+                       pending_raw_mouse_input_.size(),
+                       RAW_MOUSE_INPUT_MAX_SAMPLES)) {
+    FlushRawMouseInput();
+  }
+}
+
+void InputManager::FlushRawMouseInput() {
+  if (pending_raw_mouse_input_.empty()) {
+    return;
+  }
 
-    case WM_MOUSEHWHEEL:
-      input_event->set_type(
-          EventResponse::WindowEvent::MouseInputEvent::MOUSE_HORIZONTAL_WHEEL);
-      input_event->set_wheeldelta(GET_WHEEL_DELTA_WPARAM(word_param));
+  TRACE_SCOPE("input", "FlushRawMouseInput");
+  EventResponse::RawMouseInputEvent *raw_event =
+      raw_mouse_input_event_.mutable_rawmouseinputevent();
+  EventResponse::RawMouseInputEvent::Sample *sample = nullptr;
+
+  // Clearing the samples keeps them allocated for the next input
+  raw_event->mutable_samples()->Clear();
+  for (auto &input : pending_raw_mouse_input_) {
+    sample = raw_event->add_samples();
+    sample->set_deltax(input.mouse.lLastX);
+    sample->set_deltay(input.mouse.lLastY);
+    sample->set_absolute((input.mouse.usFlags & MOUSE_MOVE_ABSOLUTE) != 0);
+    sample->set_buttonflags(input.mouse.usButtonFlags);
+    sample->set_timestamp(input.timestamp);
+
+    // The wheel's delta is signed
+    if (input.mouse.usButtonFlags & RI_MOUSE_WHEEL) {
+      sample->set_wheeldelta((SHORT)input.mouse.usButtonData);
+    } else if (input.mouse.usButtonFlags & RI_MOUSE_HWHEEL) {
+      sample->set_horizontalwheeldelta((SHORT)input.mouse.usButtonData);
+    }
+  }
+
+  pending_raw_mouse_input_.clear();
+  has_pending_input_ = !pending_mouse_moves_.empty();
+
+  Core::Get()
+      ->get_graphics_manager()
+      ->get_window_manager()
+      ->SendEventToFocusedWindowClient(raw_mouse_input_event_);
+}
+
+bool InputManager::IsCoalescingDone(uint64_t first_timestamp,
+                                    uint64_t timestamp, size_t samples,
+                                    size_t max_samples) const {
+  uint32_t interval = input_coalesce_interval_;
+
+  // The input is sent right away if it was held for the whole interval or
+  // there are too many samples
+  return !interval || samples >= max_samples ||
+         timestamp - first_timestamp >= (uint64_t)interval * 1000;
+}
+
+void InputManager::EnableRawMouseInput() {
+  HWND window = Core::Get()->get_graphics_window();
+
+  // The window is registered once it's hooked if it wasn't found yet
+  if (!raw_mouse_input_enabled_.exchange(true) && window) {
+    PostMessage(window, RAW_INPUT_WINDOW_MESSAGE, NULL, NULL);
+  }
+}
+
+void InputManager::DisableRawMouseInput() {
+  HWND window = Core::Get()->get_graphics_window();
+
+  if (raw_mouse_input_enabled_.exchange(false) && window) {
+    PostMessage(window, RAW_INPUT_WINDOW_MESSAGE, NULL, NULL);
+  }
+}
+
+void InputManager::UpdateRawMouseInput(HWND window) {
+  bool enabled = raw_mouse_input_enabled_;
+
+  // The messages of quick subscriptions and unsubscriptions may arrive after
+  // the state they were posted for changed again
+  if (enabled == raw_mouse_input_registered_) {
+    return;
+  }
+
+  if (enabled ? RegisterRawMouseInput(window) : UnregisterRawMouseInput()) {
+    raw_mouse_input_registered_ = enabled;
+  }
+}
+
+bool InputManager::RegisterRawMouseInput(HWND window) {
+  RAWINPUTDEVICE device = {HID_USAGE_PAGE_GENERIC, HID_USAGE_GENERIC_MOUSE, 0,
+                           window};
+  UINT devices_count = 0;
+  std::vector<RAWINPUTDEVICE> devices;
+
+  // Get the devices the game registered
+  GetRegisteredRawInputDevices(NULL, &devices_count, sizeof(RAWINPUTDEVICE));
+  devices.resize(devices_count);
+  if (devices_count &&
+      GetRegisteredRawInputDevices(devices.data(), &devices_count,
+                                   sizeof(RAWINPUTDEVICE)) == (UINT)-1) {
+    LOG_F(ERROR, "Unable to get the registered raw input devices!");
+    return false;
+  }
+
+  // Save the game's registration of the mouse to restore it later, and keep
+  // its flags so the game gets the same messages meanwhile
+  has_game_raw_mouse_device_ = false;
+  for (auto &registered_device : devices) {
+    if (registered_device.usUsagePage == HID_USAGE_PAGE_GENERIC &&
+        registered_device.usUsage == HID_USAGE_GENERIC_MOUSE) {
+      game_raw_mouse_device_ = registered_device;
+      has_game_raw_mouse_device_ = true;
+      device.dwFlags = registered_device.dwFlags;
       break;
+    }
+  }
 
-    default:
-      return;
+  if (!RegisterRawInputDevices(&device, 1, sizeof(device))) {
+    LOG_F(ERROR, "Unable to register for raw mouse input!");
+    return false;
   }
 
-  Core::Get()->get_graphics_manager()->get_window_manager()->HandleMouseEvent(
-      event, point);
+  DLOG_F(INFO, "Registered for raw mouse input.");
+  return true;
+}
+
+bool InputManager::UnregisterRawMouseInput() {
+  RAWINPUTDEVICE device = {HID_USAGE_PAGE_GENERIC, HID_USAGE_GENERIC_MOUSE,
+                           RIDEV_REMOVE, NULL};
+
+  // Give the game back its own registration, or remove the overlay's
+  if (has_game_raw_mouse_device_) {
+    device = game_raw_mouse_device_;
+  }
+
+  if (!RegisterRawInputDevices(&device, 1, sizeof(device))) {
+    LOG_F(ERROR, "Unable to unregister from raw mouse input!");
+    return false;
+  }
+
+  DLOG_F(INFO, "Unregistered from raw mouse input.");
+  return true;
+}
+
+void InputManager::RequestInputFlush() {
+  // The input is sent by the window's thread, post a single message to it
+  if (has_pending_input_ && !input_flush_posted_.exchange(true)) {
+    PostMessage(Core::Get()->get_graphics_window(), FLUSH_INPUT_WINDOW_MESSAGE,
+                NULL, NULL);
+  }
 }
 
 bool InputManager::HookWindow(HWND window) {
   DWORD thread = GetWindowThreadProcessId(window, NULL);
 
+  // Translate the keys with the keyboard layout of the window's thread,
+  // which may differ from the calling thread's, and read the mouse metrics
+  // before its messages are hooked
+  UpdateScanCodes(GetKeyboardLayout(thread));
+  UpdateMouseMetrics();
+
   window_msg_hook_ =
       SetWindowsHookExW(WH_GETMESSAGE, WindowGetMsgHook, NULL, thread);
 
+  // Register for raw input if a client subscribed before the window was found
+  if (raw_mouse_input_enabled_) {
+    PostMessage(window, RAW_INPUT_WINDOW_MESSAGE, NULL, NULL);
+  }
+
   return GetClientRect(window, &window_client_area_) &&
          PostMessage(window, SUBCLASS_WINDOW_MESSAGE, NULL, NULL) &&
          window_msg_hook_ != NULL;
@@ -299,13 +802,44 @@ LRESULT InputManager::WindowMsgHook(_In_ int code, _In_ WPARAM word_param,
         return 0;
       }
 
+      if (message->message == FLUSH_INPUT_WINDOW_MESSAGE) {
+        input_flush_posted_ = false;
+        FlushMouseMoves();
+        FlushRawMouseInput();
+
+        message->message = WM_NULL;
+        return 0;
+      }
+
+      if (message->message == RAW_INPUT_WINDOW_MESSAGE) {
+        UpdateRawMouseInput(message->hwnd);
+
+        message->message = WM_NULL;
+        return 0;
+      }
+
+      // Record the input messages for the decoding benchmark of the input
+      // replayer
+      if (InputRecorder::Get()->is_recording() &&
+          ((message->message >= WM_KEYFIRST &&
+            message->message <= WM_KEYLAST) ||
+           (message->message >= WM_MOUSEFIRST &&
+            message->message <= WM_MOUSELAST))) {
+        InputRecorder::Get()->RecordMessage(message->message,
+                                            message->wParam);
+      }
+
       if (message->message >= WM_KEYFIRST && message->message <= WM_KEYLAST) {
         // Pass-throguh key-up for application
         if (message->message == WM_KEYUP &&
             message->lParam == KEY_UP_PASSTHROUGH_LPARAM) {
-          message->lParam = (LPARAM)(
-              (1 << 31) + (1 << 30) +
-              (VirtualKeyToScanCode((uint8_t)message->wParam) << 16) + 1);
+          message->lParam =
+              (LPARAM)((1 << 31) + (1 << 30) +
+                       (scan_codes_[(uint8_t)message->wParam] << 16) + 1);
+        } else if (HandleHotkey(message->message, (uint8_t)message->wParam,
+                                message->lParam, message->time)) {
+          // Block the hotkey from the application and the overlay's windows
+          message->message = WM_NULL;
         } else if (block_app_input_) {
           // Translate virtual key to char
           if (message->message == WM_KEYDOWN ||
@@ -314,11 +848,15 @@ LRESULT InputManager::WindowMsgHook(_In_ int code, _In_ WPARAM word_param,
           }
 
           // Handle input
-          HandleKeyboardInput(message->message, (uint32_t)message->wParam);
+          HandleKeyboardInput(message->message, (uint32_t)message->wParam,
+                              message->time);
 
           // Block application input
           message->message = WM_NULL;
         }
+
+        // Track the keys the application got
+        UpdatePressedKeys(message->message, (uint8_t)message->wParam);
       }
 
       if (message->message >= WM_MOUSEFIRST &&
@@ -333,18 +871,53 @@ LRESULT InputManager::WindowMsgHook(_In_ int code, _In_ WPARAM word_param,
           ScreenToClient(message->hwnd, &point);
         }
 
+        // The overlay's windows lose the mouse once the game gets the input
+        // back
+        if (overlay_mouse_capture_ && !block_app_input_) {
+          ReleaseOverlayMouseCapture(message->hwnd);
+        }
+
+        // The mouse outside of the client area belongs to the overlay's
+        // window that holds the capture
         if (block_app_input_ && !resizing_moving_ &&
-            utils::Rect::PointInRect(point, window_client_area_)) {
-          // Handle input
-          HandleMouseInput(message->message, point, message->wParam);
+            (overlay_mouse_capture_ ||
+             utils::Rect::PointInRect(point, window_client_area_))) {
+          bool app_mouse_capture = app_mouse_capture_;
+          bool pass_through = app_mouse_capture ||
+                              Core::Get()
+                                  ->get_graphics_manager()
+                                  ->get_window_manager()
+                                  ->IsMouseInputPassThrough(point);
+
+          // Handle input, unless the game captured the mouse
+          if (!app_mouse_capture) {
+            HandleMouseInput(message->message, point, message->wParam,
+                             message->time);
+            UpdateOverlayMouseCapture(message->hwnd);
+          }
 
-          // Block application input
-          message->message = WM_NULL;
+          // Block application input unless it fell through the windows
+          app_mouse_capture_ =
+              pass_through &&
+              (GET_KEYSTATE_WPARAM(message->wParam) & MOUSE_BUTTONS);
+          if (!pass_through) {
+            message->message = WM_NULL;
+          }
         }
       }
 
-      // Block raw input (mouse and keyboard)
+      // Forward raw mouse input to subscribed clients and block raw input
+      // (mouse and keyboard)
       if (message->message == WM_INPUT && block_app_input_) {
+        ipc::EventsServiceImpl *events_service =
+            Core::Get()->get_rpc_server()->get_events_service();
+
+        if (events_service &&
+            events_service->IsSubscribed(
+                EventResponse::EventCase::kRawMouseInputEvent)) {
+          HandleRawInput((HRAWINPUT)message->lParam);
+        }
+
         message->message = WM_NULL;
       }
     }
@@ -364,12 +937,42 @@ LRESULT InputManager::WindowSubclassProc(_In_ HWND window, _In_ UINT message,
 
       case WM_EXITSIZEMOVE:
         resizing_moving_ = false;
+
+        // The window may have moved to another display
+        Core::Get()->get_graphics_manager()->InvalidateVsyncTiming();
         break;
 
       case WM_SIZE:
         GetClientRect(window, &window_client_area_);
         break;
 
+      // The window's thread switched to the keyboard layout of the message
+      case WM_INPUTLANGCHANGE:
+        UpdateScanCodes((HKL)long_param);
+        break;
+
+      case WM_SETTINGCHANGE:
+        UpdateMouseMetrics();
+        break;
+
+      // The display's refresh rate may have changed
+      case WM_DISPLAYCHANGE:
+        Core::Get()->get_graphics_manager()->InvalidateVsyncTiming();
+        break;
+
+      case WM_KILLFOCUS:
+        // The key ups of the blocked hotkeys go to the focused window
+        blocked_hotkey_keys_.fill(0);
+        ReleaseOverlayMouseCapture(window);
+        break;
+
+      // Another window took the mouse, so the button ups won't come
+      case WM_CAPTURECHANGED:
+        if ((HWND)long_param != window) {
+          ReleaseOverlayMouseCapture(window);
+        }
+        break;
+
       case WM_ACTIVATEAPP:
         Core::Get()
             ->get_graphics_manager()
@@ -428,6 +1031,54 @@ void InputManager::set_block_app_input_cursor(HCURSOR cursor) {
   }
 }
 
+uint32_t InputManager::get_input_coalesce_interval() const {
+  return input_coalesce_interval_;
+}
+
+void InputManager::set_input_coalesce_interval(uint32_t interval) {
+  std::lock_guard input_flush_task_lk(input_flush_task_mutex_);
+
+  input_coalesce_interval_ = interval;
+
+  if (input_flush_task_id_) {
+    Core::Get()->get_scheduler()->CancelTask(input_flush_task_id_);
+    input_flush_task_id_ = 0;
+  }
+
+  // Reschedule the flushes of the held input with the new interval
+  if (interval && has_pending_input_) {
+    input_flush_task_id_ = Core::Get()->get_scheduler()->SchedulePeriodicTask(
+        std::chrono::milliseconds(interval), [this]() { RunInputFlushTask(); });
+  }
+}
+
+void InputManager::ScheduleInputFlush() {
+  std::lock_guard input_flush_task_lk(input_flush_task_mutex_);
+  uint32_t interval = input_coalesce_interval_;
+
+  // Flush the held input periodically in case the game stops rendering
+  // frames, the task only runs while there's input to flush
+  if (!input_flush_task_id_ && interval) {
+    input_flush_task_id_ = Core::Get()->get_scheduler()->SchedulePeriodicTask(
+        std::chrono::milliseconds(interval), [this]() { RunInputFlushTask(); });
+  }
+}
+
+void InputManager::RunInputFlushTask() {
+  if (has_pending_input_) {
+    RequestInputFlush();
+    return;
+  }
+
+  // Stop waking up once the input was flushed, the window's thread schedules
+  // the task again with the next held input
+  std::lock_guard input_flush_task_lk(input_flush_task_mutex_);
+  if (!has_pending_input_ && input_flush_task_id_) {
+    Core::Get()->get_scheduler()->CancelTask(input_flush_task_id_);
+    input_flush_task_id_ = 0;
+  }
+}
+
 InputHook *InputManager::get_input_hook() { return &input_hook_; }
 
 }  // namespace input
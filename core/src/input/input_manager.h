@@ -1,10 +1,21 @@
 #pragma once
 #include <Windows.h>
 
+#include <array>
 #include <atomic>
 #include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
+#include "events.pb.h"
 #include "input_hook.h"
+#include "utils/scheduler.h"
+
+#define DEFAULT_INPUT_COALESCE_INTERVAL 8  // Milliseconds
+#define MOUSE_MOVE_MAX_SAMPLES 128
+#define RAW_MOUSE_INPUT_MAX_SAMPLES 512
+#define MAX_HOTKEYS 256  // For each client
 
 namespace overlay {
 namespace core {
@@ -16,6 +27,32 @@ struct CursorState {
   HCURSOR cursor_handle;
 };
 
+struct MouseMoveSample {
+  POINT point;
+  bool buttons_down;
+  DWORD message_time;
+  uint64_t timestamp;
+};
+
+struct MouseClick {
+  EventResponse::WindowEvent::MouseInputEvent::MouseButton button;
+  POINT point;
+  DWORD message_time;
+  uint32_t count;
+};
+
+struct RawMouseInputSample {
+  RAWMOUSE mouse;
+  uint64_t timestamp;
+};
+
+struct Hotkey {
+  uint32_t id;
+  uint8_t virtual_key;
+  uint32_t modifiers;  // MOD_ALT, MOD_CONTROL, MOD_SHIFT and MOD_WIN
+  bool block;          // Hide the hotkey's key from the game
+};
+
 class InputManager {
  public:
   InputManager();
@@ -28,6 +65,27 @@ class InputManager {
 
   void set_block_app_input_cursor(HCURSOR cursor);
 
+  uint32_t get_input_coalesce_interval() const;
+  void set_input_coalesce_interval(uint32_t interval);
+
+  // Asks the window's thread to send the coalesced mouse moves, called for
+  // each frame of the game
+  void RequestInputFlush();
+
+  // Registers the game's window for raw mouse input while any client is
+  // subscribed to it, and gives the game back its own registration after
+  void EnableRawMouseInput();
+  void DisableRawMouseInput();
+
+  // Hotkeys are matched by the window's thread on each key down, whether the
+  // game's input is blocked or not, and only the matches are sent to the
+  // clients that registered them. A client's hotkeys last as long as its
+  // subscription to the hotkey events
+  bool RegisterHotkey(const std::string &client_id, uint32_t id,
+                      uint8_t virtual_key, uint32_t modifiers, bool block);
+  bool UnregisterHotkey(const std::string &client_id, uint32_t id);
+  void RemoveClientHotkeys(const std::string &client_id);
+
   InputHook *get_input_hook();
 
  private:
@@ -40,19 +98,120 @@ class InputManager {
   InputHook input_hook_;
   HHOOK window_msg_hook_;
 
+  // A bit for each virtual key the application got a key down for and no key
+  // up yet, written only by the window's thread
+  std::array<std::atomic<uint32_t>, 256 / 32> pressed_keys_;
+  std::array<uint16_t, 256> scan_codes_;
+
+  // The events are reused by the window's thread, so translating input
+  // doesn't allocate
+  EventResponse keyboard_event_;
+  EventResponse mouse_event_;
+  EventResponse mouse_move_event_;
+  EventResponse raw_mouse_input_event_;
+  EventResponse hotkey_event_;
+
+  // The hotkeys of each client, and a bit for each virtual key that has a
+  // hotkey so other keys are passed without taking the lock
+  std::unordered_map<std::string, std::vector<Hotkey>> hotkeys_;
+  std::mutex hotkeys_mutex_;
+  std::array<std::atomic<uint32_t>, 256 / 32> hotkey_keys_;
+
+  // A bit for each virtual key whose key down was blocked for a hotkey, its
+  // repeats and key up are blocked too until the key up or until the window
+  // loses the focus, used only by the window's thread
+  std::array<uint32_t, 256 / 32> blocked_hotkey_keys_;
+
   bool resizing_moving_;
   RECT window_client_area_;
 
+  // Whether the game got a press that fell through the windows' input masks,
+  // it keeps getting the mouse input until the buttons are released. Used only
+  // by the window's thread
+  bool app_mouse_capture_;
+
+  // Whether the game's window holds the mouse capture for an overlay's window
+  // that got a press, so it gets the mouse outside of its client area until
+  // the buttons are released or it loses the focus. Used only by the window's
+  // thread
+  bool overlay_mouse_capture_;
+
+  // Clicks and drags are detected with the system's metrics, so clients
+  // don't need to interpret the gestures. Used only by the window's thread
+  MouseClick last_click_;
+  POINT drag_origin_;
+  bool dragging_;
+  UINT double_click_time_;
+  SIZE double_click_size_;
+  SIZE drag_threshold_;
+
+  // Mouse moves are held until the next frame or until the coalescing
+  // interval passes, and sent as a single event with a sample for each move.
+  // The moves are only touched by the window's thread, which sends them
+  // before any other input so the order of the events is kept
+  std::vector<MouseMoveSample> pending_mouse_moves_;
+  std::atomic<bool> has_pending_input_;
+  std::atomic<bool> input_flush_posted_;
+
+  // Raw mouse input is coalesced the same way, and only read while a client
+  // is subscribed to it
+  std::vector<RawMouseInputSample> pending_raw_mouse_input_;
+  std::atomic<bool> raw_mouse_input_enabled_;
+
+  // The game's own registration of the mouse is replaced while the window is
+  // registered, and restored once no client reads raw input. Used only by
+  // the window's thread
+  bool raw_mouse_input_registered_;
+  RAWINPUTDEVICE game_raw_mouse_device_;
+  bool has_game_raw_mouse_device_;
+
+  // The flush task is only scheduled while input is held
+  std::atomic<uint32_t> input_coalesce_interval_;
+  utils::ScheduledTaskId input_flush_task_id_;
+  std::mutex input_flush_task_mutex_;
+
   void ReleasePressedKeys();
-  uint16_t VirtualKeyToScanCode(uint8_t virtual_key);
+  void UpdatePressedKeys(UINT message, uint8_t virtual_key);
+
+  bool HandleHotkey(UINT message, uint8_t virtual_key, LPARAM long_param,
+                    DWORD message_time);
+  uint32_t GetHotkeyModifiers() const;
+  void UpdateHotkeyKeys();
+
+  uint16_t VirtualKeyToScanCode(uint8_t virtual_key, HKL keyboard_layout);
+  void UpdateScanCodes(HKL keyboard_layout);
+
+  void UpdateMouseMetrics();
+  uint32_t CountClick(
+      EventResponse::WindowEvent::MouseInputEvent::MouseButton button,
+      POINT point, DWORD message_time);
 
   void SetCursorCounter(int counter);
 
   void SaveCursorState();
   void RestoreCursorState();
 
-  void HandleKeyboardInput(UINT message, uint32_t param);
-  void HandleMouseInput(UINT message, POINT point, WPARAM word_param);
+  void HandleKeyboardInput(UINT message, uint32_t param, DWORD message_time);
+  void HandleMouseInput(UINT message, POINT point, WPARAM word_param,
+                        DWORD message_time);
+  void UpdateOverlayMouseCapture(HWND window);
+  void ReleaseOverlayMouseCapture(HWND window);
+
+  void CoalesceMouseMove(POINT point, bool buttons_down, DWORD message_time,
+                         uint64_t timestamp);
+  void FlushMouseMoves();
+
+  void ScheduleInputFlush();
+  void RunInputFlushTask();
+
+  void HandleRawInput(HRAWINPUT raw_input);
+  void FlushRawMouseInput();
+  void UpdateRawMouseInput(HWND window);
+  bool RegisterRawMouseInput(HWND window);
+  bool UnregisterRawMouseInput();
+
+  bool IsCoalescingDone(uint64_t first_timestamp, uint64_t timestamp,
+                        size_t samples, size_t max_samples) const;
 
   LRESULT WindowMsgHook(_In_ int code, _In_ WPARAM word_param,
                         _In_ LPARAM long_param);
@@ -0,0 +1,269 @@
+#include "input/input_recorder.h"
+
+#include <algorithm>
+#include <loguru/loguru.hpp>
+#include <string_view>
+
+#include "utils/timestamp.h"
+
+namespace overlay {
+namespace core {
+namespace input {
+
+InputRecorder::InputRecorder()
+    : recording_(false), records_(0), dropped_records_(0) {}
+
+InputRecorder *InputRecorder::Get() {
+  static InputRecorder input_recorder;
+
+  return &input_recorder;
+}
+
+bool InputRecorder::Start() {
+  std::lock_guard lk(mutex_);
+
+  if (recording_) {
+    return false;
+  }
+
+  // Reset the log of the previous recording
+  buffer_.clear();
+  buffer_.append(INPUT_RECORDING_MAGIC);
+  Write<uint32_t>(INPUT_RECORDING_VERSION);
+  records_ = 0;
+  dropped_records_ = 0;
+  window_indexes_.clear();
+  client_indexes_.clear();
+  mask_indexes_.clear();
+  last_scene_.clear();
+
+  recording_ = true;
+
+  DLOG_F(INFO, "Started recording input.");
+
+  return true;
+}
+
+bool InputRecorder::Stop(std::string &recording, uint64_t &records,
+                         uint64_t &dropped_records) {
+  std::lock_guard lk(mutex_);
+
+  if (!recording_) {
+    return false;
+  }
+
+  recording_ = false;
+
+  records = records_;
+  dropped_records = dropped_records_;
+
+  // Hand over the log, which also releases it
+  recording.swap(buffer_);
+  buffer_ = std::string();
+
+  DLOG_F(INFO, "Stopped input recording with %llu records (%llu dropped).",
+         records, dropped_records);
+
+  return true;
+}
+
+void InputRecorder::RecordScene(
+    const std::vector<graphics::WindowInputRegion> &window_regions) {
+  std::lock_guard lk(mutex_);
+  std::vector<uint32_t> mask_indexes;
+
+  if (!recording_) {
+    return;
+  }
+
+  // Skip the scene if no window has changed since the last scene, masks are
+  // immutable so they are compared by their pointers
+  if (window_regions.size() == last_scene_.size() &&
+      std::equal(window_regions.begin(), window_regions.end(),
+                 last_scene_.begin(), [](const auto &a, const auto &b) {
+                   return a.id == b.id && a.rect.x == b.rect.x &&
+                          a.rect.y == b.rect.y &&
+                          a.rect.width == b.rect.width &&
+                          a.rect.height == b.rect.height && a.mask == b.mask;
+                 })) {
+    return;
+  }
+
+  last_scene_ = window_regions;
+
+  // Write the new masks before the scene that uses them
+  for (auto &region : window_regions) {
+    mask_indexes.push_back(GetMaskIndex(region.mask));
+  }
+
+  if (!BeginRecord(InputRecordType::Scene,
+                   sizeof(uint32_t) + window_regions.size() *
+                                          (sizeof(uint32_t) * 3 +
+                                           sizeof(graphics::Rect)))) {
+    return;
+  }
+
+  Write<uint32_t>((uint32_t)window_regions.size());
+  for (size_t i = 0; i < window_regions.size(); i++) {
+    const graphics::WindowInputRegion &region = window_regions[i];
+
+    Write<uint32_t>(GetWindowIndex(region.id));
+    Write<uint32_t>(GetClientIndex(region.id.client_id));
+    Write<int32_t>(region.rect.x);
+    Write<int32_t>(region.rect.y);
+    Write<uint32_t>(region.rect.width);
+    Write<uint32_t>(region.rect.height);
+    Write<uint32_t>(mask_indexes[i]);
+  }
+}
+
+void InputRecorder::RecordFocus(const graphics::WindowUniqueId &window_id) {
+  std::lock_guard lk(mutex_);
+
+  if (!recording_ || !BeginRecord(InputRecordType::Focus, sizeof(uint32_t))) {
+    return;
+  }
+
+  Write<uint32_t>(GetWindowIndex(window_id));
+}
+
+void InputRecorder::RecordMouseInput(
+    EventResponse::WindowEvent::MouseInputEvent::MouseInputType type,
+    POINT point, bool buttons_down) {
+  std::lock_guard lk(mutex_);
+
+  if (!recording_ ||
+      !BeginRecord(InputRecordType::MouseInput,
+                   sizeof(uint8_t) * 2 + sizeof(int32_t) * 2)) {
+    return;
+  }
+
+  Write<uint8_t>((uint8_t)type);
+  Write<int32_t>(point.x);
+  Write<int32_t>(point.y);
+  Write<uint8_t>(buttons_down);
+}
+
+void InputRecorder::RecordMessage(UINT message, WPARAM word_param) {
+  std::lock_guard lk(mutex_);
+
+  if (!recording_ ||
+      !BeginRecord(InputRecordType::Message,
+                   sizeof(uint32_t) + sizeof(uint64_t))) {
+    return;
+  }
+
+  Write<uint32_t>(message);
+  Write<uint64_t>(message >= WM_KEYFIRST && message <= WM_KEYLAST
+                      ? 0
+                      : (uint64_t)word_param);
+}
+
+void InputRecorder::RecordRoute(
+    const graphics::WindowUniqueId &window_id, int64_t x, int64_t y,
+    const graphics::WindowUniqueId &focused_window_id,
+    const graphics::WindowUniqueId &hovered_window_id) {
+  std::lock_guard lk(mutex_);
+
+  if (!recording_ ||
+      !BeginRecord(InputRecordType::Route,
+                   sizeof(uint32_t) * 3 + sizeof(int64_t) * 2)) {
+    return;
+  }
+
+  Write<uint32_t>(GetWindowIndex(window_id));
+  Write<int64_t>(x);
+  Write<int64_t>(y);
+  Write<uint32_t>(GetWindowIndex(focused_window_id));
+  Write<uint32_t>(GetWindowIndex(hovered_window_id));
+}
+
+bool InputRecorder::BeginRecord(InputRecordType type, size_t size) {
+  // Drop the record if the log is full
+  if (buffer_.size() + sizeof(uint8_t) + sizeof(uint64_t) + size >
+      INPUT_RECORDING_CAPACITY) {
+    dropped_records_++;
+    return false;
+  }
+
+  Write<uint8_t>((uint8_t)type);
+  Write<uint64_t>(utils::timestamp::GetTimestamp());
+  records_++;
+
+  return true;
+}
+
+uint32_t InputRecorder::GetWindowIndex(
+    const graphics::WindowUniqueId &window_id) {
+  if (!window_id) {
+    return 0;
+  }
+
+  return window_indexes_
+      .try_emplace(window_id, (uint32_t)window_indexes_.size() + 1)
+      .first->second;
+}
+
+uint32_t InputRecorder::GetClientIndex(const std::string &client_id) {
+  if (client_id.empty()) {
+    return 0;
+  }
+
+  return client_indexes_
+      .try_emplace(client_id, (uint32_t)client_indexes_.size() + 1)
+      .first->second;
+}
+
+uint32_t InputRecorder::GetMaskIndex(
+    const std::shared_ptr<const graphics::InputMask> &mask) {
+  uint32_t index = 0;
+
+  if (!mask) {
+    return 0;
+  }
+
+  auto mask_it = mask_indexes_.find(mask->get_id());
+  if (mask_it != mask_indexes_.end()) {
+    return mask_it->second;
+  }
+
+  size_t size = sizeof(uint32_t) + sizeof(uint8_t) +
+                (mask->get_type() == graphics::InputMaskType::Rects
+                     ? sizeof(uint32_t) +
+                           mask->get_rects().size() * sizeof(graphics::Rect)
+                     : sizeof(uint32_t) * 2 + sizeof(uint8_t) +
+                           sizeof(uint64_t));
+
+  // Scenes with a dropped mask route as if the window had no mask
+  if (!BeginRecord(InputRecordType::Mask, size)) {
+    return 0;
+  }
+
+  index = (uint32_t)mask_indexes_.size() + 1;
+  mask_indexes_[mask->get_id()] = index;
+
+  Write<uint32_t>(index);
+  Write<uint8_t>((uint8_t)mask->get_type());
+  if (mask->get_type() == graphics::InputMaskType::Rects) {
+    Write<uint32_t>((uint32_t)mask->get_rects().size());
+    for (auto &rect : mask->get_rects()) {
+      Write<int32_t>(rect.x);
+      Write<int32_t>(rect.y);
+      Write<uint32_t>(rect.width);
+      Write<uint32_t>(rect.height);
+    }
+  } else {
+    Write<uint32_t>(mask->get_width());
+    Write<uint32_t>(mask->get_height());
+    Write<uint8_t>(mask->get_alpha_threshold());
+    Write<uint64_t>(std::hash<std::string_view>()(
+        std::string_view((const char *)mask->get_bitmap().data(),
+                         mask->get_bitmap().size() * sizeof(uint64_t))));
+  }
+
+  return index;
+}
+
+}  // namespace input
+}  // namespace core
+}  // namespace overlay
\ No newline at end of file
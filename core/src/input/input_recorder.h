@@ -0,0 +1,103 @@
+#pragma once
+#include <Windows.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "events.pb.h"
+#include "graphics/rect.h"
+#include "graphics/window.h"
+
+#define INPUT_RECORDING_MAGIC "OVIR"
+#define INPUT_RECORDING_VERSION 6
+#define INPUT_RECORDING_CAPACITY (64 * 1024 * 1024)  // Bytes
+
+namespace overlay {
+namespace core {
+namespace input {
+
+enum class InputRecordType : uint8_t {
+  Scene = 0,       // The windows' ids and rects from the bottom to the top
+  Focus = 1,       // The focused window
+  MouseInput = 2,  // A mouse event before it is routed
+  Route = 3,       // Where the last mouse event went and the focus after it
+  Mask = 4,        // An input mask, before the first scene that uses it
+  Message = 5      // A keyboard or mouse message of the game's window
+};
+
+// Records the input routing to a compact binary log which is replayed offline
+// by the input replayer tool. Windows, clients and input masks are written as
+// indexes, 0 being an empty id or no mask.
+//
+// The log starts with the magic and the version, and each record starts with
+// the record type and the timestamp:
+//   Scene:      uint32 count, {uint32 window, uint32 client, int32 x,
+//               int32 y, uint32 width, uint32 height, uint32 mask} * count
+//   Focus:      uint32 window
+//   MouseInput: uint8 type, int32 x, int32 y, uint8 buttons down
+//   Route:      uint32 window, int64 x, int64 y, uint32 focused window,
+//               uint32 hovered window
+//   Mask:       uint32 mask, uint8 type, then for rects uint32 count,
+//               {int32 x, int32 y, uint32 width, uint32 height} * count, or
+//               for alpha uint32 width, uint32 height, uint8 threshold,
+//               uint64 bitmap hash, since the bitmaps are too large to log
+//   Message:    uint32 message, uint64 word param, which is 0 for the
+//               keyboard messages so the keys aren't recorded
+class InputRecorder {
+ public:
+  static InputRecorder *Get();
+
+  bool Start();
+  bool Stop(std::string &recording, uint64_t &records,
+            uint64_t &dropped_records);
+
+  void RecordScene(
+      const std::vector<graphics::WindowInputRegion> &window_regions);
+  void RecordFocus(const graphics::WindowUniqueId &window_id);
+  void RecordMouseInput(
+      EventResponse::WindowEvent::MouseInputEvent::MouseInputType type,
+      POINT point, bool buttons_down);
+  void RecordMessage(UINT message, WPARAM word_param);
+  // The window is empty if no window got the event
+  void RecordRoute(const graphics::WindowUniqueId &window_id, int64_t x,
+                   int64_t y, const graphics::WindowUniqueId &focused_window_id,
+                   const graphics::WindowUniqueId &hovered_window_id);
+
+  inline bool is_recording() const {
+    return recording_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  std::atomic<bool> recording_;
+
+  std::string buffer_;
+  uint64_t records_;
+  uint64_t dropped_records_;
+  std::unordered_map<graphics::WindowUniqueId, uint32_t> window_indexes_;
+  std::unordered_map<std::string, uint32_t> client_indexes_;
+  std::unordered_map<uint64_t, uint32_t> mask_indexes_;
+  std::vector<graphics::WindowInputRegion> last_scene_;
+  std::mutex mutex_;
+
+  InputRecorder();
+
+  bool BeginRecord(InputRecordType type, size_t size);
+  uint32_t GetWindowIndex(const graphics::WindowUniqueId &window_id);
+  uint32_t GetClientIndex(const std::string &client_id);
+  uint32_t GetMaskIndex(const std::shared_ptr<const graphics::InputMask> &mask);
+
+  template <typename T>
+  inline void Write(T value) {
+    buffer_.append(reinterpret_cast<const char *>(&value), sizeof(value));
+  }
+};
+
+}  // namespace input
+}  // namespace core
+}  // namespace overlay
\ No newline at end of file
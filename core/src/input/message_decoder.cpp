@@ -0,0 +1,135 @@
+#include "input/message_decoder.h"
+
+#include <array>
+
+namespace overlay {
+namespace core {
+namespace input {
+
+struct KeyboardMessage {
+  bool valid;
+  EventResponse::WindowEvent::KeyboardInputEvent::KeyboardInputType type;
+};
+
+struct MouseMessage {
+  bool valid;
+  EventResponse::WindowEvent::MouseInputEvent::MouseInputType type;
+  EventResponse::WindowEvent::MouseInputEvent::MouseButton button;
+  bool x_button;  // The button is in the high word of the WPARAM
+  bool wheel;     // The wheel's delta is in the high word of the WPARAM
+};
+
+// Translation of the keyboard messages, indexed from WM_KEYFIRST
+static const auto kKeyboardMessages = []() {
+  std::array<KeyboardMessage, WM_KEYLAST - WM_KEYFIRST + 1> messages = {};
+
+  auto add = [&messages](
+                 UINT message,
+                 EventResponse::WindowEvent::KeyboardInputEvent::
+                     KeyboardInputType type) {
+    messages[message - WM_KEYFIRST] = {true, type};
+  };
+
+  add(WM_KEYDOWN, EventResponse::WindowEvent::KeyboardInputEvent::KEY_DOWN);
+  add(WM_SYSKEYDOWN,
+      EventResponse::WindowEvent::KeyboardInputEvent::KEY_DOWN);
+  add(WM_CHAR, EventResponse::WindowEvent::KeyboardInputEvent::CHAR);
+  add(WM_SYSCHAR, EventResponse::WindowEvent::KeyboardInputEvent::CHAR);
+  add(WM_KEYUP, EventResponse::WindowEvent::KeyboardInputEvent::KEY_UP);
+  add(WM_SYSKEYUP, EventResponse::WindowEvent::KeyboardInputEvent::KEY_UP);
+
+  return messages;
+}();
+
+// Translation of the mouse messages, indexed from WM_MOUSEFIRST
+static const auto kMouseMessages = []() {
+  std::array<MouseMessage, WM_MOUSELAST - WM_MOUSEFIRST + 1> messages = {};
+
+  auto add = [&messages](
+                 UINT message,
+                 EventResponse::WindowEvent::MouseInputEvent::MouseInputType
+                     type,
+                 EventResponse::WindowEvent::MouseInputEvent::MouseButton
+                     button) {
+    messages[message - WM_MOUSEFIRST] = {
+        true, type, button,
+        message == WM_XBUTTONDOWN || message == WM_XBUTTONUP ||
+            message == WM_XBUTTONDBLCLK,
+        message == WM_MOUSEWHEEL || message == WM_MOUSEHWHEEL};
+  };
+
+  // Add the down, up and double click messages of each button
+  auto add_button =
+      [&add](UINT down_message,
+             EventResponse::WindowEvent::MouseInputEvent::MouseButton button) {
+        add(down_message,
+            EventResponse::WindowEvent::MouseInputEvent::MOUSE_BUTTON_DOWN,
+            button);
+        add(down_message + 1,
+            EventResponse::WindowEvent::MouseInputEvent::MOUSE_BUTTON_UP,
+            button);
+        add(down_message + 2,
+            EventResponse::WindowEvent::MouseInputEvent::
+                MOUSE_BUTTON_DOUBLE_CLICK,
+            button);
+      };
+
+  add(WM_MOUSEMOVE, EventResponse::WindowEvent::MouseInputEvent::MOUSE_MOVE,
+      EventResponse::WindowEvent::MouseInputEvent::LEFT_BUTTON);
+  add_button(WM_LBUTTONDOWN,
+             EventResponse::WindowEvent::MouseInputEvent::LEFT_BUTTON);
+  add_button(WM_MBUTTONDOWN,
+             EventResponse::WindowEvent::MouseInputEvent::MIDDLE_BUTTON);
+  add_button(WM_RBUTTONDOWN,
+             EventResponse::WindowEvent::MouseInputEvent::RIGHT_BUTTON);
+  add_button(WM_XBUTTONDOWN,
+             EventResponse::WindowEvent::MouseInputEvent::X_BUTTON_1);
+  add(WM_MOUSEWHEEL,
+      EventResponse::WindowEvent::MouseInputEvent::MOUSE_VERTICAL_WHEEL,
+      EventResponse::WindowEvent::MouseInputEvent::LEFT_BUTTON);
+  add(WM_MOUSEHWHEEL,
+      EventResponse::WindowEvent::MouseInputEvent::MOUSE_HORIZONTAL_WHEEL,
+      EventResponse::WindowEvent::MouseInputEvent::LEFT_BUTTON);
+
+  return messages;
+}();
+
+bool DecodeKeyboardMessage(
+    UINT message,
+    EventResponse::WindowEvent::KeyboardInputEvent::KeyboardInputType &type) {
+  if (message < WM_KEYFIRST || message > WM_KEYLAST ||
+      !kKeyboardMessages[message - WM_KEYFIRST].valid) {
+    return false;
+  }
+
+  type = kKeyboardMessages[message - WM_KEYFIRST].type;
+
+  return true;
+}
+
+bool DecodeMouseMessage(UINT message, WPARAM word_param,
+                        DecodedMouseMessage &decoded) {
+  if (message < WM_MOUSEFIRST || message > WM_MOUSELAST ||
+      !kMouseMessages[message - WM_MOUSEFIRST].valid) {
+    return false;
+  }
+
+  const MouseMessage &mouse_message = kMouseMessages[message - WM_MOUSEFIRST];
+
+  decoded.type = mouse_message.type;
+  decoded.button =
+      !mouse_message.x_button ? mouse_message.button
+      : GET_XBUTTON_WPARAM(word_param) == XBUTTON1
+          ? EventResponse::WindowEvent::MouseInputEvent::X_BUTTON_1
+          : EventResponse::WindowEvent::MouseInputEvent::X_BUTTON_2;
+  decoded.wheel_delta =
+      mouse_message.wheel ? GET_WHEEL_DELTA_WPARAM(word_param) : 0;
+  decoded.buttons_down =
+      (GET_KEYSTATE_WPARAM(word_param) & MOUSE_BUTTONS) != 0;
+
+  return true;
+}
+
+}  // namespace input
+}  // namespace core
+}  // namespace overlay
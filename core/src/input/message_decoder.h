@@ -0,0 +1,35 @@
+#pragma once
+#include <Windows.h>
+
+#include <cstdint>
+
+#include "events.pb.h"
+
+#define MOUSE_BUTTONS \
+  (MK_LBUTTON | MK_RBUTTON | MK_MBUTTON | MK_XBUTTON1 | MK_XBUTTON2)
+
+namespace overlay {
+namespace core {
+namespace input {
+
+// The fields of a mouse event that only depend on its message
+struct DecodedMouseMessage {
+  EventResponse::WindowEvent::MouseInputEvent::MouseInputType type;
+  EventResponse::WindowEvent::MouseInputEvent::MouseButton button;
+  int32_t wheel_delta;
+  bool buttons_down;  // Whether any mouse button is held after the message
+};
+
+// Translates the keyboard and mouse messages with tables indexed from
+// WM_KEYFIRST and WM_MOUSEFIRST. The messages that aren't input return false.
+// Nothing but the message is read, so the decoding is shared by the input
+// manager and the input replayer
+bool DecodeKeyboardMessage(
+    UINT message,
+    EventResponse::WindowEvent::KeyboardInputEvent::KeyboardInputType &type);
+bool DecodeMouseMessage(UINT message, WPARAM word_param,
+                        DecodedMouseMessage &decoded);
+
+}  // namespace input
+}  // namespace core
+}  // namespace overlay
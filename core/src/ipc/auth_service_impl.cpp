@@ -3,6 +3,7 @@
 #include <windows.h>
 
 #include "core.h"
+#include "utils/guid.h"
 
 namespace overlay {
 namespace core {
@@ -11,11 +12,12 @@ namespace ipc {
 grpc::Status AuthServiceImpl::AuthenticateWithToken(
     grpc::ServerContext *context, const TokenAuthenticationRequest *request,
     TokenAuthenticationResponse *response) {
-  GUID token;
+  GUID token, session_id;
   DWORD process_id;
 
   // If the client is already authenticated
-  if (Core::Get()->get_rpc_server()->GetClient(context->peer()) != nullptr) {
+  if (Core::Get()->get_rpc_server()->GetClient(
+          RpcServer::GetClientId(context)) != nullptr) {
     return grpc::Status::CANCELLED;
   }
 
@@ -32,7 +34,13 @@ grpc::Status AuthServiceImpl::AuthenticateWithToken(
   Core::Get()->get_rpc_server()->get_token_server()->InvalidateProcessToken(
       token);
 
-  Core::Get()->get_rpc_server()->RegisterClient(context->peer(), process_id);
+  // Generate a session for the client since clients on the local transport
+  // can't be told apart by their peer address
+  session_id = utils::Guid::GenerateGuid();
+  response->set_session_id(utils::Guid::GuidToString(&session_id));
+
+  Core::Get()->get_rpc_server()->RegisterClient(response->session_id(),
+                                                process_id);
 
   return grpc::Status::OK;
 }
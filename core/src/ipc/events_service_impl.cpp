@@ -4,18 +4,19 @@
 #include <magic_enum.hpp>
 
 #include "core.h"
+#include "utils/timestamp.h"
+#include "utils/trace_recorder.h"
 
 namespace overlay {
 namespace core {
 namespace ipc {
 
+EventsServiceImpl::EventsServiceImpl() : subscribed_events_(0) {}
+
 grpc::Status EventsServiceImpl::UnsubscribeEvent(
     grpc::ServerContext *context, const EventUnsubscribeRequest *request,
     EventUnsubscribeResponse *response) {
-  if ((EventResponse::EventCase)request->type() <=
-          EventResponse::EventCase::EVENT_NOT_SET ||
-      !magic_enum::enum_contains<EventResponse::EventCase>(
-          (int)request->type())) {
+  if (!IsValidEventType(request->type())) {
     return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT,
                         "Invalid event type");
   }
@@ -24,7 +25,7 @@ grpc::Status EventsServiceImpl::UnsubscribeEvent(
 
   try {
     event_workers_.at((EventResponse::EventCase)request->type())
-        .at(context->peer())
+        .at(RpcServer::GetClientId(context))
         ->Finish(grpc::Status::OK);
   } catch (...) {
     return grpc::Status(grpc::StatusCode::NOT_FOUND,
@@ -34,6 +35,32 @@ grpc::Status EventsServiceImpl::UnsubscribeEvent(
   return grpc::Status::OK;
 }
 
+grpc::Status EventsServiceImpl::Ping(grpc::ServerContext *context,
+                                     const PingRequest *request,
+                                     PingResponse *response) {
+  response->set_receivetime(utils::timestamp::GetTimestamp());
+
+  // Report the input latencies the client measured
+  if (request->inputlatencies_size()) {
+    Core::Get()
+        ->get_graphics_manager()
+        ->get_stats_calculator()
+        ->AddInputLatencies(RpcServer::GetClientId(context),
+                            request->inputlatencies());
+  }
+
+  return grpc::Status::OK;
+}
+
+bool EventsServiceImpl::IsValidEventType(uint64_t event_type) {
+  // Batches are only created by the workers and can't be subscribed to
+  return (EventResponse::EventCase)event_type >
+             EventResponse::EventCase::EVENT_NOT_SET &&
+         (EventResponse::EventCase)event_type !=
+             EventResponse::EventCase::kEventBatch &&
+         magic_enum::enum_contains<EventResponse::EventCase>((int)event_type);
+}
+
 void EventsServiceImpl::AsyncInitialize(grpc::ServerBuilder &server_builder) {
   completion_queue_ = server_builder.AddCompletionQueue();
 }
@@ -67,24 +94,62 @@ void EventsServiceImpl::StartHandlingAsyncRpcs() {
 void EventsServiceImpl::RegisterEventWorker(EventResponse::EventCase event_type,
                                             AsyncEventsServiceWorker *worker) {
   CHECK_F(event_type > EventResponse::EventCase::EVENT_NOT_SET);
-  std::lock_guard workers_lk(event_workers_mutex_);
+  std::unique_lock workers_lk(event_workers_mutex_);
 
   event_workers_[event_type][worker->GetClientId()] = worker;
+  UpdateSubscribedEvents(event_type);
+
+  // Raw input is only read from the game's window once it's requested, the
+  // workers are locked so it isn't disabled by a concurrent unsubscription
+  if (event_type == EventResponse::EventCase::kRawMouseInputEvent) {
+    Core::Get()->get_input_manager()->EnableRawMouseInput();
+  }
+  workers_lk.unlock();
+
+  // Start calculating the stats for the client
+  Core::Get()->get_graphics_manager()->get_stats_calculator()->Subscribe(
+      event_type, worker->GetClientId(), worker->GetInterval());
 }
 
 void EventsServiceImpl::RemoveEventWorker(EventResponse::EventCase event_type,
                                           AsyncEventsServiceWorker *worker) {
   CHECK_F(event_type > EventResponse::EventCase::EVENT_NOT_SET);
-  std::lock_guard workers_lk(event_workers_mutex_);
+  std::unique_lock workers_lk(event_workers_mutex_);
 
   try {
     event_workers_.at(event_type).erase(worker->GetClientId());
   } catch (...) {
   }
+  UpdateSubscribedEvents(event_type);
+
+  // Stop reading raw input once the last client unsubscribed from it
+  if (event_type == EventResponse::EventCase::kRawMouseInputEvent &&
+      !IsSubscribed(event_type)) {
+    Core::Get()->get_input_manager()->DisableRawMouseInput();
+  }
+  workers_lk.unlock();
+
+  Core::Get()->get_graphics_manager()->get_stats_calculator()->Unsubscribe(
+      event_type, worker->GetClientId());
+
+  // The client's hotkeys end with its subscription, whether it unsubscribed
+  // or disconnected
+  if (event_type == EventResponse::EventCase::kHotkeyEvent) {
+    Core::Get()->get_input_manager()->RemoveClientHotkeys(
+        worker->GetClientId());
+  }
+
+  // The helper gets the window events while it's connected, so the settings
+  // it owns are reset once it disconnects
+  if (event_type == EventResponse::EventCase::kWindowEvent) {
+    Core::Get()->get_rpc_server()->get_windows_service()->ReleaseClientSettings(
+        worker->GetClientId());
+  }
 }
 
-bool EventsServiceImpl::SendEventToClient(std::string client_id,
-                                          EventResponse event) {
+bool EventsServiceImpl::SendEventToClient(const std::string &client_id,
+                                          const EventResponse &event) {
+  TRACE_SCOPE("events", "SendEventToClient");
   CHECK_F(event.event_case() > EventResponse::EventCase::EVENT_NOT_SET);
   std::lock_guard workers_lk(event_workers_mutex_);
 
@@ -97,6 +162,7 @@ bool EventsServiceImpl::SendEventToClient(std::string client_id,
 }
 
 void EventsServiceImpl::BroadcastEvent(EventResponse event) {
+  TRACE_SCOPE("events", "BroadcastEvent");
   CHECK_F(event.event_case() > EventResponse::EventCase::EVENT_NOT_SET);
   std::lock_guard workers_lk(event_workers_mutex_);
 
@@ -104,13 +170,35 @@ void EventsServiceImpl::BroadcastEvent(EventResponse event) {
     return;
   }
 
-  auto workers = event_workers_.at(event.event_case());
+  auto &workers = event_workers_.at(event.event_case());
 
   for (auto &worker : workers) {
     worker.second->SendEvent(event);
   }
 }
 
+bool EventsServiceImpl::IsSubscribed(
+    EventResponse::EventCase event_type) const {
+  return subscribed_events_ & (1 << event_type);
+}
+
+bool EventsServiceImpl::IsClientSubscribed(
+    const std::string &client_id, EventResponse::EventCase event_type) {
+  std::lock_guard workers_lk(event_workers_mutex_);
+  auto workers = event_workers_.find(event_type);
+
+  return workers != event_workers_.end() && workers->second.count(client_id);
+}
+
+void EventsServiceImpl::UpdateSubscribedEvents(
+    EventResponse::EventCase event_type) {
+  if (event_workers_[event_type].empty()) {
+    subscribed_events_ &= ~(1 << event_type);
+  } else {
+    subscribed_events_ |= 1 << event_type;
+  }
+}
+
 AsyncEventsServiceWorker::AsyncEventsServiceWorker(
     EventsServiceImpl *service, grpc::ServerCompletionQueue *completion_queue)
     : service_(service),
@@ -131,10 +219,7 @@ void AsyncEventsServiceWorker::Handle() {
     new AsyncEventsServiceWorker(service_, completion_queue_);
 
     // If the event type is invalid
-    if ((EventResponse::EventCase)request_.type() <=
-            EventResponse::EventCase::EVENT_NOT_SET ||
-        !magic_enum::enum_contains<EventResponse::EventCase>(
-            (int)request_.type())) {
+    if (!EventsServiceImpl::IsValidEventType(request_.type())) {
       Finish(grpc::Status(grpc::StatusCode::INVALID_ARGUMENT,
                           "Invalid event type"));
     } else {
@@ -148,10 +233,23 @@ void AsyncEventsServiceWorker::Handle() {
     std::unique_lock event_queue_lk(event_queue_mutex_);
 
     if (writing_) {
-      if (!event_queue_.empty()) {
-        event = event_queue_.front();
+      if (event_queue_.size() == 1) {
+        event = std::move(event_queue_.front());
         event_queue_.pop();
 
+        event_queue_lk.unlock();
+        writer_.Write(event, this);
+      } else if (!event_queue_.empty()) {
+        EventResponse::EventBatch *batch = event.mutable_eventbatch();
+
+        // Send every event that was queued during the last write in a single
+        // message, so a burst of input costs a single write
+        while (!event_queue_.empty() &&
+               batch->events_size() < EVENT_BATCH_MAX_EVENTS) {
+          *batch->add_events() = std::move(event_queue_.front());
+          event_queue_.pop();
+        }
+
         event_queue_lk.unlock();
         writer_.Write(event, this);
       } else {
@@ -162,7 +260,7 @@ void AsyncEventsServiceWorker::Handle() {
 }
 
 void overlay::core::ipc::AsyncEventsServiceWorker::SendEvent(
-    overlay::EventResponse &event) {
+    const overlay::EventResponse &event) {
   std::unique_lock event_queue_lk(event_queue_mutex_);
 
   if (writing_) {
@@ -191,7 +289,11 @@ void AsyncEventsServiceWorker::ForceFinish() {
 
 std::string overlay::core::ipc::AsyncEventsServiceWorker::GetClientId() const {
   CHECK_F(registered_ == true);
-  return context_.peer();
+  return RpcServer::GetClientId(&context_);
+}
+
+uint32_t AsyncEventsServiceWorker::GetInterval() const {
+  return request_.interval();
 }
 
 }  // namespace ipc
@@ -12,6 +12,8 @@
 #include "events.grpc.pb.h"
 #pragma warning(pop)
 
+#define EVENT_BATCH_MAX_EVENTS 256
+
 namespace overlay {
 namespace core {
 namespace ipc {
@@ -20,16 +22,27 @@ class AsyncEventsServiceWorker;
 class EventsServiceImpl final
     : public Events::WithAsyncMethod_SubscribeToEvent<Events::Service> {
  public:
+  EventsServiceImpl();
+
   grpc::Status UnsubscribeEvent(grpc::ServerContext *context,
                                 const EventUnsubscribeRequest *request,
                                 EventUnsubscribeResponse *response);
+  grpc::Status Ping(grpc::ServerContext *context, const PingRequest *request,
+                    PingResponse *response);
 
   void AsyncInitialize(grpc::ServerBuilder &server_builder);
   void StartHandlingAsyncRpcs();
 
-  bool SendEventToClient(std::string client_id, EventResponse event);
+  bool SendEventToClient(const std::string &client_id,
+                         const EventResponse &event);
   void BroadcastEvent(EventResponse event);
 
+  bool IsSubscribed(EventResponse::EventCase event_type) const;
+  bool IsClientSubscribed(const std::string &client_id,
+                          EventResponse::EventCase event_type);
+
+  static bool IsValidEventType(uint64_t event_type);
+
  private:
   std::unique_ptr<grpc::ServerCompletionQueue> completion_queue_;
   std::thread async_rpcs_thread_;
@@ -40,6 +53,12 @@ class EventsServiceImpl final
       event_workers_;
   std::mutex event_workers_mutex_;
 
+  // A bit for each event type with subscribers, so the senders of per-frame
+  // events can skip building them without locking
+  std::atomic<uint32_t> subscribed_events_;
+
+  void UpdateSubscribedEvents(EventResponse::EventCase event_type);
+
   void RegisterEventWorker(EventResponse::EventCase event_type,
                            AsyncEventsServiceWorker *worker);
   void RemoveEventWorker(EventResponse::EventCase event_type,
@@ -54,12 +73,13 @@ class AsyncEventsServiceWorker {
                            grpc::ServerCompletionQueue *completion_queue);
 
   void Handle();
-  void SendEvent(EventResponse &event);
+  void SendEvent(const EventResponse &event);
 
   void Finish(grpc::Status status);
   void ForceFinish();
 
   std::string GetClientId() const;
+  uint32_t GetInterval() const;
 
  private:
   EventsServiceImpl *service_;
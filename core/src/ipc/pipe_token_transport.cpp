@@ -0,0 +1,133 @@
+#include "pipe_token_transport.h"
+
+#include <loguru/loguru.hpp>
+
+namespace overlay {
+namespace core {
+namespace ipc {
+
+PipeTokenTransport::PipeTokenTransport(std::string pipe_name)
+    : pipe_name_(pipe_name), instances_(TOKEN_PIPE_INSTANCES) {}
+
+bool PipeTokenTransport::Start(TokenRequestHandler handler) {
+  for (auto &instance : instances_) {
+    // Create an instance of the named pipe for outbound communication
+    instance.pipe = CreateNamedPipeA(
+        pipe_name_.c_str(), PIPE_ACCESS_OUTBOUND | FILE_FLAG_OVERLAPPED,
+        PIPE_TYPE_MESSAGE | PIPE_READMODE_MESSAGE | PIPE_WAIT |
+            PIPE_REJECT_REMOTE_CLIENTS,
+        TOKEN_PIPE_INSTANCES, sizeof(AuthenticateResponse), 0, 0, NULL);
+    if (instance.pipe == INVALID_HANDLE_VALUE) {
+      DLOG_F(ERROR, "Unable to create token pipe instance! (Error: 0x%x)",
+             GetLastError());
+      return false;
+    }
+
+    // Create the event of the instance's operations
+    std::memset(&instance.overlapped, 0, sizeof(instance.overlapped));
+    instance.overlapped.hEvent = CreateEventA(NULL, TRUE, TRUE, NULL);
+    if (instance.overlapped.hEvent == NULL) {
+      return false;
+    }
+  }
+
+  DLOG_F(INFO, "Token pipe '%s' is listening with %d instances.",
+         pipe_name_.c_str(), TOKEN_PIPE_INSTANCES);
+
+  // Start pipe main thread
+  main_thread_ =
+      std::thread(&PipeTokenTransport::PipeMainThread, this, handler);
+
+  return true;
+}
+
+void PipeTokenTransport::PipeMainThread(TokenRequestHandler handler) {
+  std::vector<HANDLE> events;
+  DWORD wait_result = 0;
+
+#ifdef DEBUG
+  loguru::set_thread_name("token server");
+#endif
+
+  // Start waiting for clients on all instances
+  for (auto &instance : instances_) {
+    events.push_back(instance.overlapped.hEvent);
+    ConnectInstance(instance);
+  }
+
+  // TODO: Handle stopping threads
+  while (true) {
+    wait_result = WaitForMultipleObjects((DWORD)events.size(), events.data(),
+                                         FALSE, INFINITE);
+    if (wait_result >= WAIT_OBJECT_0 + events.size()) {
+      DLOG_F(ERROR, "Unable to wait for token pipe instances! (Error: 0x%x)",
+             GetLastError());
+      return;
+    }
+
+    HandleInstance(instances_[wait_result - WAIT_OBJECT_0], handler);
+  }
+}
+
+void PipeTokenTransport::ConnectInstance(PipeInstance &instance) {
+  instance.state = PipeState::Connecting;
+
+  // Wait for a client asynchronously, the event is signaled once connected
+  if (!ConnectNamedPipe(instance.pipe, &instance.overlapped)) {
+    switch (GetLastError()) {
+      case ERROR_IO_PENDING:
+        break;
+
+      case ERROR_PIPE_CONNECTED:
+        SetEvent(instance.overlapped.hEvent);
+        break;
+
+      default:
+        DisconnectNamedPipe(instance.pipe);
+        SetEvent(instance.overlapped.hEvent);
+        break;
+    }
+  }
+}
+
+void PipeTokenTransport::HandleInstance(PipeInstance &instance,
+                                        TokenRequestHandler &handler) {
+  DWORD process_id = 0, transferred = 0;
+
+  // If the connection or the write has failed, wait for the next client
+  if (!GetOverlappedResult(instance.pipe, &instance.overlapped, &transferred,
+                           FALSE) &&
+      GetLastError() != ERROR_PIPE_CONNECTED) {
+    DisconnectNamedPipe(instance.pipe);
+    ConnectInstance(instance);
+    return;
+  }
+
+  // The response was sent to the client
+  if (instance.state == PipeState::Writing) {
+    DisconnectNamedPipe(instance.pipe);
+    ConnectInstance(instance);
+    return;
+  }
+
+  // Get client's process id and generate the response for it
+  if (!GetNamedPipeClientProcessId(instance.pipe, &process_id) ||
+      !handler(process_id, instance.response)) {
+    DisconnectNamedPipe(instance.pipe);
+    ConnectInstance(instance);
+    return;
+  }
+
+  // Send the response to the client without blocking the other instances
+  instance.state = PipeState::Writing;
+  if (!WriteFile(instance.pipe, &instance.response, sizeof(instance.response),
+                 NULL, &instance.overlapped) &&
+      GetLastError() != ERROR_IO_PENDING) {
+    DisconnectNamedPipe(instance.pipe);
+    ConnectInstance(instance);
+  }
+}
+
+}  // namespace ipc
+}  // namespace core
+}  // namespace overlay
@@ -0,0 +1,45 @@
+#pragma once
+#include <windows.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "token_transport.h"
+
+#define TOKEN_PIPE_INSTANCES 8
+
+namespace overlay {
+namespace core {
+namespace ipc {
+
+class PipeTokenTransport : public TokenTransport {
+ public:
+  PipeTokenTransport(std::string pipe_name);
+
+  virtual bool Start(TokenRequestHandler handler);
+
+ private:
+  enum class PipeState { Connecting, Writing };
+
+  struct PipeInstance {
+    HANDLE pipe;
+    OVERLAPPED overlapped;
+    PipeState state;
+    AuthenticateResponse response;
+  };
+
+  std::string pipe_name_;
+  std::vector<PipeInstance> instances_;
+
+  std::thread main_thread_;
+
+  void PipeMainThread(TokenRequestHandler handler);
+
+  void ConnectInstance(PipeInstance &instance);
+  void HandleInstance(PipeInstance &instance, TokenRequestHandler &handler);
+};
+
+}  // namespace ipc
+}  // namespace core
+}  // namespace overlay
@@ -1,20 +1,28 @@
 #include "rpc_server.h"
 
+#include <afunix.h>
 #include <grpcpp/health_check_service_interface.h>
 #include <openssl/bio.h>
+#include <openssl/ec.h>
+#include <openssl/evp.h>
 #include <openssl/pem.h>
-#include <openssl/rsa.h>
 #include <openssl/x509.h>
 
 #include <loguru/loguru.hpp>
 
 #include "token_interceptor.h"
+#include "utils/timestamp.h"
+#include "utils/token.h"
 
 namespace overlay {
 namespace core {
 namespace ipc {
 
-RpcServer::RpcServer() : server_(), port_(0) {}
+RpcServer::RpcServer()
+    : server_(),
+      port_(0),
+      clients_(std::make_shared<const ClientsMap>()),
+      started_events_service_(nullptr) {}
 
 void RpcServer::Start() {
   CHECK_F(!server_, "RPC Server has already started!");
@@ -28,8 +36,12 @@ void RpcServer::Start() {
   grpc::ServerBuilder server_builder;
   grpc::EnableDefaultHealthCheckService(true);
 
+  uint64_t start_timestamp = utils::timestamp::GetTimestamp();
+
   // Create private key and certificate for server
   key_cert_pair_ = GenerateKeyCertPair();
+  DLOG_F(INFO, "Generated server key and certificate in %.3f ms.",
+         (utils::timestamp::GetTimestamp() - start_timestamp) / 1000.0);
 
   // Set the private key and certificate for the SSL server
   ssl_options.pem_key_cert_pairs.push_back(key_cert_pair_);
@@ -38,10 +50,35 @@ void RpcServer::Start() {
   server_builder.AddListeningPort(
       "localhost:0", grpc::SslServerCredentials(ssl_options), &port_);
 
+  // Listen on a unix domain socket without TLS for local clients, they are
+  // still authenticated with the token of the token server
+  if (IsLocalTransportSupported()) {
+    local_socket_path_ =
+        utils::token::GenerateLocalSocketPath(GetCurrentProcessId());
+  }
+
+  // The socket path has to fit the address including its null terminator,
+  // which is a lot shorter than MAX_PATH, so fall back to TCP if it doesn't
+  if (local_socket_path_.size() >= sizeof(sockaddr_un::sun_path)) {
+    LOG_F(WARNING,
+          "Local socket path '%s' is too long, disabling local transport.",
+          local_socket_path_.c_str());
+    local_socket_path_.clear();
+  }
+
+  if (!local_socket_path_.empty()) {
+    // Remove the socket file of a previous process with the same id
+    DeleteFileA(local_socket_path_.c_str());
+
+    server_builder.AddListeningPort("unix:" + local_socket_path_,
+                                    grpc::InsecureServerCredentials());
+  }
+
   // Register services
   server_builder.RegisterService(&auth_service_);
   server_builder.RegisterService(&events_service_);
   server_builder.RegisterService(&windows_service_);
+  server_builder.RegisterService(&tracing_service_);
 
   // Add token interceptor factory to interceptors
   interceptor_creators.push_back(
@@ -55,38 +92,69 @@ void RpcServer::Start() {
 
   // Start the server
   server_ = server_builder.BuildAndStart();
+  if (!server_) {
+    // The game keeps running without the overlay, clients won't get a token
+    // since the token server is never started
+    LOG_F(ERROR, "Unable to start RPC Server!");
+    local_socket_path_.clear();
+    return;
+  }
+
   events_service_.StartHandlingAsyncRpcs();
+  started_events_service_.store(&events_service_, std::memory_order_release);
   DLOG_F(INFO, "RPC Server is running and listening on port %d.", port_);
+  if (!local_socket_path_.empty()) {
+    DLOG_F(INFO, "RPC Server is listening on local socket '%s'.",
+           local_socket_path_.c_str());
+  }
 
-  token_server_.StartTokenGeneratorServer(port_, key_cert_pair_.cert_chain);
+  token_server_.StartTokenGeneratorServer(port_, key_cert_pair_.cert_chain,
+                                          local_socket_path_);
 }
 
 void RpcServer::RegisterClient(std::string client_id, DWORD process_id) {
   DLOG_F(INFO, "Registered client with id '%s' to process %d.",
          client_id.c_str(), process_id);
 
-  Client client;
-  std::lock_guard client_lk(clients_mutex_);
+  std::shared_ptr<Client> client = std::make_shared<Client>();
+  std::lock_guard clients_write_lk(clients_write_mutex_);
+
+  client->id = client_id;
+  client->process_id = process_id;
 
-  client.process_id = process_id;
+  // Copy the current clients and publish the new snapshot
+  std::shared_ptr<ClientsMap> clients =
+      std::make_shared<ClientsMap>(*std::atomic_load(&clients_));
+  (*clients)[client_id] = client;
 
-  clients_[client_id] = client;
+  std::atomic_store(&clients_, std::shared_ptr<const ClientsMap>(clients));
 }
 
-const Client *RpcServer::GetClient(std::string client_id) {
-  std::lock_guard client_lk(clients_mutex_);
+std::shared_ptr<const Client> RpcServer::GetClient(
+    const std::string &client_id) const {
+  std::shared_ptr<const ClientsMap> clients = std::atomic_load(&clients_);
 
-  try {
-    return &clients_.at(client_id);
-  } catch (...) {
+  auto client = clients->find(client_id);
+  if (client == clients->end()) {
     return nullptr;
   }
+
+  return client->second;
+}
+
+std::shared_ptr<const ClientsMap> RpcServer::GetAllClients() const {
+  return std::atomic_load(&clients_);
 }
 
-const std::unordered_map<std::string, Client> RpcServer::GetAllClients() {
-  std::lock_guard client_lk(clients_mutex_);
+std::string RpcServer::GetClientId(const grpc::ServerContextBase *context) {
+  auto session = context->client_metadata().find(SESSION_METADATA_KEY);
 
-  return clients_;
+  // Clients without a session have an empty id which is never registered
+  if (session == context->client_metadata().end()) {
+    return std::string();
+  }
+
+  return std::string(session->second.data(), session->second.size());
 }
 
 grpc::SslServerCredentialsOptions::PemKeyCertPair
@@ -94,23 +162,24 @@ RpcServer::GenerateKeyCertPair() const {
   grpc::SslServerCredentialsOptions::PemKeyCertPair key_cert_pair;
 
   EVP_PKEY *pkey = nullptr;
-  RSA *rsa = nullptr;
+  EVP_PKEY_CTX *pkey_ctx = nullptr;
   X509 *x509 = nullptr;
   X509_NAME *name = nullptr;
 
   BIO *key_bio = nullptr, *cert_bio = nullptr;
   BUF_MEM *buf = nullptr;
 
-  // Create private key object
-  pkey = EVP_PKEY_new();
-  CHECK_F(pkey != nullptr, "Unable to create private key object!");
+  // Create private key generation context
+  pkey_ctx = EVP_PKEY_CTX_new_id(EVP_PKEY_EC, NULL);
+  CHECK_F(pkey_ctx != nullptr,
+          "Unable to create private key generation context!");
 
-  // Generate RSA key
-  rsa = RSA_generate_key(4096, RSA_F4, NULL, NULL);
-  CHECK_F(rsa != nullptr, "Unable to generate RSA key!");
-
-  // Assign the RSA key to the private key
-  EVP_PKEY_assign_RSA(pkey, rsa);
+  // Generate EC P-256 key, which is a lot faster than generating an RSA key
+  CHECK_F(EVP_PKEY_keygen_init(pkey_ctx) > 0 &&
+              EVP_PKEY_CTX_set_ec_paramgen_curve_nid(
+                  pkey_ctx, NID_X9_62_prime256v1) > 0 &&
+              EVP_PKEY_keygen(pkey_ctx, &pkey) > 0,
+          "Unable to generate EC key!");
 
   // Create new x509 certificate object
   x509 = X509_new();
@@ -134,7 +203,7 @@ RpcServer::GenerateKeyCertPair() const {
   X509_set_issuer_name(x509, name);
 
   // Sign the certificate
-  X509_sign(x509, pkey, EVP_sha1());
+  X509_sign(x509, pkey, EVP_sha256());
 
   // Convert key to string
   key_bio = BIO_new(BIO_s_mem());
@@ -152,6 +221,7 @@ RpcServer::GenerateKeyCertPair() const {
   key_cert_pair.cert_chain = std::string(buf->data, buf->length);
 
   // Free objects
+  EVP_PKEY_CTX_free(pkey_ctx);
   EVP_PKEY_free(pkey);
   X509_free(x509);
   BIO_free(key_bio);
@@ -160,9 +230,34 @@ RpcServer::GenerateKeyCertPair() const {
   return key_cert_pair;
 }
 
+bool RpcServer::IsLocalTransportSupported() const {
+  WSADATA wsa_data;
+  SOCKET sock = INVALID_SOCKET;
+
+  if (WSAStartup(MAKEWORD(2, 2), &wsa_data) != 0) {
+    return false;
+  }
+
+  // Unix domain sockets are only supported since Windows 10 1803
+  sock = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (sock != INVALID_SOCKET) {
+    closesocket(sock);
+  }
+
+  WSACleanup();
+
+  return sock != INVALID_SOCKET;
+}
+
 TokenServer *RpcServer::get_token_server() { return &token_server_; }
 
-EventsServiceImpl *RpcServer::get_events_service() { return &events_service_; }
+EventsServiceImpl *RpcServer::get_events_service() {
+  return started_events_service_.load(std::memory_order_acquire);
+}
+
+WindowsServiceImpl *RpcServer::get_windows_service() {
+  return &windows_service_;
+}
 
 }  // namespace ipc
 }  // namespace core
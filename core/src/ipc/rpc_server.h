@@ -2,6 +2,7 @@
 #include <grpcpp/grpcpp.h>
 #include <stdint.h>
 
+#include <atomic>
 #include <memory>
 #include <mutex>
 #include <thread>
@@ -11,6 +12,7 @@
 #include "client.h"
 #include "events_service_impl.h"
 #include "token_server.h"
+#include "tracing_service_impl.h"
 #include "windows_service_impl.h"
 
 namespace overlay {
@@ -24,27 +26,37 @@ class RpcServer {
   void Start();
 
   void RegisterClient(std::string client_id, DWORD process_id);
-  const Client *GetClient(std::string client_id);
-  const std::unordered_map<std::string, Client> GetAllClients();
+  std::shared_ptr<const Client> GetClient(const std::string &client_id) const;
+  std::shared_ptr<const ClientsMap> GetAllClients() const;
+
+  static std::string GetClientId(const grpc::ServerContextBase *context);
 
   TokenServer *get_token_server();
+  // Null until the server has started, since the hooks are installed while
+  // it starts. Paths that only run for connected clients can skip the check
   EventsServiceImpl *get_events_service();
+  WindowsServiceImpl *get_windows_service();
 
  private:
   std::unique_ptr<grpc::Server> server_;
   int port_;
+  std::string local_socket_path_;
 
   grpc::SslServerCredentialsOptions::PemKeyCertPair key_cert_pair_;
 
-  std::unordered_map<std::string, Client> clients_;
-  std::mutex clients_mutex_;
+  // Readers load the current snapshot without locking, writers replace it
+  std::shared_ptr<const ClientsMap> clients_;
+  std::mutex clients_write_mutex_;
 
   TokenServer token_server_;
   EventsServiceImpl events_service_;
+  std::atomic<EventsServiceImpl *> started_events_service_;
   AuthServiceImpl auth_service_;
   WindowsServiceImpl windows_service_;
+  TracingServiceImpl tracing_service_;
 
   grpc::SslServerCredentialsOptions::PemKeyCertPair GenerateKeyCertPair() const;
+  bool IsLocalTransportSupported() const;
 };
 
 }  // namespace ipc
@@ -6,6 +6,8 @@
 #include <loguru/loguru.hpp>
 
 #include "core.h"
+#include "utils/token.h"
+#include "utils/trace_recorder.h"
 
 namespace overlay {
 namespace core {
@@ -33,8 +35,10 @@ void TokenInterceptor::Intercept(
           grpc::experimental::InterceptionHookPoints::
               POST_RECV_INITIAL_METADATA) &&
       !authenticate_rpc_) {
+    TRACE_INSTANT("rpc", "ReceivedCall");
+
     // If the client isn't authenticated
-    if (Core::Get()->get_rpc_server()->GetClient(context_->peer()) == nullptr) {
+    if (!IsAuthenticated()) {
       context_->TryCancel();
       return;
     }
@@ -43,6 +47,28 @@ void TokenInterceptor::Intercept(
   methods->Proceed();
 }
 
+bool TokenInterceptor::IsAuthenticated() const {
+  // Clients send many calls in a row which are handled by the same threads,
+  // so the last authenticated client of each thread is cached
+  static thread_local std::weak_ptr<const Client> cached_client;
+
+  auto session = context_->client_metadata().find(SESSION_METADATA_KEY);
+  if (session == context_->client_metadata().end()) {
+    return false;
+  }
+
+  std::shared_ptr<const Client> client = cached_client.lock();
+  if (client && session->second == client->id) {
+    return true;
+  }
+
+  client = Core::Get()->get_rpc_server()->GetClient(
+      std::string(session->second.data(), session->second.size()));
+  cached_client = client;
+
+  return client != nullptr;
+}
+
 }  // namespace ipc
 }  // namespace core
 }  // namespace overlay
\ No newline at end of file
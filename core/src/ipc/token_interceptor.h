@@ -15,6 +15,8 @@ class TokenInterceptor : public grpc::experimental::Interceptor {
   void Intercept(grpc::experimental::InterceptorBatchMethods* methods);
 
  private:
+  bool IsAuthenticated() const;
+
   grpc::ServerContextBase* context_;
   bool authenticate_rpc_;
 };
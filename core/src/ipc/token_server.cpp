@@ -1,10 +1,8 @@
 #include "token_server.h"
 
-#include <algorithm>
 #include <loguru/loguru.hpp>
-#include <sstream>
 
-#include "authenticate_response.h"
+#include "pipe_token_transport.h"
 #include "utils/guid.h"
 #include "utils/token.h"
 
@@ -12,82 +10,59 @@ namespace overlay {
 namespace core {
 namespace ipc {
 
-TokenServer::TokenServer() : pipe_(INVALID_HANDLE_VALUE) {}
+TokenServer::TokenServer()
+    : TokenServer(std::make_unique<PipeTokenTransport>(
+          utils::token::GeneratePipeName(GetCurrentProcessId()))) {}
+
+TokenServer::TokenServer(std::unique_ptr<TokenTransport> transport)
+    : transport_(std::move(transport)), response_() {}
 
 void TokenServer::StartTokenGeneratorServer(uint16_t rpc_server_port,
-                                            std::string server_certificate) {
-  std::string pipe_name = utils::token::GeneratePipeName(GetCurrentProcessId());
-
-  // Create named pipe for outbound communication
-  pipe_ = CreateNamedPipeA(pipe_name.c_str(), PIPE_ACCESS_OUTBOUND,
-                           PIPE_TYPE_MESSAGE | PIPE_READMODE_MESSAGE |
-                               PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
-                           1, sizeof(AuthenticateResponse), 0, 0, NULL);
-  CHECK_F(pipe_ != INVALID_HANDLE_VALUE,
-          "Unable to create pipe for token generator server! (Error: 0x%x)",
-          GetLastError());
-
-  DLOG_F(INFO,
-         "Started token generator server with pipe name '%s'. (HANDLE: 0x%x)",
-         pipe_name.c_str(), pipe_);
-
-  // Start pipe main thread
-  main_thread_ = std::thread(&TokenServer::PipeMainThread, this,
-                             rpc_server_port, server_certificate);
+                                            std::string server_certificate,
+                                            std::string local_socket_path) {
+  // Fill the parts of the response which are the same for all clients
+  response_.rpc_server_port = rpc_server_port;
+  std::memcpy(response_.server_certificate, server_certificate.data(),
+              server_certificate.size() + 1);
+  std::memcpy(response_.local_socket_path, local_socket_path.data(),
+              local_socket_path.size() + 1);
+
+  CHECK_F(transport_->Start(std::bind(&TokenServer::HandleTokenRequest, this,
+                                      std::placeholders::_1,
+                                      std::placeholders::_2)),
+          "Unable to start token generator server!");
+
+  DLOG_F(INFO, "Started token generator server.");
 }
 
 DWORD TokenServer::GetTokenProcessId(GUID token) {
   std::lock_guard tokens_lk(tokens_mutex_);
 
-  if (!tokens_.count(token)) {
+  // The token is gone if it has expired
+  RemoveExpiredTokens();
+
+  auto token_info = tokens_.find(token);
+  if (token_info == tokens_.end()) {
     return 0;
   }
 
-  return tokens_[token];
+  return token_info->second.process_id;
 }
 
 void TokenServer::InvalidateProcessToken(GUID token) {
   std::lock_guard tokens_lk(tokens_mutex_);
 
-  tokens_.erase(token);
+  RemoveToken(token);
 }
 
-void TokenServer::PipeMainThread(uint16_t rpc_server_port,
-                                 std::string server_certificate) {
-  AuthenticateResponse response = {0};
-  DWORD written_bytes = 0;
-
-  DWORD process_id;
+bool TokenServer::HandleTokenRequest(DWORD process_id,
+                                     AuthenticateResponse &response) {
+  // TODO: Add verification for processes
 
-  std::unique_lock tokens_lk(tokens_mutex_, std::defer_lock);
+  response = response_;
+  response.token = GenerateTokenForProcess(process_id);
 
-#ifdef DEBUG
-  loguru::set_thread_name("token server");
-#endif
-
-  response.rpc_server_port = rpc_server_port;
-  std::memcpy(response.server_certificate, server_certificate.data(),
-              server_certificate.size() + 1);
-
-  // TODO: Handle stopping threads
-  while (true) {
-    // If a client is connected
-    if (ConnectNamedPipe(pipe_, NULL) ||
-        GetLastError() == ERROR_PIPE_CONNECTED) {
-      // Get client's process id
-      if (GetNamedPipeClientProcessId(pipe_, &process_id)) {
-        // TODO: Add verification for processes
-
-        // Generate token for the process
-        response.token = GenerateTokenForProcess(process_id);
-
-        // Send the response to the client
-        WriteFile(pipe_, &response, sizeof(response), &written_bytes, NULL);
-      }
-    }
-
-    DisconnectNamedPipe(pipe_);
-  }
+  return true;
 }
 
 GUID TokenServer::GenerateTokenForProcess(DWORD pid) {
@@ -95,18 +70,22 @@ GUID TokenServer::GenerateTokenForProcess(DWORD pid) {
 
   std::lock_guard tokens_lk(tokens_mutex_);
 
-  // Check if a token already exists for the process
-  for (auto it = tokens_.begin(); it != tokens_.end(); it++) {
-    if (it->second == pid) {
-      return it->first;
-    }
+  // Remove the tokens of the processes that never used them
+  RemoveExpiredTokens();
+
+  // Check if a valid token already exists for the process
+  auto process_token = process_tokens_.find(pid);
+  if (process_token != process_tokens_.end()) {
+    return process_token->second;
   }
 
   // Generate random guid
   token = utils::Guid::GenerateGuid();
 
   // Save token
-  tokens_[token] = pid;
+  tokens_[token] = {pid, std::chrono::steady_clock::now() +
+                             std::chrono::seconds(TOKEN_EXPIRY_SECONDS)};
+  process_tokens_[pid] = token;
 
   DLOG_F(INFO, "Generated token '%s' for process %d.",
          utils::Guid::GuidToString(&token).c_str(), pid);
@@ -114,6 +93,28 @@ GUID TokenServer::GenerateTokenForProcess(DWORD pid) {
   return token;
 }
 
+void TokenServer::RemoveToken(GUID token) {
+  auto token_info = tokens_.find(token);
+
+  if (token_info != tokens_.end()) {
+    process_tokens_.erase(token_info->second.process_id);
+    tokens_.erase(token_info);
+  }
+}
+
+void TokenServer::RemoveExpiredTokens() {
+  std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+  for (auto token_info = tokens_.begin(); token_info != tokens_.end();) {
+    if (token_info->second.expiry < now) {
+      process_tokens_.erase(token_info->second.process_id);
+      token_info = tokens_.erase(token_info);
+    } else {
+      token_info++;
+    }
+  }
+}
+
 }  // namespace ipc
 }  // namespace core
-}  // namespace overlay
\ No newline at end of file
+}  // namespace overlay
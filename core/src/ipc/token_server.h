@@ -1,13 +1,18 @@
 #pragma once
 #include <windows.h>
 
+#include <chrono>
+#include <memory>
 #include <mutex>
 #include <string>
-#include <thread>
 #include <unordered_map>
 
+#include "authenticate_response.h"
+#include "token_transport.h"
 #include "utils/guid.h"
 
+#define TOKEN_EXPIRY_SECONDS 30
+
 namespace overlay {
 namespace core {
 namespace ipc {
@@ -15,25 +20,35 @@ namespace ipc {
 class TokenServer {
  public:
   TokenServer();
+  TokenServer(std::unique_ptr<TokenTransport> transport);
 
   void StartTokenGeneratorServer(uint16_t rpc_server_port,
-                                 std::string server_certificate);
+                                 std::string server_certificate,
+                                 std::string local_socket_path);
 
   DWORD GetTokenProcessId(GUID token);
   void InvalidateProcessToken(GUID token);
 
  private:
-  HANDLE pipe_;
-  std::thread main_thread_;
+  struct TokenInfo {
+    DWORD process_id;
+    std::chrono::steady_clock::time_point expiry;
+  };
+
+  std::unique_ptr<TokenTransport> transport_;
+  AuthenticateResponse response_;
 
-  std::unordered_map<GUID, DWORD> tokens_;
+  std::unordered_map<GUID, TokenInfo> tokens_;
+  std::unordered_map<DWORD, GUID> process_tokens_;
   std::mutex tokens_mutex_;
 
-  void PipeMainThread(uint16_t rpc_server_port, std::string server_certificate);
+  bool HandleTokenRequest(DWORD process_id, AuthenticateResponse &response);
 
   GUID GenerateTokenForProcess(DWORD pid);
+  void RemoveToken(GUID token);
+  void RemoveExpiredTokens();
 };
 
 }  // namespace ipc
 }  // namespace core
-}  // namespace overlay
\ No newline at end of file
+}  // namespace overlay
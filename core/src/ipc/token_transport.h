@@ -0,0 +1,26 @@
+#pragma once
+#include <windows.h>
+
+#include <functional>
+
+#include "authenticate_response.h"
+
+namespace overlay {
+namespace core {
+namespace ipc {
+
+// Fills the authenticate response for a client process, returns false if the
+// client should be disconnected without a response
+typedef std::function<bool(DWORD process_id, AuthenticateResponse &response)>
+    TokenRequestHandler;
+
+class TokenTransport {
+ public:
+  virtual ~TokenTransport() {}
+
+  virtual bool Start(TokenRequestHandler handler) = 0;
+};
+
+}  // namespace ipc
+}  // namespace core
+}  // namespace overlay
@@ -0,0 +1,152 @@
+#include "tracing_service_impl.h"
+
+#include "core.h"
+#include "input/input_recorder.h"
+#include "utils/trace_recorder.h"
+
+namespace overlay {
+namespace core {
+namespace ipc {
+
+grpc::Status TracingServiceImpl::StartTracing(
+    grpc::ServerContext *context, const StartTracingRequest *request,
+    StartTracingResponse *response) {
+  // If a trace is already being recorded
+  if (!utils::TraceRecorder::Get()->Start()) {
+    return grpc::Status::CANCELLED;
+  }
+
+  return grpc::Status::OK;
+}
+
+grpc::Status TracingServiceImpl::StopTracing(
+    grpc::ServerContext *context, const StopTracingRequest *request,
+    grpc::ServerWriter<StopTracingResponse> *writer) {
+  std::string trace;
+  uint64_t events = 0, dropped_events = 0;
+  size_t offset = 0;
+  StopTracingResponse response;
+
+  // Stop the trace, it's sent back to the client instead of being saved here
+  if (!utils::TraceRecorder::Get()->Stop(trace, events, dropped_events)) {
+    return grpc::Status::CANCELLED;
+  }
+
+  // Send the trace in chunks, the last chunk has the event counts
+  do {
+    response.set_trace(trace.substr(offset, TRACING_CHUNK_SIZE));
+    offset += TRACING_CHUNK_SIZE;
+
+    if (offset >= trace.size()) {
+      response.set_events(events);
+      response.set_droppedevents(dropped_events);
+    }
+
+    if (!writer->Write(response)) {
+      return grpc::Status::CANCELLED;
+    }
+  } while (offset < trace.size());
+
+  return grpc::Status::OK;
+}
+
+grpc::Status TracingServiceImpl::StartInputRecording(
+    grpc::ServerContext *context, const StartInputRecordingRequest *request,
+    StartInputRecordingResponse *response) {
+  // If the input is already being recorded
+  if (!Core::Get()
+           ->get_graphics_manager()
+           ->get_window_manager()
+           ->StartInputRecording()) {
+    return grpc::Status::CANCELLED;
+  }
+
+  return grpc::Status::OK;
+}
+
+grpc::Status TracingServiceImpl::StopInputRecording(
+    grpc::ServerContext *context, const StopInputRecordingRequest *request,
+    grpc::ServerWriter<StopInputRecordingResponse> *writer) {
+  std::string recording;
+  uint64_t records = 0, dropped_records = 0;
+  size_t offset = 0;
+  StopInputRecordingResponse response;
+
+  // Stop the recording, it's sent back to the client instead of being saved
+  if (!input::InputRecorder::Get()->Stop(recording, records,
+                                         dropped_records)) {
+    return grpc::Status::CANCELLED;
+  }
+
+  // Send the recording in chunks, the last chunk has the record counts
+  do {
+    response.set_recording(recording.substr(offset, TRACING_CHUNK_SIZE));
+    offset += TRACING_CHUNK_SIZE;
+
+    if (offset >= recording.size()) {
+      response.set_records(records);
+      response.set_droppedrecords(dropped_records);
+    }
+
+    if (!writer->Write(response)) {
+      return grpc::Status::CANCELLED;
+    }
+  } while (offset < recording.size());
+
+  return grpc::Status::OK;
+}
+
+grpc::Status TracingServiceImpl::CaptureOverlay(
+    grpc::ServerContext *context, const CaptureOverlayRequest *request,
+    grpc::ServerWriter<CaptureOverlayResponse> *writer) {
+  graphics::GraphicsManager *graphics_manager =
+      Core::Get()->get_graphics_manager();
+  uint32_t width = request->width(), height = request->height();
+  size_t offset = 0;
+  std::string buffer;
+  CaptureOverlayResponse response;
+
+  // Capture in the game's resolution by default
+  if (width == 0 || height == 0) {
+    std::unique_ptr<graphics::IGraphicsRenderer> &renderer =
+        graphics_manager->get_renderer();
+
+    if (renderer == nullptr) {
+      return grpc::Status::CANCELLED;
+    }
+
+    width = (uint32_t)renderer->get_width();
+    height = (uint32_t)renderer->get_height();
+  }
+
+  if (width == 0 || height == 0 || width > MAX_CAPTURE_DIMENSION ||
+      height > MAX_CAPTURE_DIMENSION) {
+    return grpc::Status::CANCELLED;
+  }
+
+  // Composite the windows over a transparent buffer on the CPU, the renderer
+  // keeps its pending buffers
+  buffer.assign((size_t)width * height * sizeof(uint32_t), 0);
+  if (!graphics_manager->get_window_manager()->CompositeWindows(width, height,
+                                                                buffer)) {
+    return grpc::Status::CANCELLED;
+  }
+
+  // Send the buffer in chunks
+  response.set_width(width);
+  response.set_height(height);
+  do {
+    response.set_buffer(buffer.substr(offset, TRACING_CHUNK_SIZE));
+    offset += TRACING_CHUNK_SIZE;
+
+    if (!writer->Write(response)) {
+      return grpc::Status::CANCELLED;
+    }
+  } while (offset < buffer.size());
+
+  return grpc::Status::OK;
+}
+
+}  // namespace ipc
+}  // namespace core
+}  // namespace overlay
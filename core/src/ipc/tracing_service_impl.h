@@ -0,0 +1,32 @@
+#pragma once
+#include "tracing.grpc.pb.h"
+
+#define TRACING_CHUNK_SIZE (1024 * 1024)  // Below the gRPC message size limit
+#define MAX_CAPTURE_DIMENSION 16384
+
+namespace overlay {
+namespace core {
+namespace ipc {
+
+class TracingServiceImpl final : public Tracing::Service {
+ public:
+  grpc::Status StartTracing(grpc::ServerContext *context,
+                            const StartTracingRequest *request,
+                            StartTracingResponse *response);
+  grpc::Status StopTracing(grpc::ServerContext *context,
+                           const StopTracingRequest *request,
+                           grpc::ServerWriter<StopTracingResponse> *writer);
+  grpc::Status StartInputRecording(grpc::ServerContext *context,
+                                   const StartInputRecordingRequest *request,
+                                   StartInputRecordingResponse *response);
+  grpc::Status StopInputRecording(
+      grpc::ServerContext *context, const StopInputRecordingRequest *request,
+      grpc::ServerWriter<StopInputRecordingResponse> *writer);
+  grpc::Status CaptureOverlay(
+      grpc::ServerContext *context, const CaptureOverlayRequest *request,
+      grpc::ServerWriter<CaptureOverlayResponse> *writer);
+};
+
+}  // namespace ipc
+}  // namespace core
+}  // namespace overlay
@@ -2,6 +2,16 @@
 
 #include "core.h"
 #include "cursors.h"
+#include "utils/buffer_codec.h"
+#include "utils/trace_recorder.h"
+
+static_assert(overlay::BUFFER_ENCODING_XOR_DELTA ==
+                      overlay::utils::kBufferEncodingXorDelta &&
+                  overlay::BUFFER_ENCODING_TRANSPARENT_RLE ==
+                      overlay::utils::kBufferEncodingTransparentRle &&
+                  overlay::BUFFER_ENCODING_LZ4 ==
+                      overlay::utils::kBufferEncodingLz4,
+              "Buffer encoding flags mismatch");
 
 namespace overlay {
 namespace core {
@@ -31,7 +41,8 @@ grpc::Status WindowsServiceImpl::CreateWindowGroup(
   window_group_id = Core::Get()
                         ->get_graphics_manager()
                         ->get_window_manager()
-                        ->CreateWindowGroup(context->peer(), attributes);
+                        ->CreateWindowGroup(RpcServer::GetClientId(context),
+                                            attributes);
 
   // Set the window group id
   response->set_id((const char *)&window_group_id, sizeof(window_group_id));
@@ -43,7 +54,7 @@ grpc::Status WindowsServiceImpl::UpdateWindowGroupProperties(
     grpc::ServerContext *context,
     const UpdateWindowGroupPropertiesRequest *request,
     UpdateWindowGroupPropertiesResponse *response) {
-  graphics::WindowGroupUniqueId id(GUID_NULL, context->peer());
+  graphics::WindowGroupUniqueId id(GUID_NULL, RpcServer::GetClientId(context));
 
   graphics::WindowGroupAttributes attributes;
 
@@ -81,7 +92,8 @@ grpc::Status WindowsServiceImpl::CreateWindowInGroup(
     grpc::ServerContext *context, const CreateWindowRequest *request,
     CreateWindowResponse *response) {
   GUID window_id = GUID_NULL;
-  graphics::WindowGroupUniqueId group_id(GUID_NULL, context->peer());
+  graphics::WindowGroupUniqueId group_id(GUID_NULL,
+                                         RpcServer::GetClientId(context));
 
   graphics::Rect rect;
   graphics::WindowAttributes attributes;
@@ -123,7 +135,8 @@ grpc::Status WindowsServiceImpl::CreateWindowInGroup(
 grpc::Status WindowsServiceImpl::UpdateWindowProperties(
     grpc::ServerContext *context, const UpdateWindowPropertiesRequest *request,
     UpdateWindowPropertiesResponse *response) {
-  graphics::WindowUniqueId id(GUID_NULL, GUID_NULL, context->peer());
+  graphics::WindowUniqueId id(GUID_NULL, GUID_NULL,
+                              RpcServer::GetClientId(context));
 
   graphics::WindowAttributes attributes;
 
@@ -161,7 +174,8 @@ grpc::Status WindowsServiceImpl::UpdateWindowProperties(
 grpc::Status WindowsServiceImpl::SetWindowRect(
     grpc::ServerContext *context, const SetWindowRectRequest *request,
     SetWindowRectResponse *response) {
-  graphics::WindowUniqueId id(GUID_NULL, GUID_NULL, context->peer());
+  graphics::WindowUniqueId id(GUID_NULL, GUID_NULL,
+                              RpcServer::GetClientId(context));
 
   graphics::Rect rect;
 
@@ -194,7 +208,8 @@ grpc::Status WindowsServiceImpl::SetWindowRect(
 grpc::Status WindowsServiceImpl::SetWindowCursor(
     grpc::ServerContext *context, const SetWindowCursorRequest *request,
     SetWindowCursorResponse *response) {
-  graphics::WindowUniqueId id(GUID_NULL, GUID_NULL, context->peer());
+  graphics::WindowUniqueId id(GUID_NULL, GUID_NULL,
+                              RpcServer::GetClientId(context));
 
   HINSTANCE instance = Core::Get()->get_instance();
   HCURSOR cursor = NULL;
@@ -367,12 +382,13 @@ grpc::Status WindowsServiceImpl::SetWindowCursor(
   return grpc::Status::OK;
 }
 
-grpc::Status WindowsServiceImpl::BufferForWindow(
-    grpc::ServerContext *context, const BufferForWindowRequest *request,
-    BufferForWindowResponse *response) {
-  graphics::WindowUniqueId id(GUID_NULL, GUID_NULL, context->peer());
+grpc::Status WindowsServiceImpl::SetWindowInputMask(
+    grpc::ServerContext *context, const SetWindowInputMaskRequest *request,
+    SetWindowInputMaskResponse *response) {
+  graphics::WindowUniqueId id(GUID_NULL, GUID_NULL,
+                              RpcServer::GetClientId(context));
 
-  std::shared_ptr<graphics::Window> window;
+  std::vector<graphics::Rect> rects;
 
   // Verify the size of the group id
   if (request->group_id().size() != sizeof(id.group_id)) {
@@ -386,16 +402,230 @@ grpc::Status WindowsServiceImpl::BufferForWindow(
   }
   memcpy(&id.window_id, request->window_id().data(), sizeof(id.window_id));
 
-  // Set the buffer for the window
-  Core::Get()
-      ->get_graphics_manager()
-      ->get_window_manager()
-      ->UpdateWindowBufferInGroup(id,
-                                  std::move((std::string &)request->buffer()));
+  // Verify the alpha threshold
+  if (request->alpha_threshold() > UINT8_MAX) {
+    return grpc::Status::CANCELLED;
+  }
+
+  for (auto &request_rect : request->rects()) {
+    graphics::Rect &rect = rects.emplace_back();
+
+    rect.height = (uint32_t)request_rect.height();
+    rect.width = (uint32_t)request_rect.width();
+    rect.x = (int32_t)request_rect.x();
+    rect.y = (int32_t)request_rect.y();
+  }
+
+  // Update the input mask
+  if (!Core::Get()
+           ->get_graphics_manager()
+           ->get_window_manager()
+           ->SetWindowInputMask(id, std::move(rects),
+                                (uint8_t)request->alpha_threshold())) {
+    return grpc::Status::CANCELLED;
+  }
 
   return grpc::Status::OK;
 }
 
+grpc::Status WindowsServiceImpl::BufferForWindow(
+    grpc::ServerContext *context, const BufferForWindowRequest *request,
+    BufferForWindowResponse *response) {
+  graphics::BufferStats buffer_stats = {0};
+
+  // Set the buffer for the window, the buffer of a destroyed window is
+  // ignored
+  switch (UpdateWindowBuffer(context, (BufferForWindowRequest &)*request,
+                             buffer_stats)) {
+    case graphics::BufferUpdateResult::Updated:
+    case graphics::BufferUpdateResult::UnknownWindow:
+      return grpc::Status::OK;
+
+    default:
+      return grpc::Status::CANCELLED;
+  }
+}
+
+grpc::Status WindowsServiceImpl::StreamBuffersForWindows(
+    grpc::ServerContext *context,
+    grpc::ServerReaderWriter<BufferForWindowAck, BufferForWindowRequest>
+        *stream) {
+  BufferForWindowRequest request;
+  BufferForWindowAck ack;
+  graphics::BufferStats buffer_stats;
+  graphics::BufferUpdateResult result;
+
+  // Handle buffers until the client closes the stream
+  while (stream->Read(&request)) {
+    ack.set_sequence(request.sequence());
+    ack.set_window_id(request.window_id());
+    ack.set_present_timestamp(
+        Core::Get()->get_graphics_manager()->get_last_present_timestamp());
+    buffer_stats = {0};
+    result = UpdateWindowBuffer(context, request, buffer_stats);
+    ack.set_accepted(result == graphics::BufferUpdateResult::Updated ||
+                     result == graphics::BufferUpdateResult::UnknownWindow);
+    ack.set_base_mismatch(result ==
+                          graphics::BufferUpdateResult::BaseMismatch);
+    ack.set_received_buffers(buffer_stats.received_buffers);
+    ack.set_presented_buffers(buffer_stats.presented_buffers);
+    ack.set_dropped_buffers(buffer_stats.dropped_buffers);
+    ack.set_latency(buffer_stats.latency);
+    ack.set_latency_max(buffer_stats.latency_max);
+
+    // Acknowledge the buffer
+    if (!stream->Write(ack)) {
+      break;
+    }
+  }
+
+  return grpc::Status::OK;
+}
+
+grpc::Status WindowsServiceImpl::SetUploadBudget(
+    grpc::ServerContext *context, const SetUploadBudgetRequest *request,
+    SetUploadBudgetResponse *response) {
+  if (!ClaimSettings(RpcServer::GetClientId(context))) {
+    return grpc::Status(grpc::StatusCode::PERMISSION_DENIED,
+                        "The settings are owned by another client");
+  }
+
+  Core::Get()->get_graphics_manager()->set_upload_budget(request->budget());
+
+  return grpc::Status::OK;
+}
+
+grpc::Status WindowsServiceImpl::SetInputCoalesceInterval(
+    grpc::ServerContext *context,
+    const SetInputCoalesceIntervalRequest *request,
+    SetInputCoalesceIntervalResponse *response) {
+  if (!ClaimSettings(RpcServer::GetClientId(context))) {
+    return grpc::Status(grpc::StatusCode::PERMISSION_DENIED,
+                        "The settings are owned by another client");
+  }
+
+  Core::Get()->get_input_manager()->set_input_coalesce_interval(
+      request->interval());
+
+  return grpc::Status::OK;
+}
+
+grpc::Status WindowsServiceImpl::RegisterHotkey(
+    grpc::ServerContext *context, const RegisterHotkeyRequest *request,
+    RegisterHotkeyResponse *response) {
+  // Verify the virtual key
+  if (request->virtual_key() > UINT8_MAX) {
+    return grpc::Status::CANCELLED;
+  }
+
+  if (!Core::Get()->get_input_manager()->RegisterHotkey(
+          RpcServer::GetClientId(context), request->id(),
+          (uint8_t)request->virtual_key(), request->modifiers(),
+          request->block())) {
+    return grpc::Status::CANCELLED;
+  }
+
+  return grpc::Status::OK;
+}
+
+grpc::Status WindowsServiceImpl::UnregisterHotkey(
+    grpc::ServerContext *context, const UnregisterHotkeyRequest *request,
+    UnregisterHotkeyResponse *response) {
+  if (!Core::Get()->get_input_manager()->UnregisterHotkey(
+          RpcServer::GetClientId(context), request->id())) {
+    return grpc::Status::CANCELLED;
+  }
+
+  return grpc::Status::OK;
+}
+
+void WindowsServiceImpl::ReleaseClientSettings(const std::string &client_id) {
+  std::lock_guard settings_lk(settings_mutex_);
+
+  if (settings_client_id_ != client_id) {
+    return;
+  }
+
+  settings_client_id_.clear();
+  Core::Get()->get_graphics_manager()->set_upload_budget(
+      DEFAULT_UPLOAD_BUDGET);
+  Core::Get()->get_input_manager()->set_input_coalesce_interval(
+      DEFAULT_INPUT_COALESCE_INTERVAL);
+}
+
+bool WindowsServiceImpl::ClaimSettings(const std::string &client_id) {
+  std::lock_guard settings_lk(settings_mutex_);
+
+  if (settings_client_id_.empty()) {
+    settings_client_id_ = client_id;
+  }
+
+  return settings_client_id_ == client_id;
+}
+
+graphics::BufferUpdateResult WindowsServiceImpl::UpdateWindowBuffer(
+    grpc::ServerContext *context, BufferForWindowRequest &request,
+    graphics::BufferStats &buffer_stats) {
+  TRACE_SCOPE("rpc", "UpdateWindowBuffer");
+  graphics::WindowUniqueId id(GUID_NULL, GUID_NULL,
+                              RpcServer::GetClientId(context));
+
+  std::string buffer;
+  uint32_t width = request.width(), height = request.height();
+
+  // Verify the size of the group id
+  if (request.group_id().size() != sizeof(id.group_id)) {
+    return graphics::BufferUpdateResult::InvalidBuffer;
+  }
+  memcpy(&id.group_id, request.group_id().data(), sizeof(id.group_id));
+
+  // Verify the size of the window id
+  if (request.window_id().size() != sizeof(id.window_id)) {
+    return graphics::BufferUpdateResult::InvalidBuffer;
+  }
+  memcpy(&id.window_id, request.window_id().data(), sizeof(id.window_id));
+
+  if (!Core::Get()
+           ->get_graphics_manager()
+           ->get_window_manager()
+           ->GetWindowBufferResolution(id, width, height)) {
+    return graphics::BufferUpdateResult::UnknownWindow;
+  }
+  uint64_t buffer_size = (uint64_t)width * height * sizeof(uint32_t);
+
+  // Decode the buffer if needed, the XOR delta is applied by the window
+  // manager since it needs the window's previous buffer
+  if ((request.encoding() & ~utils::kBufferEncodingXorDelta) ==
+      utils::kBufferEncodingRaw) {
+    // Raw buffers are already in their final size, older clients don't send
+    // the raw size for them
+    if ((uint64_t)request.buffer().size() != buffer_size) {
+      return graphics::BufferUpdateResult::InvalidBuffer;
+    }
+
+    buffer = std::move(*request.mutable_buffer());
+  } else {
+    // Verify the raw size before decoding, so the decoders never allocate
+    // more than the window's buffer
+    if (request.raw_size() != buffer_size) {
+      return graphics::BufferUpdateResult::InvalidBuffer;
+    }
+
+    if (!utils::BufferCodec::Decode(request.encoding(), request.buffer(),
+                                    request.raw_size(), buffer)) {
+      return graphics::BufferUpdateResult::InvalidBuffer;
+    }
+  }
+
+  return Core::Get()
+      ->get_graphics_manager()
+      ->get_window_manager()
+      ->UpdateWindowBufferInGroup(
+          id, std::move(buffer), width, height, request.generation(),
+          request.encoding() & utils::kBufferEncodingXorDelta,
+          request.base_generation(), buffer_stats);
+}
+
 }  // namespace ipc
 }  // namespace core
 }  // namespace overlay
\ No newline at end of file
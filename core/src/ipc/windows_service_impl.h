@@ -1,4 +1,9 @@
 #pragma once
+#include <mutex>
+#include <string>
+
+#include "graphics/sprite.h"
+#include "graphics/window_manager.h"
 #include "windows.grpc.pb.h"
 
 namespace overlay {
@@ -27,9 +32,45 @@ class WindowsServiceImpl final : public Windows::Service {
   grpc::Status SetWindowCursor(grpc::ServerContext *context,
                                const SetWindowCursorRequest *request,
                                SetWindowCursorResponse *response);
+  grpc::Status SetWindowInputMask(grpc::ServerContext *context,
+                                  const SetWindowInputMaskRequest *request,
+                                  SetWindowInputMaskResponse *response);
   grpc::Status BufferForWindow(grpc::ServerContext *context,
                                const BufferForWindowRequest *request,
                                BufferForWindowResponse *response);
+  grpc::Status StreamBuffersForWindows(
+      grpc::ServerContext *context,
+      grpc::ServerReaderWriter<BufferForWindowAck, BufferForWindowRequest>
+          *stream);
+  grpc::Status SetUploadBudget(grpc::ServerContext *context,
+                               const SetUploadBudgetRequest *request,
+                               SetUploadBudgetResponse *response);
+  grpc::Status SetInputCoalesceInterval(
+      grpc::ServerContext *context,
+      const SetInputCoalesceIntervalRequest *request,
+      SetInputCoalesceIntervalResponse *response);
+  grpc::Status RegisterHotkey(grpc::ServerContext *context,
+                              const RegisterHotkeyRequest *request,
+                              RegisterHotkeyResponse *response);
+  grpc::Status UnregisterHotkey(grpc::ServerContext *context,
+                                const UnregisterHotkeyRequest *request,
+                                UnregisterHotkeyResponse *response);
+
+  // Resets the settings the client owns to their defaults
+  void ReleaseClientSettings(const std::string &client_id);
+
+ private:
+  // The upload budget and the input coalescing are shared by all of the
+  // clients, so the first client that changes them owns them until its window
+  // events end
+  std::string settings_client_id_;
+  std::mutex settings_mutex_;
+
+  bool ClaimSettings(const std::string &client_id);
+
+  graphics::BufferUpdateResult UpdateWindowBuffer(
+      grpc::ServerContext *context, BufferForWindowRequest &request,
+      graphics::BufferStats &buffer_stats);
 };
 
 }  // namespace ipc
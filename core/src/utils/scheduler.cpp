@@ -0,0 +1,86 @@
+#include "utils/scheduler.h"
+
+#include <windows.h>
+
+#include <loguru/loguru.hpp>
+#include <vector>
+
+namespace overlay {
+namespace utils {
+
+Scheduler::Scheduler() : next_task_id_(1) {}
+
+ScheduledTaskId Scheduler::SchedulePeriodicTask(
+    std::chrono::milliseconds interval, std::function<void()> task) {
+  std::lock_guard tasks_lk(tasks_mutex_);
+  ScheduledTaskId task_id = next_task_id_++;
+
+  tasks_[task_id] = {interval, std::chrono::steady_clock::now() + interval,
+                     task};
+
+  // Start the scheduler thread on the first task
+  if (!scheduler_thread_.joinable()) {
+    scheduler_thread_ = std::thread(&Scheduler::SchedulerThread, this);
+  }
+
+  tasks_cv_.notify_one();
+
+  return task_id;
+}
+
+void Scheduler::CancelTask(ScheduledTaskId task_id) {
+  std::lock_guard tasks_lk(tasks_mutex_);
+
+  tasks_.erase(task_id);
+  tasks_cv_.notify_one();
+}
+
+void Scheduler::SchedulerThread() {
+  std::vector<std::function<void()>> due_tasks;
+
+#ifdef DEBUG
+  loguru::set_thread_name("scheduler");
+#endif
+
+  // The tasks shouldn't compete with the application's threads
+  SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_BELOW_NORMAL);
+
+  // TODO: Handle stopping threads
+  while (true) {
+    std::unique_lock tasks_lk(tasks_mutex_);
+
+    // Sleep until there are tasks
+    tasks_cv_.wait(tasks_lk, [this]() { return !tasks_.empty(); });
+
+    // Find the closest task
+    auto next_run = std::chrono::steady_clock::time_point::max();
+    for (auto &task : tasks_) {
+      next_run = std::min(next_run, task.second.next_run);
+    }
+
+    // Wait for it, unless the tasks have changed
+    if (tasks_cv_.wait_until(tasks_lk, next_run) ==
+        std::cv_status::no_timeout) {
+      continue;
+    }
+
+    // Collect the due tasks and schedule their next run
+    auto now = std::chrono::steady_clock::now();
+    for (auto &task : tasks_) {
+      if (task.second.next_run <= now) {
+        due_tasks.push_back(task.second.task);
+        task.second.next_run = now + task.second.interval;
+      }
+    }
+    tasks_lk.unlock();
+
+    // Run the tasks without blocking the scheduling of new tasks
+    for (auto &task : due_tasks) {
+      task();
+    }
+    due_tasks.clear();
+  }
+}
+
+}  // namespace utils
+}  // namespace overlay
@@ -0,0 +1,44 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+namespace overlay {
+namespace utils {
+
+typedef uint64_t ScheduledTaskId;
+
+// Runs periodic background tasks on a single low priority thread, which is
+// only started once the first task is scheduled and sleeps while there are no
+// tasks
+class Scheduler {
+ public:
+  Scheduler();
+
+  ScheduledTaskId SchedulePeriodicTask(std::chrono::milliseconds interval,
+                                       std::function<void()> task);
+  void CancelTask(ScheduledTaskId task_id);
+
+ private:
+  struct ScheduledTask {
+    std::chrono::milliseconds interval;
+    std::chrono::steady_clock::time_point next_run;
+    std::function<void()> task;
+  };
+
+  std::unordered_map<ScheduledTaskId, ScheduledTask> tasks_;
+  ScheduledTaskId next_task_id_;
+  std::mutex tasks_mutex_;
+  std::condition_variable tasks_cv_;
+
+  std::thread scheduler_thread_;
+
+  void SchedulerThread();
+};
+
+}  // namespace utils
+}  // namespace overlay
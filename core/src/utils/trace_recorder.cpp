@@ -0,0 +1,168 @@
+#include "utils/trace_recorder.h"
+
+#include <loguru/loguru.hpp>
+#include <sstream>
+
+namespace overlay {
+namespace utils {
+
+TraceRecorder::TraceRecorder() : recording_(false), session_(0) {}
+
+TraceRecorder *TraceRecorder::Get() {
+  static TraceRecorder trace_recorder;
+
+  return &trace_recorder;
+}
+
+bool TraceRecorder::Start() {
+  std::lock_guard state_lk(state_mutex_);
+
+  if (recording_) {
+    return false;
+  }
+
+  // Threads discard the events of older sessions on their next event
+  session_++;
+  recording_ = true;
+
+  DLOG_F(INFO, "Started recording trace.");
+
+  return true;
+}
+
+bool TraceRecorder::Stop(std::string &trace, uint64_t &events,
+                         uint64_t &dropped_events) {
+  std::lock_guard state_lk(state_mutex_);
+
+  if (!recording_) {
+    return false;
+  }
+
+  recording_ = false;
+
+  WriteChromeTrace(trace, session_, events, dropped_events);
+
+  return true;
+}
+
+void TraceRecorder::RecordComplete(const char *category, const char *name,
+                                   uint64_t start_timestamp,
+                                   uint64_t end_timestamp) {
+  Record({category, name, start_timestamp, end_timestamp - start_timestamp,
+          GetCurrentThreadId(), false});
+}
+
+void TraceRecorder::RecordInstant(const char *category, const char *name) {
+  if (!is_recording()) {
+    return;
+  }
+
+  Record({category, name, timestamp::GetTimestamp(), 0, GetCurrentThreadId(),
+          true});
+}
+
+void TraceRecorder::Record(const TraceEvent &event) {
+  ThreadBuffer *buffer = GetThreadBuffer();
+  uint64_t session = session_.load(std::memory_order_relaxed);
+  uint64_t count = 0;
+
+  // Discard the events of the previous session
+  if (buffer->session.load(std::memory_order_relaxed) != session) {
+    buffer->count.store(0, std::memory_order_relaxed);
+    buffer->dropped.store(0, std::memory_order_relaxed);
+    buffer->session.store(session, std::memory_order_release);
+  }
+
+  count = buffer->count.load(std::memory_order_relaxed);
+  if (count == TRACE_BUFFER_CAPACITY) {
+    buffer->dropped.store(buffer->dropped.load(std::memory_order_relaxed) + 1,
+                          std::memory_order_relaxed);
+    return;
+  }
+
+  // Write the event and publish it
+  buffer->events[count] = event;
+  buffer->count.store(count + 1, std::memory_order_release);
+}
+
+TraceRecorder::ThreadBuffer *TraceRecorder::GetThreadBuffer() {
+  static thread_local ThreadBufferOwner owner;
+
+  if (owner.buffer != nullptr) {
+    return owner.buffer;
+  }
+
+  std::lock_guard buffers_lk(buffers_mutex_);
+
+  // Reuse the buffer of a thread that has exited
+  for (auto &buffer : buffers_) {
+    if (!buffer->in_use) {
+      buffer->in_use = true;
+      owner.buffer = buffer.get();
+      return owner.buffer;
+    }
+  }
+
+  buffers_.push_back(std::make_unique<ThreadBuffer>());
+  owner.buffer = buffers_.back().get();
+  owner.buffer->session = 0;
+  owner.buffer->count = 0;
+  owner.buffer->dropped = 0;
+  owner.buffer->in_use = true;
+
+  return owner.buffer;
+}
+
+TraceRecorder::ThreadBufferOwner::~ThreadBufferOwner() {
+  if (buffer != nullptr) {
+    buffer->in_use = false;
+  }
+}
+
+void TraceRecorder::WriteChromeTrace(std::string &trace, uint64_t session,
+                                     uint64_t &events,
+                                     uint64_t &dropped_events) {
+  std::ostringstream file;
+  DWORD process_id = GetCurrentProcessId();
+  bool first_event = true;
+
+  events = 0;
+  dropped_events = 0;
+
+  file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+  std::lock_guard buffers_lk(buffers_mutex_);
+  for (auto &buffer : buffers_) {
+    if (buffer->session.load(std::memory_order_acquire) != session) {
+      continue;
+    }
+
+    uint64_t count = buffer->count.load(std::memory_order_acquire);
+    dropped_events += buffer->dropped.load(std::memory_order_relaxed);
+
+    for (uint64_t i = 0; i < count; i++) {
+      const TraceEvent &event = buffer->events[i];
+
+      file << (first_event ? "" : ",") << "{\"cat\":\"" << event.category
+           << "\",\"name\":\"" << event.name << "\",\"ts\":" << event.timestamp
+           << ",\"pid\":" << process_id << ",\"tid\":" << event.thread_id;
+      if (event.instant) {
+        file << ",\"ph\":\"i\",\"s\":\"t\"}";
+      } else {
+        file << ",\"ph\":\"X\",\"dur\":" << event.duration << "}";
+      }
+
+      first_event = false;
+      events++;
+    }
+  }
+
+  file << "]}";
+  trace = file.str();
+
+  DLOG_F(INFO, "Stopped trace with %llu events (%llu dropped).", events,
+         dropped_events);
+}
+
+}  // namespace utils
+}  // namespace overlay
@@ -0,0 +1,113 @@
+#pragma once
+#include <windows.h>
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "utils/timestamp.h"
+
+#define TRACE_BUFFER_CAPACITY 16384  // Events per thread
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+
+// Records the duration of the current scope, the category and the name must
+// be string literals
+#define TRACE_SCOPE(category, name)                                   \
+  overlay::utils::TraceScope TRACE_CONCAT(trace_scope_, __LINE__)( \
+      category, name)
+#define TRACE_INSTANT(category, name) \
+  overlay::utils::TraceRecorder::Get()->RecordInstant(category, name)
+
+namespace overlay {
+namespace utils {
+
+struct TraceEvent {
+  const char *category;
+  const char *name;
+  uint64_t timestamp;
+  uint64_t duration;
+  DWORD thread_id;
+  bool instant;
+};
+
+// Records events to per-thread buffers without locking, and dumps them as a
+// Chrome trace JSON which can be opened in chrome://tracing or Perfetto. The
+// trace is returned to the client which saves it, the overlay never writes it
+class TraceRecorder {
+ public:
+  static TraceRecorder *Get();
+
+  bool Start();
+  bool Stop(std::string &trace, uint64_t &events, uint64_t &dropped_events);
+
+  void RecordComplete(const char *category, const char *name,
+                      uint64_t start_timestamp, uint64_t end_timestamp);
+  void RecordInstant(const char *category, const char *name);
+
+  inline bool is_recording() const {
+    return recording_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  struct ThreadBuffer {
+    std::atomic<uint64_t> session;
+    std::atomic<uint64_t> count;
+    std::atomic<uint64_t> dropped;
+    std::atomic<bool> in_use;
+
+    std::array<TraceEvent, TRACE_BUFFER_CAPACITY> events;
+  };
+
+  // Returns the buffer of the thread to the recorder once the thread exits
+  struct ThreadBufferOwner {
+    ThreadBuffer *buffer = nullptr;
+
+    ~ThreadBufferOwner();
+  };
+
+  std::atomic<bool> recording_;
+  std::atomic<uint64_t> session_;
+  std::mutex state_mutex_;
+
+  std::vector<std::unique_ptr<ThreadBuffer>> buffers_;
+  std::mutex buffers_mutex_;
+
+  TraceRecorder();
+
+  void Record(const TraceEvent &event);
+  ThreadBuffer *GetThreadBuffer();
+
+  void WriteChromeTrace(std::string &trace, uint64_t session,
+                        uint64_t &events, uint64_t &dropped_events);
+};
+
+class TraceScope {
+ public:
+  inline TraceScope(const char *category, const char *name)
+      : category_(category),
+        name_(name),
+        start_timestamp_(TraceRecorder::Get()->is_recording()
+                             ? timestamp::GetTimestamp()
+                             : 0) {}
+
+  inline ~TraceScope() {
+    if (start_timestamp_ && TraceRecorder::Get()->is_recording()) {
+      TraceRecorder::Get()->RecordComplete(
+          category_, name_, start_timestamp_, timestamp::GetTimestamp());
+    }
+  }
+
+ private:
+  const char *category_;
+  const char *name_;
+  uint64_t start_timestamp_;
+};
+
+}  // namespace utils
+}  // namespace overlay
@@ -2,9 +2,22 @@
 #include <overlay/helper.h>
 #include <tlhelp32.h>
 
+#include <algorithm>
+#include <chrono>
 #include <cxxopts.hpp>
+#include <fstream>
 #include <iostream>
 #include <string>
+#include <utility>
+#include <vector>
+
+#include "graphics/blend.h"
+#include "utils/buffer_codec.h"
+
+#define BENCHMARK_ITERATIONS 1000
+#define BLEND_BENCHMARK_ITERATIONS 100
+#define BENCHMARK_BUFFER_WIDTH 1280
+#define BENCHMARK_BUFFER_HEIGHT 720
 
 DWORD FindProcessByName(std::string name) {
   DWORD pid = 0;
@@ -45,6 +58,260 @@ DWORD FindProcessByName(std::string name) {
   return pid;
 }
 
+// A mostly transparent frame with a panel, a small part of the panel changes
+// with each frame like a counter. The alpha is low so it isn't visible
+void FillBenchmarkFrame(std::vector<uint32_t>& frame, int index) {
+  std::fill(frame.begin(), frame.end(), 0);
+
+  for (int y = 100; y < 400; y++) {
+    for (int x = 100; x < 500; x++) {
+      frame[y * BENCHMARK_BUFFER_WIDTH + x] =
+          0x01000000 | ((x < 164 && y < 116) ? (x + index) % 2 : 0);
+    }
+  }
+}
+
+// Measures the bytes each encoding sends against its encode and decode time
+void BenchmarkBufferEncodings() {
+  const std::pair<const char*, uint32_t> encodings[] = {
+      {"Raw", overlay::utils::kBufferEncodingRaw},
+      {"RLE", overlay::utils::kBufferEncodingTransparentRle},
+      {"LZ4", overlay::utils::kBufferEncodingLz4},
+      {"RLE+LZ4", overlay::utils::kBufferEncodingTransparentRle |
+                      overlay::utils::kBufferEncodingLz4},
+      {"Delta+LZ4", overlay::utils::kBufferEncodingXorDelta |
+                        overlay::utils::kBufferEncodingLz4},
+      {"Delta+RLE+LZ4", overlay::utils::kBufferEncodingAll}};
+
+  std::vector<uint32_t> frame(BENCHMARK_BUFFER_WIDTH *
+                              BENCHMARK_BUFFER_HEIGHT);
+  size_t frame_size = frame.size() * sizeof(uint32_t);
+
+  for (auto& [name, encoding] : encodings) {
+    std::string previous_frame, received_frame, encoded, decoded;
+    std::chrono::duration<double> encode_time(0), decode_time(0);
+    std::chrono::steady_clock::time_point start;
+    uint64_t encoded_bytes = 0;
+
+    for (int i = 0; i < BENCHMARK_ITERATIONS; i++) {
+      // The first frame has nothing to be a delta of
+      uint32_t frame_encoding =
+          i ? encoding : encoding & ~overlay::utils::kBufferEncodingXorDelta;
+
+      FillBenchmarkFrame(frame, i);
+
+      start = std::chrono::steady_clock::now();
+      overlay::utils::BufferCodec::Encode(frame_encoding, frame.data(),
+                                          frame_size, &previous_frame,
+                                          encoded);
+      encode_time += std::chrono::steady_clock::now() - start;
+      encoded_bytes += encoded.size();
+      previous_frame.assign((const char*)frame.data(), frame_size);
+
+      // Decode like the overlay, which applies the delta to its last frame
+      start = std::chrono::steady_clock::now();
+      overlay::utils::BufferCodec::Decode(frame_encoding, encoded, frame_size,
+                                          decoded);
+      if (frame_encoding & overlay::utils::kBufferEncodingXorDelta) {
+        overlay::utils::BufferCodec::ApplyXorDelta(decoded, received_frame);
+      }
+      decode_time += std::chrono::steady_clock::now() - start;
+      received_frame.swap(decoded);
+    }
+
+    std::cout << name << ": "
+              << encoded_bytes / BENCHMARK_ITERATIONS << " bytes per frame ("
+              << encoded_bytes * 100.0 / frame_size / BENCHMARK_ITERATIONS
+              << "%), encode "
+              << encode_time.count() * 1000000 / BENCHMARK_ITERATIONS
+              << "us, decode "
+              << decode_time.count() * 1000000 / BENCHMARK_ITERATIONS << "us"
+              << std::endl;
+  }
+}
+
+// Blends the source over an opaque frame with a kernel, and returns the
+// millions of pixels blended per second
+template <overlay::core::graphics::blend::BlendMode mode>
+double BenchmarkBlendRow(const std::vector<uint32_t>& source, uint32_t alpha) {
+  std::vector<uint32_t> destination(source.size(), 0xff202020);
+  std::chrono::steady_clock::time_point start;
+  std::chrono::duration<double> elapsed;
+  volatile uint32_t blended_pixel = 0;
+
+  start = std::chrono::steady_clock::now();
+  for (int i = 0; i < BLEND_BENCHMARK_ITERATIONS; i++) {
+    for (int y = 0; y < BENCHMARK_BUFFER_HEIGHT; y++) {
+      overlay::core::graphics::blend::BlendRow<mode>(
+          destination.data() + y * BENCHMARK_BUFFER_WIDTH,
+          source.data() + y * BENCHMARK_BUFFER_WIDTH, BENCHMARK_BUFFER_WIDTH,
+          alpha);
+    }
+  }
+  elapsed = std::chrono::steady_clock::now() - start;
+
+  // Keep the blended frame from being optimized away
+  blended_pixel = destination[destination.size() / 2];
+
+  return source.size() * BLEND_BENCHMARK_ITERATIONS / elapsed.count() /
+         1000000;
+}
+
+// Measures the overlay's software blend kernels with each combination of
+// the window's source and opacity
+void BenchmarkBlendModes() {
+  using overlay::core::graphics::blend::BlendMode;
+
+  std::vector<uint32_t> opaque_frame(BENCHMARK_BUFFER_WIDTH *
+                                     BENCHMARK_BUFFER_HEIGHT);
+  std::vector<uint32_t> transparent_frame(opaque_frame.size());
+
+  for (size_t i = 0; i < opaque_frame.size(); i++) {
+    opaque_frame[i] = 0xff000000 | (uint32_t)(i * 0x010101);
+  }
+  FillBenchmarkFrame(transparent_frame, 0);
+
+  std::cout << "Blend opaque color: "
+            << BenchmarkBlendRow<BlendMode::Opaque>(opaque_frame, 0xff)
+            << " Mpixels/s" << std::endl;
+  std::cout << "Blend color at 50% opacity: "
+            << BenchmarkBlendRow<BlendMode::UniformAlpha>(opaque_frame, 0x80)
+            << " Mpixels/s" << std::endl;
+  std::cout << "Blend opaque buffer: "
+            << BenchmarkBlendRow<BlendMode::PerPixelAlpha>(opaque_frame, 0xff)
+            << " Mpixels/s" << std::endl;
+  std::cout << "Blend opaque buffer at 50% opacity: "
+            << BenchmarkBlendRow<BlendMode::PerPixelAlpha>(opaque_frame, 0x80)
+            << " Mpixels/s" << std::endl;
+  std::cout << "Blend transparent buffer: "
+            << BenchmarkBlendRow<BlendMode::PerPixelAlpha>(transparent_frame,
+                                                           0xff)
+            << " Mpixels/s" << std::endl;
+  std::cout << "Blend transparent buffer at 50% opacity: "
+            << BenchmarkBlendRow<BlendMode::PerPixelAlpha>(transparent_frame,
+                                                           0x80)
+            << " Mpixels/s" << std::endl;
+}
+
+// Saves an A8R8G8B8 buffer as a top-down 32-bit bitmap
+bool SaveBitmap(const std::string& path, const std::string& buffer,
+                uint32_t width, uint32_t height) {
+  BITMAPFILEHEADER file_header = {0};
+  BITMAPINFOHEADER info_header = {0};
+  std::ofstream file(path, std::ios::out | std::ios::binary | std::ios::trunc);
+
+  info_header.biSize = sizeof(info_header);
+  info_header.biWidth = width;
+  info_header.biHeight = -(LONG)height;
+  info_header.biPlanes = 1;
+  info_header.biBitCount = 32;
+  info_header.biCompression = BI_RGB;
+
+  file_header.bfType = 0x4d42;  // BM
+  file_header.bfOffBits = sizeof(file_header) + sizeof(info_header);
+  file_header.bfSize = file_header.bfOffBits + (DWORD)buffer.size();
+
+  file.write((const char*)&file_header, sizeof(file_header));
+  file.write((const char*)&info_header, sizeof(info_header));
+  file.write(buffer.data(), buffer.size());
+
+  return file.good();
+}
+
+void BenchmarkClient(std::shared_ptr<ovhp::Client> client) {
+  ovhp::WindowGroupAttributes group_attributes = {0};
+  ovhp::WindowAttributes attributes = {0};
+  ovhp::Rect rect = {BENCHMARK_BUFFER_HEIGHT, BENCHMARK_BUFFER_WIDTH, 0, 0};
+
+  // A fully transparent buffer so the benchmark isn't visible
+  std::vector<uint32_t> buffer(BENCHMARK_BUFFER_WIDTH * BENCHMARK_BUFFER_HEIGHT,
+                               0);
+
+  std::chrono::steady_clock::time_point start;
+  std::chrono::duration<double> elapsed;
+
+  group_attributes.opacity = 1;
+  attributes.opacity = 1;
+
+  std::shared_ptr<ovhp::WindowGroup> window_group =
+      client->CreateWindowGroup(group_attributes);
+  std::shared_ptr<ovhp::Window> window =
+      window_group->CreateNewWindow(rect, attributes);
+
+  // Measure the round trip of a small request
+  start = std::chrono::steady_clock::now();
+  for (int i = 0; i < BENCHMARK_ITERATIONS; i++) {
+    rect.x = i % 2;
+    window->SetRect(rect);
+  }
+  elapsed = std::chrono::steady_clock::now() - start;
+
+  std::cout << "Latency: " << elapsed.count() * 1000000 / BENCHMARK_ITERATIONS
+            << "us per request" << std::endl;
+
+  // Measure the same requests without waiting for each of them
+  start = std::chrono::steady_clock::now();
+  for (int i = 0; i < BENCHMARK_ITERATIONS; i++) {
+    rect.x = i % 2;
+    window->SetRectAsync(rect);
+  }
+  client->WaitForAsyncCalls();
+  elapsed = std::chrono::steady_clock::now() - start;
+
+  std::cout << "Pipelined: "
+            << elapsed.count() * 1000000 / BENCHMARK_ITERATIONS
+            << "us per request" << std::endl;
+
+  // Measure the throughput of the window buffers
+  start = std::chrono::steady_clock::now();
+  for (int i = 0; i < BENCHMARK_ITERATIONS; i++) {
+    window->UpdateBitmapBuffer(buffer);
+  }
+  elapsed = std::chrono::steady_clock::now() - start;
+
+  std::cout << "Throughput: "
+            << BENCHMARK_ITERATIONS / elapsed.count() << " buffers/s ("
+            << BENCHMARK_ITERATIONS * buffer.size() * sizeof(uint32_t) /
+                   elapsed.count() / (1024 * 1024)
+            << "MB/s)" << std::endl;
+
+  // Measure the throughput of changing frames with the encodings
+  for (auto encoding :
+       {ovhp::BufferEncoding::Raw, ovhp::BufferEncoding::TransparentRle |
+                                       ovhp::BufferEncoding::Lz4,
+        ovhp::BufferEncoding::XorDelta | ovhp::BufferEncoding::TransparentRle |
+            ovhp::BufferEncoding::Lz4}) {
+    window->SetBufferEncoding(encoding);
+
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < BENCHMARK_ITERATIONS; i++) {
+      FillBenchmarkFrame(buffer, i);
+      window->UpdateBitmapBuffer(buffer);
+    }
+    elapsed = std::chrono::steady_clock::now() - start;
+
+    std::cout << "Encoded throughput (" << (uint32_t)encoding
+              << "): " << BENCHMARK_ITERATIONS / elapsed.count()
+              << " buffers/s" << std::endl;
+  }
+
+  // Measure the overlay's software composite of its windows
+  start = std::chrono::steady_clock::now();
+  for (int i = 0; i < BLEND_BENCHMARK_ITERATIONS; i++) {
+    uint32_t width = BENCHMARK_BUFFER_WIDTH, height = BENCHMARK_BUFFER_HEIGHT;
+
+    client->CaptureOverlay(width, height);
+  }
+  elapsed = std::chrono::steady_clock::now() - start;
+
+  std::cout << "Capture: "
+            << elapsed.count() * 1000 / BLEND_BENCHMARK_ITERATIONS
+            << "ms per capture" << std::endl;
+
+  BenchmarkBufferEncodings();
+  BenchmarkBlendModes();
+}
+
 int main(int argc, char** argv) {
   cxxopts::Options options("Overlay Demo",
                            "This program is used to demonstrate the overlay");
@@ -64,6 +331,22 @@ int main(int argc, char** argv) {
            "5"))  // --max-connect-retries 5
       ("stats-log",
        "Log target process's stats (FPS and Frame time)")  // --stats-log
+      ("transport", "The transport to connect with (tls/local)",
+       cxxopts::value<std::string>()->default_value("tls"))  // --transport tls
+      ("benchmark",
+       "Benchmark the latency and throughput of the connection")  // --benchmark
+      ("trace", "Record a trace of the overlay to a Chrome trace file",
+       cxxopts::value<std::string>())  // --trace trace.json
+      ("trace-duration", "Seconds to record the trace for",
+       cxxopts::value<unsigned int>()->default_value(
+           "5"))  // --trace-duration 5
+      ("record-input", "Record the overlay's input routing to a file",
+       cxxopts::value<std::string>())  // --record-input input.bin
+      ("record-input-duration", "Seconds to record the input for",
+       cxxopts::value<unsigned int>()->default_value(
+           "10"))  // --record-input-duration 10
+      ("capture-overlay", "Capture the overlay's windows to a bitmap",
+       cxxopts::value<std::string>())  // --capture-overlay overlay.bmp
       ("h,help", "Show this help")                         // -h
       ;
 
@@ -129,7 +412,10 @@ int main(int argc, char** argv) {
     try {
       // Connect to the client
       std::cout << "Connecting to overlay.." << std::endl;
-      client = ovhp::CreateClient(process_info.dwProcessId);
+      client = ovhp::CreateClient(process_info.dwProcessId,
+                                  args["transport"].as<std::string>() == "local"
+                                      ? ovhp::ClientTransport::Local
+                                      : ovhp::ClientTransport::Tls);
 
       do {
         if (retries > 0) {
@@ -154,13 +440,57 @@ int main(int argc, char** argv) {
       std::cout << "Connected to dest process' overlay!" << std::endl
                 << std::endl;
 
+      if (args["benchmark"].as<bool>()) {
+        BenchmarkClient(client);
+      }
+
+      if (args.count("trace")) {
+        char trace_path[MAX_PATH] = {0};
+
+        GetFullPathNameA(args["trace"].as<std::string>().c_str(), MAX_PATH,
+                         trace_path, NULL);
+
+        std::cout << "Recording trace.." << std::endl;
+        client->StartTracing();
+        Sleep(args["trace-duration"].as<unsigned int>() * 1000);
+        client->StopTracing(trace_path);
+        std::cout << "Saved trace to " << trace_path << std::endl;
+      }
+
+      if (args.count("record-input")) {
+        char record_path[MAX_PATH] = {0};
+
+        GetFullPathNameA(args["record-input"].as<std::string>().c_str(),
+                         MAX_PATH, record_path, NULL);
+
+        std::cout << "Recording input.." << std::endl;
+        client->StartInputRecording();
+        Sleep(args["record-input-duration"].as<unsigned int>() * 1000);
+        client->StopInputRecording(record_path);
+        std::cout << "Saved input recording to " << record_path << std::endl;
+      }
+
+      if (args.count("capture-overlay")) {
+        uint32_t width = 0, height = 0;
+        std::string capture = client->CaptureOverlay(width, height);
+
+        if (SaveBitmap(args["capture-overlay"].as<std::string>(), capture,
+                       width, height)) {
+          std::cout << "Saved " << width << "x" << height
+                    << " overlay capture to "
+                    << args["capture-overlay"].as<std::string>() << std::endl;
+        } else {
+          std::cout << "Unable to save the overlay capture" << std::endl;
+        }
+      }
+
       if (args["stats-log"].as<bool>()) {
         client->SubscribeToEvent(
             ovhp::EventType::ApplicationStats,
             [](std::shared_ptr<ovhp::Event> event) {
               printf(
                   "\rApplication stats: Window Size: %zdx%zd, Fullscreen: %s, "
-                  "Frame time: %f, FPS: %f",
+                  "Frame time: %f, FPS: %f, P99: %f, 1%% low FPS: %f",
                   std::static_pointer_cast<ovhp::ApplicationStatsEvent>(event)
                       ->width,
                   std::static_pointer_cast<ovhp::ApplicationStatsEvent>(event)
@@ -172,7 +502,11 @@ int main(int argc, char** argv) {
                   std::static_pointer_cast<ovhp::ApplicationStatsEvent>(event)
                       ->frame_time,
                   std::static_pointer_cast<ovhp::ApplicationStatsEvent>(event)
-                      ->fps);
+                      ->fps,
+                  std::static_pointer_cast<ovhp::ApplicationStatsEvent>(event)
+                      ->frame_time_p99,
+                  std::static_pointer_cast<ovhp::ApplicationStatsEvent>(event)
+                      ->one_percent_low_fps);
             });
       }
 
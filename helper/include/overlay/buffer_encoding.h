@@ -0,0 +1,26 @@
+#ifndef OVERLAY_BUFFER_ENCODING_H
+#define OVERLAY_BUFFER_ENCODING_H
+#include <cstdint>
+
+namespace overlay {
+namespace helper {
+
+enum class BufferEncoding : uint32_t {
+  Raw = 0,
+  XorDelta = 1 << 0,        // Send only the changes from the previous buffer
+  TransparentRle = 1 << 1,  // Collapse runs of fully transparent pixels
+  Lz4 = 1 << 2
+};
+
+constexpr BufferEncoding operator|(BufferEncoding a, BufferEncoding b) {
+  return (BufferEncoding)((uint32_t)a | (uint32_t)b);
+}
+
+constexpr BufferEncoding operator&(BufferEncoding a, BufferEncoding b) {
+  return (BufferEncoding)((uint32_t)a & (uint32_t)b);
+}
+
+}  // namespace helper
+}  // namespace overlay
+
+#endif
@@ -2,31 +2,99 @@
 #define OVERLAY_CLIENT_H
 #include <overlay/events.h>
 #include <overlay/export.h>
+#include <overlay/hotkey.h>
 #include <overlay/window.h>
 #include <windows.h>
 
 #include <functional>
+#include <future>
 #include <memory>
+#include <string>
 
 namespace overlay {
 namespace helper {
 
+enum class ClientTransport {
+  Tls,   // TLS over loopback TCP
+  Local  // Unix domain socket, requires Windows 10 1803 or later
+};
+
 class HELPER_EXPORT Client {
  public:
   virtual ~Client();
 
   virtual void Connect() = 0;
 
+  // The interval is the milliseconds between periodic events such as the
+  // stats, 0 for the overlay's default. The frame events are passed at most
+  // once in the interval, 0 passes all of them
   virtual void SubscribeToEvent(
       EventType event_type,
-      std::function<void(std::shared_ptr<Event>)> callback) = 0;
+      std::function<void(std::shared_ptr<Event>)> callback,
+      uint32_t interval = 0) = 0;
   virtual void UnsubscribeEvent(EventType event_type) = 0;
 
   virtual std::shared_ptr<WindowGroup> CreateWindowGroup(
       const WindowGroupAttributes attributes) = 0;
+
+  // Waits for all the async calls of the windows and window groups that were
+  // made so far, so many calls can be pipelined and waited for at once
+  virtual void WaitForAsyncCalls() = 0;
+
+  // Commits all of the window groups and windows that are in the write-behind
+  // mode, which is also done on each of the game's frames. The future also
+  // throws the first failure of the frames' commits since the last commit
+  virtual std::future<void> Commit() = 0;
+
+  // The upload budget and the input coalescing are shared by all of the
+  // overlay's clients. The first client that sets either of them owns both
+  // until it disconnects, when they're reset to their defaults. Setting them
+  // from another client throws SettingsOwnedByAnotherClient.
+  //
+  // Limits the bytes of buffers uploaded to the GPU in each of the game's
+  // frames, bigger buffers are uploaded over several frames. 0 removes the
+  // limit
+  virtual void SetUploadBudget(uint64_t budget) = 0;
+
+  // Sets the milliseconds mouse moves are coalesced for at most before they
+  // are sent as a single event, moves are also sent on each of the game's
+  // frames. 0 sends every move on its own
+  virtual void SetInputCoalesceInterval(uint32_t interval) = 0;
+
+  // Registers a key chord that is matched inside the overlay, the client gets
+  // a hotkey event with the id each time it's pressed. The client must be
+  // subscribed to the hotkey events, and its hotkeys are dropped once it
+  // unsubscribes or disconnects. Blocking hides the chord's key from the game
+  // and from the overlay's windows. Registering an existing id replaces its
+  // hotkey
+  virtual void RegisterHotkey(
+      uint32_t id, uint8_t virtual_key,
+      HotkeyModifiers modifiers = HotkeyModifiers::None,
+      bool block = true) = 0;
+  virtual void UnregisterHotkey(uint32_t id) = 0;
+
+  // Measures the round trip to the overlay in milliseconds
+  virtual double Ping() = 0;
+
+  // Records the overlay's timelines until the trace is stopped, the trace is
+  // sent back and saved by the client's process as a Chrome trace JSON
+  virtual void StartTracing() = 0;
+  virtual void StopTracing(const std::string &path) = 0;
+
+  // Records the mouse input, the windows and the focus to a binary log which
+  // is sent back and saved by the client's process. The log is replayed
+  // offline by the input replayer tool
+  virtual void StartInputRecording() = 0;
+  virtual void StopInputRecording(const std::string &path) = 0;
+
+  // Composites the windows on the overlay's CPU into an A8R8G8B8 buffer of
+  // the given resolution, or of the game's resolution if it's 0, without
+  // going through the game's renderer
+  virtual std::string CaptureOverlay(uint32_t &width, uint32_t &height) = 0;
 };
 
-HELPER_EXPORT std::shared_ptr<Client> CreateClient(DWORD process_id);
+HELPER_EXPORT std::shared_ptr<Client> CreateClient(
+    DWORD process_id, ClientTransport transport = ClientTransport::Tls);
 
 }  // namespace helper
 }  // namespace overlay
@@ -23,7 +23,14 @@ enum class ErrorCode {
   InvalidAttributes,
   InjectorNotFound,
   InvalidEventType,
-  InvalidCursor
+  InvalidCursor,
+  InvalidBufferEncoding,
+  LocalTransportUnavailable,
+  TracingFailed,
+  InputRecordingFailed,
+  InvalidHotkey,
+  CaptureFailed,
+  SettingsOwnedByAnotherClient
 };
 
 HELPER_EXPORT std::string GetErrorCodeDescription(ErrorCode code);
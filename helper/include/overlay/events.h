@@ -1,11 +1,20 @@
 #ifndef OVERLAY_EVENTS_H
 #define OVERLAY_EVENTS_H
 #include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
 
 namespace overlay {
 namespace helper {
 
-enum class EventType { ApplicationStats };
+enum class EventType {
+  ApplicationStats,
+  OverlayStats,
+  Frame,
+  RawMouseInput,
+  Hotkey
+};
 
 struct Event {
   Event(EventType type) : type(type) {}
@@ -15,19 +24,150 @@ struct Event {
 
 struct ApplicationStatsEvent : public Event {
   ApplicationStatsEvent(size_t width, size_t height, bool fullscreen,
-                        double frame_time, double fps)
+                        double frame_time, double fps, double frame_time_p50,
+                        double frame_time_p95, double frame_time_p99,
+                        double frame_time_max, double one_percent_low_fps,
+                        std::vector<double> frame_time_histogram_bounds,
+                        std::vector<uint32_t> frame_time_histogram)
       : Event(EventType::ApplicationStats),
         width(width),
         height(height),
         fullscreen(fullscreen),
         frame_time(frame_time),
-        fps(fps) {}
+        fps(fps),
+        frame_time_p50(frame_time_p50),
+        frame_time_p95(frame_time_p95),
+        frame_time_p99(frame_time_p99),
+        frame_time_max(frame_time_max),
+        one_percent_low_fps(one_percent_low_fps),
+        frame_time_histogram_bounds(frame_time_histogram_bounds),
+        frame_time_histogram(frame_time_histogram) {}
 
   size_t width;
   size_t height;
   bool fullscreen;
-  double frame_time;
+  double frame_time;  // Average of the last second
   double fps;
+
+  // Distribution of the last frames, all of the frame times are in ms
+  double frame_time_p50;
+  double frame_time_p95;
+  double frame_time_p99;
+  double frame_time_max;
+  double one_percent_low_fps;
+
+  // Upper bounds of the buckets, the last bucket holds all of the frames above
+  // the last bound
+  std::vector<double> frame_time_histogram_bounds;
+  std::vector<uint32_t> frame_time_histogram;
+};
+
+// Average cost of the overlay per frame since the previous event, all of the
+// times are in milliseconds
+struct OverlayStatsEvent : public Event {
+  OverlayStatsEvent(uint64_t frames, uint64_t frames_over_budget, double budget,
+                    double render_time, double render_time_max,
+                    double snapshot_time, double texture_creation_time,
+                    double upload_time, double draw_time,
+                    double uploaded_bytes, double created_textures,
+                    double drawn_sprites, uint32_t input_events,
+                    double input_latency_p50, double input_latency_p95,
+                    double input_latency_p99, double input_latency_max)
+      : Event(EventType::OverlayStats),
+        frames(frames),
+        frames_over_budget(frames_over_budget),
+        budget(budget),
+        render_time(render_time),
+        render_time_max(render_time_max),
+        snapshot_time(snapshot_time),
+        texture_creation_time(texture_creation_time),
+        upload_time(upload_time),
+        draw_time(draw_time),
+        uploaded_bytes(uploaded_bytes),
+        created_textures(created_textures),
+        drawn_sprites(drawn_sprites),
+        input_events(input_events),
+        input_latency_p50(input_latency_p50),
+        input_latency_p95(input_latency_p95),
+        input_latency_p99(input_latency_p99),
+        input_latency_max(input_latency_max) {}
+
+  uint64_t frames;
+  uint64_t frames_over_budget;
+  double budget;
+
+  double render_time;
+  double render_time_max;
+  double snapshot_time;
+  double texture_creation_time;
+  double upload_time;
+  double draw_time;
+
+  double uploaded_bytes;
+  double created_textures;
+  double drawn_sprites;
+
+  // Time from capturing input in the game to handling it by the client since
+  // the previous event. The client reports its latencies after each of these
+  // events, so the latencies lag by one event
+  uint32_t input_events;
+  double input_latency_p50;
+  double input_latency_p95;
+  double input_latency_p99;
+  double input_latency_max;
+};
+
+// Sent right after the game presents a frame, so the client can render a
+// single buffer per game frame. The times are in microseconds of the
+// performance counter (QueryPerformanceCounter)
+struct FrameEvent : public Event {
+  FrameEvent(uint64_t frame, uint64_t present_time, uint64_t next_vsync_time,
+             uint64_t frame_interval, bool occluded)
+      : Event(EventType::Frame),
+        frame(frame),
+        present_time(present_time),
+        next_vsync_time(next_vsync_time),
+        frame_interval(frame_interval),
+        occluded(occluded) {}
+
+  uint64_t frame;
+  uint64_t present_time;
+  uint64_t next_vsync_time;  // 0 if unknown
+  uint64_t frame_interval;   // Average time between frames, 0 if unknown
+  bool occluded;             // The game's window isn't visible
+};
+
+struct RawMouseInputSample {
+  int32_t delta_x;
+  int32_t delta_y;
+  bool absolute;          // The deltas are coordinates from 0 to 65535
+  uint32_t button_flags;  // RI_MOUSE_* flags of the buttons that changed
+  int32_t wheel_delta;
+  int32_t horizontal_wheel_delta;
+  uint64_t timestamp;  // Microseconds of the performance counter
+};
+
+// Unaccelerated mouse input, only sent while one of the client's windows is
+// focused and the game's input is blocked
+struct RawMouseInputEvent : public Event {
+  RawMouseInputEvent(std::vector<RawMouseInputSample> samples)
+      : Event(EventType::RawMouseInput), samples(samples) {}
+
+  std::vector<RawMouseInputSample> samples;  // Oldest first
+};
+
+// One of the client's hotkeys was pressed, sent whether the game's input is
+// blocked or not
+struct HotkeyEvent : public Event {
+  HotkeyEvent(uint32_t id, uint32_t message_time, uint64_t capture_time)
+      : Event(EventType::Hotkey),
+        id(id),
+        message_time(message_time),
+        capture_time(capture_time) {}
+
+  uint32_t id;
+  uint32_t message_time;  // The window message's time in milliseconds
+  uint64_t capture_time;  // Microseconds of the performance counter
 };
 
 }  // namespace helper
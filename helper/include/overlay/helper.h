@@ -1,11 +1,13 @@
 #ifndef OVERLAY_HELPER_H
 #define OVERLAY_HELPER_H
 
+#include <overlay/buffer_encoding.h>
 #include <overlay/client.h>
 #include <overlay/color.h>
 #include <overlay/cursor.h>
 #include <overlay/error.h>
 #include <overlay/events.h>
+#include <overlay/hotkey.h>
 #include <overlay/injection.h>
 #include <overlay/rect.h>
 #include <overlay/window.h>
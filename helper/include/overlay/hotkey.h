@@ -0,0 +1,29 @@
+#ifndef OVERLAY_HOTKEY_H
+#define OVERLAY_HOTKEY_H
+#include <cstdint>
+
+namespace overlay {
+namespace helper {
+
+// The modifiers that must be held with the hotkey's key, any other modifier
+// held prevents the match
+enum class HotkeyModifiers : uint32_t {
+  None = 0,
+  Alt = 1 << 0,
+  Control = 1 << 1,
+  Shift = 1 << 2,
+  Win = 1 << 3
+};
+
+constexpr HotkeyModifiers operator|(HotkeyModifiers a, HotkeyModifiers b) {
+  return (HotkeyModifiers)((uint32_t)a | (uint32_t)b);
+}
+
+constexpr HotkeyModifiers operator&(HotkeyModifiers a, HotkeyModifiers b) {
+  return (HotkeyModifiers)((uint32_t)a & (uint32_t)b);
+}
+
+}  // namespace helper
+}  // namespace overlay
+
+#endif
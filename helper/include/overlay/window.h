@@ -1,5 +1,6 @@
 #ifndef OVERLAY_WINDOW_H
 #define OVERLAY_WINDOW_H
+#include <overlay/buffer_encoding.h>
 #include <overlay/color.h>
 #include <overlay/cursor.h>
 #include <overlay/export.h>
@@ -7,6 +8,7 @@
 #include <overlay/window_events.h>
 
 #include <functional>
+#include <future>
 #include <memory>
 #include <string>
 #include <vector>
@@ -29,20 +31,73 @@ struct WindowAttributes {
   bool hidden;
 };
 
+// Counters of the window's buffers as of the last buffer the overlay
+// received, the latencies are in milliseconds from the overlay receiving a
+// buffer to rendering it
+struct BufferStats {
+  uint64_t received_buffers;
+  uint64_t presented_buffers;
+  uint64_t dropped_buffers;  // Replaced by a newer buffer before rendered
+  double latency;            // Smoothed over the recent buffers
+  double latency_max;
+};
+
+// The async methods return without waiting for the overlay, invalid arguments
+// throw right away and failed calls throw from the future. The calls of each
+// window and window group are handled in the order they were made, and the
+// getters return the state of the last call, rolling back to the last state
+// the overlay accepted if it fails. Buffer updates wait for the window's rects
+// in flight
 class HELPER_EXPORT Window {
  public:
   virtual ~Window();
 
   virtual void SetAttributes(const WindowAttributes attributes) = 0;
+  virtual std::future<void> SetAttributesAsync(
+      const WindowAttributes attributes) = 0;
   virtual const WindowAttributes GetAttributes() const = 0;
 
   virtual void SetRect(const Rect rect) = 0;
+  virtual std::future<void> SetRectAsync(const Rect rect) = 0;
   virtual const Rect GetRect() const = 0;
 
   virtual void SetCursor(const Cursor cursor) = 0;
+  virtual std::future<void> SetCursorAsync(const Cursor cursor) = 0;
   virtual const Cursor GetCursor() const = 0;
 
-  virtual void UpdateBitmapBuffer(const void* buffer, size_t buffer_size) = 0;
+  // In the write-behind mode the attributes, the rect and the cursor only
+  // change locally, and only their last values are sent when the window is
+  // committed or on the game's next frame. Their calls' futures are ready
+  // right away and the commit's future reports the failures. Leaving the
+  // mode sends the held values and waits for them like the other setters
+  virtual void SetWriteBehind(bool write_behind) = 0;
+  virtual bool IsWriteBehind() const = 0;
+  virtual std::future<void> Commit() = 0;
+
+  // Only the rects, relative to the window, take mouse input and the input
+  // outside of them falls through to the windows below or to the game. Empty
+  // rects let all of the window take input
+  virtual void SetInputMask(const std::vector<Rect>& rects) = 0;
+  // Only the pixels of the window's buffers with at least the alpha threshold
+  // take mouse input, 0 or a window without a buffer yet lets all of the
+  // window take input
+  virtual void SetInputMaskAlpha(uint8_t alpha_threshold) = 0;
+
+  virtual void SetBufferEncoding(const BufferEncoding encoding) = 0;
+  virtual const BufferEncoding GetBufferEncoding() const = 0;
+
+  // The buffer can be in a different resolution than the window's rect, in
+  // which case the overlay scales it to the rect. The buffers are sent
+  // without waiting for the overlay, so a buffer it rejects makes the
+  // window's next call throw
+  virtual void UpdateBitmapBuffer(const void* buffer, size_t buffer_size,
+                                  uint32_t width, uint32_t height) = 0;
+  virtual const BufferStats GetBufferStats() const = 0;
+
+  inline void UpdateBitmapBuffer(const void* buffer, size_t buffer_size) {
+    const Rect rect = GetRect();
+    return UpdateBitmapBuffer(buffer, buffer_size, rect.width, rect.height);
+  }
 
   inline void UpdateBitmapBuffer(std::string& buffer) {
     return UpdateBitmapBuffer(buffer.data(), buffer.size());
@@ -64,10 +119,20 @@ class HELPER_EXPORT WindowGroup {
   virtual ~WindowGroup();
 
   virtual void SetAttributes(const WindowGroupAttributes attributes) = 0;
+  virtual std::future<void> SetAttributesAsync(
+      const WindowGroupAttributes attributes) = 0;
   virtual const WindowGroupAttributes GetAttributes() const = 0;
 
+  // Holds the group's attributes like the windows' write-behind mode,
+  // committing the group also commits its windows
+  virtual void SetWriteBehind(bool write_behind) = 0;
+  virtual bool IsWriteBehind() const = 0;
+  virtual std::future<void> Commit() = 0;
+
   virtual std::shared_ptr<Window> CreateNewWindow(
       const Rect rect, const WindowAttributes attributes) = 0;
+  virtual std::future<std::shared_ptr<Window>> CreateNewWindowAsync(
+      const Rect rect, const WindowAttributes attributes) = 0;
 };
 
 }  // namespace helper
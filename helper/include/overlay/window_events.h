@@ -4,6 +4,7 @@
 
 #include <cstdint>
 #include <cwchar>
+#include <vector>
 
 namespace overlay {
 namespace helper {
@@ -159,6 +160,15 @@ struct WindowKeyboardInputEvent : public WindowEvent {
     KeyCode key_code;
     wchar_t character;
   };
+
+  uint32_t message_time = 0;  // The game's window message time in ms
+  uint64_t capture_time = 0;  // Microseconds of the performance counter
+};
+
+struct MouseMoveSample {
+  int64_t x;
+  int64_t y;
+  uint64_t timestamp;  // Microseconds of the game's performance counter
 };
 
 struct WindowMouseInputEvent : public WindowEvent {
@@ -203,6 +213,22 @@ struct WindowMouseInputEvent : public WindowEvent {
     Button button;
     int wheel_delta;
   };
+
+  // Every position the mouse moved through since the last mouse move event,
+  // oldest first, the last is the event's position
+  std::vector<MouseMoveSample> samples;
+
+  uint32_t message_time = 0;  // The game's window message time in ms
+  uint64_t capture_time = 0;  // Microseconds of the performance counter
+
+  // Consecutive clicks of the button, set on its presses and release
+  uint32_t click_count = 0;
+
+  // The mouse moved past the system's drag threshold with a button held, set
+  // on moves and on the release. The window that got the press gets every
+  // mouse event until the buttons are released, so the position can be
+  // outside of it
+  bool dragging = false;
 };
 
 struct WindowFocusEvent : public WindowEvent {
@@ -0,0 +1,71 @@
+#include "async_rpc_queue.h"
+
+namespace overlay {
+namespace helper {
+
+AsyncRpcQueue::AsyncRpcQueue() : pending_rpcs_(0) {
+  completion_thread_ = std::thread(&AsyncRpcQueue::HandleCompletions, this);
+}
+
+AsyncRpcQueue::~AsyncRpcQueue() {
+  // Let the RPCs that were already called complete
+  Wait();
+
+  completion_queue_.Shutdown();
+  completion_thread_.join();
+}
+
+void AsyncRpcQueue::Wait() {
+  // The completion thread completes the RPCs it would wait for
+  if (std::this_thread::get_id() == completion_thread_.get_id()) {
+    throw Error(ErrorCode::UnknownError);
+  }
+
+  std::unique_lock rpcs_lk(rpcs_mutex_);
+
+  rpcs_cv_.wait(rpcs_lk, [this]() { return pending_rpcs_ == 0; });
+}
+
+void AsyncRpcQueue::Push(std::unique_ptr<AsyncRpc> rpc) {
+  std::lock_guard rpcs_lk(rpcs_mutex_);
+  std::deque<std::unique_ptr<AsyncRpc>> &key_rpcs = rpcs_[rpc->get_key()];
+
+  pending_rpcs_++;
+
+  // Start the RPC unless an older RPC of the key is in flight
+  key_rpcs.push_back(std::move(rpc));
+  if (key_rpcs.size() == 1) {
+    key_rpcs.front()->Start(&completion_queue_);
+  }
+}
+
+void AsyncRpcQueue::HandleCompletions() {
+  void *tag = nullptr;
+  bool ok = false;
+
+  while (completion_queue_.Next(&tag, &ok)) {
+    AsyncRpc *rpc = static_cast<AsyncRpc *>(tag);
+    std::unique_ptr<AsyncRpc> completed_rpc = nullptr;
+
+    // A failed RPC has an error status, so it's completed either way
+    rpc->Complete();
+
+    std::lock_guard rpcs_lk(rpcs_mutex_);
+    auto key_rpcs = rpcs_.find(rpc->get_key());
+
+    // Start the next RPC of the key
+    completed_rpc = std::move(key_rpcs->second.front());
+    key_rpcs->second.pop_front();
+    if (!key_rpcs->second.empty()) {
+      key_rpcs->second.front()->Start(&completion_queue_);
+    } else {
+      rpcs_.erase(key_rpcs);
+    }
+
+    pending_rpcs_--;
+    rpcs_cv_.notify_all();
+  }
+}
+
+}  // namespace helper
+}  // namespace overlay
@@ -0,0 +1,159 @@
+#pragma once
+#include <grpcpp/grpcpp.h>
+#include <guiddef.h>
+#include <overlay/error.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "utils/guid.h"
+
+namespace overlay {
+namespace helper {
+
+class AsyncRpc {
+ public:
+  virtual ~AsyncRpc() {}
+
+  virtual void Start(grpc::CompletionQueue *completion_queue) = 0;
+  virtual void Complete() = 0;
+
+  inline const GUID &get_key() const { return key_; }
+
+ protected:
+  inline AsyncRpc(const GUID &key) : key_(key) {}
+
+ private:
+  GUID key_;
+};
+
+template <typename Request, typename Response>
+class AsyncUnaryRpc : public AsyncRpc {
+ public:
+  using Prepare =
+      std::function<std::unique_ptr<grpc::ClientAsyncResponseReader<Response>>(
+          grpc::ClientContext *, const Request &, grpc::CompletionQueue *)>;
+  using Done = std::function<void(const grpc::Status &, Response &)>;
+
+  inline AsyncUnaryRpc(const GUID &key, Request &&request, Prepare prepare,
+                       Done done)
+      : AsyncRpc(key),
+        request_(std::move(request)),
+        prepare_(prepare),
+        done_(done) {}
+
+  virtual void Start(grpc::CompletionQueue *completion_queue) {
+    reader_ = prepare_(&context_, request_, completion_queue);
+    reader_->StartCall();
+    reader_->Finish(&response_, &status_, this);
+  }
+
+  virtual void Complete() { done_(status_, response_); }
+
+ private:
+  grpc::ClientContext context_;
+  Request request_;
+  Response response_;
+  grpc::Status status_;
+  std::unique_ptr<grpc::ClientAsyncResponseReader<Response>> reader_;
+
+  Prepare prepare_;
+  Done done_;
+};
+
+// The future of a call that didn't need an RPC
+inline std::future<void> MakeReadyFuture() {
+  std::promise<void> promise;
+
+  promise.set_value();
+  return promise.get_future();
+}
+
+// Waits for all of the futures when waited for, and throws the first failure
+inline std::future<void> WhenAll(std::vector<std::future<void>> &&futures) {
+  return std::async(std::launch::deferred,
+                    [futures = std::move(futures)]() mutable {
+                      for (std::future<void> &future : futures) {
+                        future.get();
+                      }
+                    });
+}
+
+// Runs unary RPCs without blocking the caller on a shared completion queue.
+// RPCs with different keys are pipelined, while RPCs with the same key, such
+// as the calls of a single window, are started one after the other so the
+// overlay handles them in the order they were made.
+//
+// The completion handlers all run on the queue's single completion thread, so
+// they must not block, and they must never wait for the queue's RPCs
+class AsyncRpcQueue {
+ public:
+  AsyncRpcQueue();
+  ~AsyncRpcQueue();
+
+  template <typename Request, typename Response>
+  inline void Call(
+      const GUID &key, Request &&request,
+      typename AsyncUnaryRpc<Request, Response>::Prepare prepare,
+      typename AsyncUnaryRpc<Request, Response>::Done done) {
+    Push(std::make_unique<AsyncUnaryRpc<Request, Response>>(
+        key, std::move(request), prepare, done));
+  }
+
+  // Returns a future that throws if the RPC fails. The completion handler is
+  // called with the result before the future is ready
+  template <typename Request, typename Response>
+  inline std::future<void> Call(
+      const GUID &key, Request &&request,
+      typename AsyncUnaryRpc<Request, Response>::Prepare prepare,
+      std::function<void(bool ok)> completed = nullptr) {
+    std::shared_ptr<std::promise<void>> promise =
+        std::make_shared<std::promise<void>>();
+
+    Call<Request, Response>(
+        key, std::move(request), prepare,
+        [promise, completed](const grpc::Status &status,
+                             Response &response) {
+          if (completed) {
+            completed(status.ok());
+          }
+
+          if (status.ok()) {
+            promise->set_value();
+          } else {
+            promise->set_exception(
+                std::make_exception_ptr(Error(ErrorCode::UnknownError)));
+          }
+        });
+
+    return promise->get_future();
+  }
+
+  // Waits for all the RPCs that were called so far to complete. Throws if
+  // it's called from a completion handler, where it would never return
+  void Wait();
+
+ private:
+  grpc::CompletionQueue completion_queue_;
+  std::thread completion_thread_;
+
+  // The RPCs of each key, the first one is the one in flight
+  std::unordered_map<GUID, std::deque<std::unique_ptr<AsyncRpc>>> rpcs_;
+  uint64_t pending_rpcs_;
+  std::mutex rpcs_mutex_;
+  std::condition_variable rpcs_cv_;
+
+  void Push(std::unique_ptr<AsyncRpc> rpc);
+  void HandleCompletions();
+};
+
+}  // namespace helper
+}  // namespace overlay
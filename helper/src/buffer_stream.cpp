@@ -0,0 +1,144 @@
+#include "buffer_stream.h"
+
+namespace overlay {
+namespace helper {
+
+BufferStream::BufferStream(Windows::Stub *stub)
+    : stream_(stub->StreamBuffersForWindows(&context_)),
+      next_sequence_(0),
+      in_flight_(0),
+      broken_(false),
+      last_present_timestamp_(0) {
+  acks_thread_ = std::thread(&BufferStream::HandleAcks, this);
+}
+
+BufferStream::~BufferStream() {
+  {
+    std::lock_guard write_lk(write_mutex_);
+    stream_->WritesDone();
+  }
+
+  // The server closes the stream once it handled all of the buffers
+  acks_thread_.join();
+  stream_->Finish();
+}
+
+bool BufferStream::SendBuffer(const GUID &group_id, const GUID &window_id,
+                              std::string &&buffer, uint32_t encoding,
+                              size_t raw_size, uint32_t width,
+                              uint32_t height, uint64_t generation,
+                              uint64_t base_generation) {
+  BufferForWindowRequest request;
+
+  // Fill the request
+  request.set_group_id((const char *)&group_id, sizeof(group_id));
+  request.set_window_id((const char *)&window_id, sizeof(window_id));
+  request.set_buffer(std::move(buffer));
+  request.set_encoding(encoding);
+  request.set_raw_size(raw_size);
+  request.set_width(width);
+  request.set_height(height);
+  request.set_generation(generation);
+  request.set_base_generation(base_generation);
+
+  // The sequence is taken under the write lock, so the buffers are written
+  // in the order of their sequences
+  std::lock_guard write_lk(write_mutex_);
+  std::unique_lock in_flight_lk(in_flight_mutex_);
+
+  // Wait for the overlay to acknowledge older buffers
+  in_flight_cv_.wait(in_flight_lk, [this]() {
+    return in_flight_ < BUFFER_STREAM_MAX_IN_FLIGHT || broken_;
+  });
+  if (broken_) {
+    return false;
+  }
+
+  in_flight_++;
+  request.set_sequence(next_sequence_++);
+  in_flight_lk.unlock();
+
+  // Send the buffer without waiting for the overlay to handle it
+  if (!stream_->Write(request)) {
+    // The buffer will never be acknowledged
+    in_flight_lk.lock();
+    in_flight_--;
+    broken_ = true;
+    in_flight_cv_.notify_all();
+    return false;
+  }
+
+  return true;
+}
+
+bool BufferStream::TakeRejectedWindow(const GUID &window_id) {
+  std::lock_guard rejected_windows_lk(rejected_windows_mutex_);
+
+  return rejected_windows_.erase(window_id);
+}
+
+bool BufferStream::TakeFailedWindow(const GUID &window_id) {
+  std::lock_guard rejected_windows_lk(rejected_windows_mutex_);
+
+  return failed_windows_.erase(window_id);
+}
+
+BufferStats BufferStream::GetWindowStats(const GUID &window_id) {
+  std::lock_guard window_stats_lk(window_stats_mutex_);
+
+  auto stats = window_stats_.find(window_id);
+  if (stats == window_stats_.end()) {
+    return {0};
+  }
+
+  return stats->second;
+}
+
+bool BufferStream::is_broken() {
+  std::lock_guard in_flight_lk(in_flight_mutex_);
+
+  return broken_;
+}
+
+uint64_t BufferStream::get_last_present_timestamp() const {
+  return last_present_timestamp_;
+}
+
+void BufferStream::HandleAcks() {
+  BufferForWindowAck ack;
+
+  while (stream_->Read(&ack)) {
+    last_present_timestamp_ = ack.present_timestamp();
+
+    // Save the window so that its next buffer won't be a delta, and so that
+    // the invalid buffer's error is thrown by its next buffer
+    if (!ack.accepted() && ack.window_id().size() == sizeof(GUID)) {
+      std::lock_guard rejected_windows_lk(rejected_windows_mutex_);
+      rejected_windows_.insert(*(GUID *)ack.window_id().data());
+      if (!ack.base_mismatch()) {
+        failed_windows_.insert(*(GUID *)ack.window_id().data());
+      }
+    }
+
+    // Save the counters of the window
+    if (ack.window_id().size() == sizeof(GUID)) {
+      std::lock_guard window_stats_lk(window_stats_mutex_);
+      window_stats_[*(GUID *)ack.window_id().data()] = {
+          ack.received_buffers(), ack.presented_buffers(),
+          ack.dropped_buffers(), ack.latency() / 1000.0,
+          ack.latency_max() / 1000.0};
+    }
+
+    std::lock_guard in_flight_lk(in_flight_mutex_);
+    in_flight_--;
+    in_flight_cv_.notify_all();
+  }
+
+  // The stream was closed
+  std::lock_guard in_flight_lk(in_flight_mutex_);
+  broken_ = true;
+  in_flight_cv_.notify_all();
+}
+
+}  // namespace helper
+}  // namespace overlay
@@ -0,0 +1,76 @@
+#pragma once
+#include <grpcpp/grpcpp.h>
+#include <guiddef.h>
+#include <overlay/window.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "utils/guid.h"
+#include "windows.grpc.pb.h"
+
+#define BUFFER_STREAM_MAX_IN_FLIGHT 3
+
+namespace overlay {
+namespace helper {
+
+class BufferStream {
+ public:
+  BufferStream(Windows::Stub *stub);
+  ~BufferStream();
+
+  // Returns false if this buffer couldn't be written, which breaks the stream
+  bool SendBuffer(const GUID &group_id, const GUID &window_id,
+                  std::string &&buffer, uint32_t encoding, size_t raw_size,
+                  uint32_t width, uint32_t height, uint64_t generation,
+                  uint64_t base_generation);
+
+  // Returns whether the overlay rejected a buffer of the window since the
+  // last call, in which case it doesn't hold the helper's previous buffer
+  bool TakeRejectedWindow(const GUID &window_id);
+  // Returns whether a buffer of the window was invalid since the last call,
+  // rather than a delta of a buffer the overlay doesn't have
+  bool TakeFailedWindow(const GUID &window_id);
+
+  BufferStats GetWindowStats(const GUID &window_id);
+
+  bool is_broken();
+  uint64_t get_last_present_timestamp() const;
+
+ private:
+  grpc::ClientContext context_;
+  std::unique_ptr<
+      grpc::ClientReaderWriter<BufferForWindowRequest, BufferForWindowAck>>
+      stream_;
+
+  std::thread acks_thread_;
+
+  uint64_t next_sequence_;
+  uint64_t in_flight_;
+  bool broken_;
+  std::mutex in_flight_mutex_;
+  std::condition_variable in_flight_cv_;
+
+  std::mutex write_mutex_;
+
+  std::unordered_set<GUID> rejected_windows_;
+  std::unordered_set<GUID> failed_windows_;
+  std::mutex rejected_windows_mutex_;
+
+  std::unordered_map<GUID, BufferStats> window_stats_;
+  std::mutex window_stats_mutex_;
+
+  std::atomic<uint64_t> last_present_timestamp_;
+
+  void HandleAcks();
+};
+
+}  // namespace helper
+}  // namespace overlay
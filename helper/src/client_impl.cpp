@@ -3,7 +3,12 @@
 #include <grpcpp/grpcpp.h>
 #include <overlay/error.h>
 
+#include <chrono>
+#include <fstream>
+
 #include "auth.grpc.pb.h"
+#include "session_interceptor.h"
+#include "utils/timestamp.h"
 #include "utils/token.h"
 
 namespace overlay {
@@ -11,15 +16,28 @@ namespace helper {
 
 Client::~Client() {}
 
-ClientImpl::ClientImpl(DWORD process_id)
+ClientImpl::ClientImpl(DWORD process_id, ClientTransport transport)
     : overlay_pid_(process_id),
+      transport_(transport),
       channel_(nullptr),
       windows_stub_(nullptr),
-      event_manager_(nullptr) {}
-
-std::shared_ptr<Client> CreateClient(DWORD process_id) {
+      tracing_stub_(nullptr),
+      events_stub_(nullptr),
+      async_rpc_queue_(nullptr),
+      buffer_stream_(nullptr),
+      frame_callback_(nullptr),
+      frame_callback_interval_(0),
+      last_frame_callback_time_(0),
+      frame_committers_(0),
+      frame_subscribed_(false),
+      frame_commit_error_(nullptr),
+      event_manager_(nullptr),
+      input_latencies_measured_(false) {}
+
+std::shared_ptr<Client> CreateClient(DWORD process_id,
+                                     ClientTransport transport) {
   return std::static_pointer_cast<Client>(
-      std::make_shared<ClientImpl>(process_id));
+      std::make_shared<ClientImpl>(process_id, transport));
 }
 
 void ClientImpl::Connect() {
@@ -34,6 +52,15 @@ void ClientImpl::Connect() {
   // Create the windows stub
   windows_stub_ = Windows::NewStub(channel_);
 
+  // Create the tracing stub
+  tracing_stub_ = Tracing::NewStub(channel_);
+
+  // Create the events stub of the async calls
+  events_stub_ = Events::NewStub(channel_);
+
+  // Create the queue of the async calls
+  async_rpc_queue_ = std::make_unique<AsyncRpcQueue>();
+
   // Create event manager and start it
   event_manager_ = std::make_unique<EventManager>(channel_);
   event_manager_->StartHandlingAsyncRpcs();
@@ -41,12 +68,12 @@ void ClientImpl::Connect() {
   // Set handler for window event
   event_manager_->SubscribeToEvent(
       EventResponse::EventCase::kWindowEvent,
-      [this](EventResponse &res) { HandleWindowEvent(res); });
+      [this](EventResponse &res) { HandleWindowEvent(res); }, 0);
 }
 
 void ClientImpl::SubscribeToEvent(
     EventType event_type,
-    std::function<void(std::shared_ptr<Event>)> callback) {
+    std::function<void(std::shared_ptr<Event>)> callback, uint32_t interval) {
   EventResponse::EventCase type = ConvertEventType(event_type);
 
   if (type == EventResponse::EventCase::EVENT_NOT_SET) {
@@ -57,10 +84,36 @@ void ClientImpl::SubscribeToEvent(
     throw Error(ErrorCode::NotConnected);
   }
 
-  event_manager_->SubscribeToEvent(type,
-                                   [this, callback](EventResponse &response) {
-                                     callback(GenerateEvent(response));
-                                   });
+  // The frame events also commit the write-behind windows, so their callback
+  // is called by the client's handler at the client's interval
+  if (type == EventResponse::EventCase::kFrameEvent) {
+    std::lock_guard frame_lk(frame_mutex_);
+
+    frame_callback_ = callback;
+    frame_callback_interval_ = (uint64_t)interval * 1000;
+    last_frame_callback_time_ = 0;
+    UpdateFrameSubscription();
+    return;
+  }
+
+  // The input latencies are measured for the overlay stats, and reported
+  // after each of their events so they're in the next one
+  if (type == EventResponse::EventCase::kOverlayStatsEvent) {
+    std::lock_guard input_latencies_lk(input_latencies_mutex_);
+
+    input_latencies_measured_ = true;
+  }
+
+  event_manager_->SubscribeToEvent(
+      type,
+      [this, callback, type](EventResponse &response) {
+        callback(GenerateEvent(response));
+
+        if (type == EventResponse::EventCase::kOverlayStatsEvent) {
+          ReportInputLatencies();
+        }
+      },
+      interval);
 }
 
 void ClientImpl::UnsubscribeEvent(EventType event_type) {
@@ -70,6 +123,23 @@ void ClientImpl::UnsubscribeEvent(EventType event_type) {
     throw Error(ErrorCode::InvalidEventType);
   }
 
+  // Keep getting the frame events while they commit the write-behind windows
+  if (type == EventResponse::EventCase::kFrameEvent) {
+    std::lock_guard frame_lk(frame_mutex_);
+
+    frame_callback_ = nullptr;
+    UpdateFrameSubscription();
+    return;
+  }
+
+  // Stop measuring the input latencies that nothing reports
+  if (type == EventResponse::EventCase::kOverlayStatsEvent) {
+    std::lock_guard input_latencies_lk(input_latencies_mutex_);
+
+    input_latencies_measured_ = false;
+    input_latencies_.clear();
+  }
+
   event_manager_->UnsubscribeEvent(type);
 }
 
@@ -123,16 +193,308 @@ std::shared_ptr<WindowGroup> ClientImpl::CreateWindowGroup(
   return std::static_pointer_cast<WindowGroup>(window_group);
 }
 
+void ClientImpl::WaitForAsyncCalls() {
+  // If the client isn't connected
+  if (async_rpc_queue_ == nullptr) {
+    throw Error(ErrorCode::NotConnected);
+  }
+
+  async_rpc_queue_->Wait();
+}
+
+std::future<void> ClientImpl::Commit() {
+  std::vector<std::future<void>> futures;
+  std::exception_ptr frame_commit_error = nullptr;
+
+  // Report the failures of the frames' commits since the last commit
+  {
+    std::lock_guard frame_commits_lk(frame_commits_mutex_);
+
+    futures = std::move(frame_commit_futures_);
+    frame_commit_futures_.clear();
+    std::swap(frame_commit_error, frame_commit_error_);
+  }
+  if (frame_commit_error) {
+    std::promise<void> promise;
+
+    promise.set_exception(frame_commit_error);
+    futures.push_back(promise.get_future());
+  }
+
+  QueueCommits(futures);
+
+  return WhenAll(std::move(futures));
+}
+
+void ClientImpl::QueueCommits(std::vector<std::future<void>> &futures) {
+  std::vector<std::shared_ptr<WindowGroupImpl>> window_groups;
+
+  // Get the window groups that weren't deallocated
+  {
+    std::lock_guard window_groups_lk(window_groups_mutex_);
+
+    for (auto &[window_group_id, window_group] : window_groups_) {
+      if (std::shared_ptr<WindowGroupImpl> locked_window_group =
+              window_group.lock()) {
+        window_groups.push_back(locked_window_group);
+      }
+    }
+  }
+
+  for (auto &window_group : window_groups) {
+    window_group->QueueCommit(futures);
+  }
+}
+
+void ClientImpl::EnableFrameCommits() {
+  std::lock_guard frame_lk(frame_mutex_);
+
+  frame_committers_++;
+  UpdateFrameSubscription();
+}
+
+void ClientImpl::DisableFrameCommits() {
+  std::lock_guard frame_lk(frame_mutex_);
+
+  frame_committers_--;
+  UpdateFrameSubscription();
+}
+
+void ClientImpl::SetUploadBudget(uint64_t budget) {
+  grpc::ClientContext context;
+  SetUploadBudgetRequest request;
+  SetUploadBudgetResponse response;
+  grpc::Status status;
+
+  // If the client isn't connected
+  if (windows_stub_ == nullptr) {
+    throw Error(ErrorCode::NotConnected);
+  }
+
+  request.set_budget(budget);
+  status = windows_stub_->SetUploadBudget(&context, request, &response);
+  if (status.error_code() == grpc::StatusCode::PERMISSION_DENIED) {
+    throw Error(ErrorCode::SettingsOwnedByAnotherClient);
+  } else if (!status.ok()) {
+    throw Error(ErrorCode::UnknownError);
+  }
+}
+
+void ClientImpl::SetInputCoalesceInterval(uint32_t interval) {
+  grpc::ClientContext context;
+  SetInputCoalesceIntervalRequest request;
+  SetInputCoalesceIntervalResponse response;
+  grpc::Status status;
+
+  // If the client isn't connected
+  if (windows_stub_ == nullptr) {
+    throw Error(ErrorCode::NotConnected);
+  }
+
+  request.set_interval(interval);
+  status =
+      windows_stub_->SetInputCoalesceInterval(&context, request, &response);
+  if (status.error_code() == grpc::StatusCode::PERMISSION_DENIED) {
+    throw Error(ErrorCode::SettingsOwnedByAnotherClient);
+  } else if (!status.ok()) {
+    throw Error(ErrorCode::UnknownError);
+  }
+}
+
+void ClientImpl::RegisterHotkey(uint32_t id, uint8_t virtual_key,
+                                HotkeyModifiers modifiers, bool block) {
+  grpc::ClientContext context;
+  RegisterHotkeyRequest request;
+  RegisterHotkeyResponse response;
+
+  // If the client isn't connected
+  if (windows_stub_ == nullptr) {
+    throw Error(ErrorCode::NotConnected);
+  }
+
+  // Verify the hotkey
+  if (!virtual_key ||
+      ((uint32_t)modifiers &
+       ~(uint32_t)(HotkeyModifiers::Alt | HotkeyModifiers::Control |
+                   HotkeyModifiers::Shift | HotkeyModifiers::Win))) {
+    throw Error(ErrorCode::InvalidHotkey);
+  }
+
+  request.set_id(id);
+  request.set_virtual_key(virtual_key);
+  request.set_modifiers((uint32_t)modifiers);
+  request.set_block(block);
+  if (!windows_stub_->RegisterHotkey(&context, request, &response).ok()) {
+    throw Error(ErrorCode::InvalidHotkey);
+  }
+}
+
+void ClientImpl::UnregisterHotkey(uint32_t id) {
+  grpc::ClientContext context;
+  UnregisterHotkeyRequest request;
+  UnregisterHotkeyResponse response;
+
+  // If the client isn't connected
+  if (windows_stub_ == nullptr) {
+    throw Error(ErrorCode::NotConnected);
+  }
+
+  request.set_id(id);
+  if (!windows_stub_->UnregisterHotkey(&context, request, &response).ok()) {
+    throw Error(ErrorCode::InvalidHotkey);
+  }
+}
+
+double ClientImpl::Ping() {
+  PingRequest request;
+  PingResponse response;
+  uint64_t send_time = 0;
+
+  // If the client isn't connected
+  if (event_manager_ == nullptr) {
+    throw Error(ErrorCode::NotConnected);
+  }
+
+  send_time = utils::timestamp::GetTimestamp();
+  if (!event_manager_->Ping(request, response).ok()) {
+    throw Error(ErrorCode::UnknownError);
+  }
+
+  return (utils::timestamp::GetTimestamp() - send_time) / 1000.0;
+}
+
+void ClientImpl::StartTracing() {
+  grpc::ClientContext context;
+  StartTracingRequest request;
+  StartTracingResponse response;
+
+  // If the client isn't connected
+  if (tracing_stub_ == nullptr) {
+    throw Error(ErrorCode::NotConnected);
+  }
+
+  if (!tracing_stub_->StartTracing(&context, request, &response).ok()) {
+    throw Error(ErrorCode::TracingFailed);
+  }
+}
+
+void ClientImpl::StopTracing(const std::string &path) {
+  grpc::ClientContext context;
+  StopTracingRequest request;
+  StopTracingResponse response;
+  std::unique_ptr<grpc::ClientReader<StopTracingResponse>> reader = nullptr;
+  std::ofstream file;
+
+  // If the client isn't connected
+  if (tracing_stub_ == nullptr) {
+    throw Error(ErrorCode::NotConnected);
+  }
+
+  file.open(path, std::ios::out | std::ios::binary | std::ios::trunc);
+  if (!file) {
+    throw Error(ErrorCode::TracingFailed);
+  }
+
+  // Save the chunks of the trace as they're received
+  reader = tracing_stub_->StopTracing(&context, request);
+  while (reader->Read(&response)) {
+    file.write(response.trace().data(), response.trace().size());
+  }
+
+  if (!reader->Finish().ok() || !file.good()) {
+    throw Error(ErrorCode::TracingFailed);
+  }
+}
+
+void ClientImpl::StartInputRecording() {
+  grpc::ClientContext context;
+  StartInputRecordingRequest request;
+  StartInputRecordingResponse response;
+
+  // If the client isn't connected
+  if (tracing_stub_ == nullptr) {
+    throw Error(ErrorCode::NotConnected);
+  }
+
+  if (!tracing_stub_->StartInputRecording(&context, request, &response)
+           .ok()) {
+    throw Error(ErrorCode::InputRecordingFailed);
+  }
+}
+
+void ClientImpl::StopInputRecording(const std::string &path) {
+  grpc::ClientContext context;
+  StopInputRecordingRequest request;
+  StopInputRecordingResponse response;
+  std::unique_ptr<grpc::ClientReader<StopInputRecordingResponse>> reader =
+      nullptr;
+  std::ofstream file;
+
+  // If the client isn't connected
+  if (tracing_stub_ == nullptr) {
+    throw Error(ErrorCode::NotConnected);
+  }
+
+  file.open(path, std::ios::out | std::ios::binary | std::ios::trunc);
+  if (!file) {
+    throw Error(ErrorCode::InputRecordingFailed);
+  }
+
+  // Save the chunks of the recording as they're received
+  reader = tracing_stub_->StopInputRecording(&context, request);
+  while (reader->Read(&response)) {
+    file.write(response.recording().data(), response.recording().size());
+  }
+
+  if (!reader->Finish().ok() || !file.good()) {
+    throw Error(ErrorCode::InputRecordingFailed);
+  }
+}
+
+std::string ClientImpl::CaptureOverlay(uint32_t &width, uint32_t &height) {
+  grpc::ClientContext context;
+  CaptureOverlayRequest request;
+  CaptureOverlayResponse response;
+  std::unique_ptr<grpc::ClientReader<CaptureOverlayResponse>> reader = nullptr;
+  std::string buffer;
+
+  // If the client isn't connected
+  if (tracing_stub_ == nullptr) {
+    throw Error(ErrorCode::NotConnected);
+  }
+
+  // Join the chunks of the buffer as they're received
+  request.set_width(width);
+  request.set_height(height);
+  reader = tracing_stub_->CaptureOverlay(&context, request);
+  while (reader->Read(&response)) {
+    width = response.width();
+    height = response.height();
+    buffer.append(response.buffer());
+  }
+
+  if (!reader->Finish().ok() ||
+      buffer.size() != (size_t)width * height * sizeof(uint32_t)) {
+    throw Error(ErrorCode::CaptureFailed);
+  }
+
+  return buffer;
+}
+
 AuthenticateResponse ClientImpl::GetAuthInfo() const {
   AuthenticateResponse res;
 
-  HANDLE pipe =
-      CreateFileA(utils::token::GeneratePipeName(overlay_pid_).c_str(),
-                  GENERIC_READ, 0, NULL, OPEN_EXISTING, 0, NULL);
+  std::string pipe_name = utils::token::GeneratePipeName(overlay_pid_);
+  HANDLE pipe = INVALID_HANDLE_VALUE;
   DWORD read = 0;
 
-  if (!pipe) {
-    throw Error(ErrorCode::ProcessNotFound);
+  // Wait for a free pipe instance if all of them are busy with other clients
+  while ((pipe = CreateFileA(pipe_name.c_str(), GENERIC_READ, 0, NULL,
+                             OPEN_EXISTING, 0, NULL)) == INVALID_HANDLE_VALUE) {
+    if (GetLastError() != ERROR_PIPE_BUSY ||
+        !WaitNamedPipeA(pipe_name.c_str(), TOKEN_PIPE_WAIT_TIMEOUT)) {
+      throw Error(ErrorCode::ProcessNotFound);
+    }
   }
 
   // Read the authenticate response from the server
@@ -157,12 +519,8 @@ std::shared_ptr<grpc::Channel> ClientImpl::ConnectToServerChannel() const {
 
   AuthenticateResponse auth = GetAuthInfo();
 
-  grpc::SslCredentialsOptions ssl_options;
-  ssl_options.pem_root_certs = auth.server_certificate;
-
   // Create channel
-  channel = grpc::CreateChannel(FormatServerUrl(auth.rpc_server_port),
-                                grpc::SslCredentials(ssl_options));
+  channel = CreateServerChannel(auth, std::string());
 
   // Create authentication stub
   auth_stub = Authentication::NewStub(channel);
@@ -175,7 +533,42 @@ std::shared_ptr<grpc::Channel> ClientImpl::ConnectToServerChannel() const {
     throw Error(ErrorCode::AuthFailed);
   }
 
-  return channel;
+  // Create a channel that attaches the session of the client to every call
+  return CreateServerChannel(auth, token_auth_res.session_id());
+}
+
+std::shared_ptr<grpc::Channel> ClientImpl::CreateServerChannel(
+    const AuthenticateResponse &auth, std::string session_id) const {
+  std::vector<
+      std::unique_ptr<grpc::experimental::ClientInterceptorFactoryInterface>>
+      interceptor_creators;
+
+  grpc::SslCredentialsOptions ssl_options;
+
+  // Add session interceptor factory to interceptors
+  if (!session_id.empty()) {
+    interceptor_creators.push_back(
+        std::unique_ptr<grpc::experimental::ClientInterceptorFactoryInterface>(
+            new SessionInterceptorFactory(session_id)));
+  }
+
+  // Connect to the local socket of the server without TLS
+  if (transport_ == ClientTransport::Local) {
+    if (auth.local_socket_path[0] == '\0') {
+      throw Error(ErrorCode::LocalTransportUnavailable);
+    }
+
+    return grpc::experimental::CreateCustomChannelWithInterceptors(
+        std::string("unix:") + auth.local_socket_path,
+        grpc::InsecureChannelCredentials(), grpc::ChannelArguments(),
+        std::move(interceptor_creators));
+  }
+
+  ssl_options.pem_root_certs = auth.server_certificate;
+
+  return grpc::experimental::CreateCustomChannelWithInterceptors(
+      FormatServerUrl(auth.rpc_server_port), grpc::SslCredentials(ssl_options),
+      grpc::ChannelArguments(), std::move(interceptor_creators));
 }
 
 std::string ClientImpl::FormatServerUrl(uint16_t port) const {
@@ -191,6 +584,18 @@ EventResponse::EventCase ClientImpl::ConvertEventType(EventType type) const {
     case EventType::ApplicationStats:
       return EventResponse::EventCase::kApplicationStatsEvent;
 
+    case EventType::OverlayStats:
+      return EventResponse::EventCase::kOverlayStatsEvent;
+
+    case EventType::Frame:
+      return EventResponse::EventCase::kFrameEvent;
+
+    case EventType::RawMouseInput:
+      return EventResponse::EventCase::kRawMouseInputEvent;
+
+    case EventType::Hotkey:
+      return EventResponse::EventCase::kHotkeyEvent;
+
     default:
       return EventResponse::EventCase::EVENT_NOT_SET;
   }
@@ -199,13 +604,62 @@ EventResponse::EventCase ClientImpl::ConvertEventType(EventType type) const {
 std::shared_ptr<Event> ClientImpl::GenerateEvent(
     EventResponse &response) const {
   switch (response.event_case()) {
-    case EventResponse::EventCase::kApplicationStatsEvent:
+    case EventResponse::EventCase::kApplicationStatsEvent: {
+      const EventResponse::ApplicationStatsEvent &stats =
+          response.applicationstatsevent();
+
       return std::shared_ptr<Event>(new ApplicationStatsEvent(
-          response.applicationstatsevent().width(),
-          response.applicationstatsevent().height(),
-          response.applicationstatsevent().fullscreen(),
-          response.applicationstatsevent().frametime(),
-          response.applicationstatsevent().fps()));
+          stats.width(), stats.height(), stats.fullscreen(),
+          stats.frametime(), stats.fps(), stats.frametimep50(),
+          stats.frametimep95(), stats.frametimep99(), stats.frametimemax(),
+          stats.onepercentlowfps(),
+          std::vector<double>(stats.frametimehistogrambounds().begin(),
+                              stats.frametimehistogrambounds().end()),
+          std::vector<uint32_t>(stats.frametimehistogram().begin(),
+                                stats.frametimehistogram().end())));
+    }
+
+    case EventResponse::EventCase::kOverlayStatsEvent: {
+      const EventResponse::OverlayStatsEvent &stats =
+          response.overlaystatsevent();
+
+      return std::shared_ptr<Event>(new OverlayStatsEvent(
+          stats.frames(), stats.framesoverbudget(), stats.budget(),
+          stats.rendertime(), stats.rendertimemax(), stats.snapshottime(),
+          stats.texturecreationtime(), stats.uploadtime(), stats.drawtime(),
+          stats.uploadedbytes(), stats.createdtextures(), stats.drawnsprites(),
+          stats.inputevents(), stats.inputlatencyp50(),
+          stats.inputlatencyp95(), stats.inputlatencyp99(),
+          stats.inputlatencymax()));
+    }
+
+    case EventResponse::EventCase::kFrameEvent: {
+      const EventResponse::FrameEvent &frame = response.frameevent();
+
+      return std::shared_ptr<Event>(new FrameEvent(
+          frame.frame(), frame.presenttime(), frame.nextvsynctime(),
+          frame.frameinterval(), frame.occluded()));
+    }
+
+    case EventResponse::EventCase::kRawMouseInputEvent: {
+      std::vector<RawMouseInputSample> samples;
+
+      samples.reserve(response.rawmouseinputevent().samples_size());
+      for (auto &sample : response.rawmouseinputevent().samples()) {
+        samples.push_back({sample.deltax(), sample.deltay(), sample.absolute(),
+                           sample.buttonflags(), sample.wheeldelta(),
+                           sample.horizontalwheeldelta(), sample.timestamp()});
+      }
+
+      return std::shared_ptr<Event>(new RawMouseInputEvent(samples));
+    }
+
+    case EventResponse::EventCase::kHotkeyEvent: {
+      const EventResponse::HotkeyEvent &hotkey = response.hotkeyevent();
+
+      return std::shared_ptr<Event>(new HotkeyEvent(
+          hotkey.id(), hotkey.messagetime(), hotkey.capturetime()));
+    }
 
     default:
       return nullptr;
@@ -247,12 +701,177 @@ void ClientImpl::HandleWindowEvent(EventResponse &response) {
     return;
   }
 
+  RecordInputLatency(window_event);
   window->HandleWindowEvent(window_event);
 }
 
+void ClientImpl::HandleFrameEvent(EventResponse &response) {
+  std::function<void(std::shared_ptr<Event>)> frame_callback = nullptr;
+  std::vector<std::future<void>> futures;
+  uint64_t present_time = response.frameevent().presenttime();
+  bool commit = false;
+
+  {
+    std::lock_guard frame_lk(frame_mutex_);
+
+    commit = frame_committers_ > 0;
+
+    // Call the client's callback at most once in its interval
+    if (frame_callback_ &&
+        present_time - last_frame_callback_time_ >= frame_callback_interval_) {
+      frame_callback = frame_callback_;
+      last_frame_callback_time_ = present_time;
+    }
+  }
+
+  // Send the properties that changed since the last frame without waiting
+  // for them, their failures are thrown by the next explicit commit
+  if (commit) {
+    QueueCommits(futures);
+
+    std::lock_guard frame_commits_lk(frame_commits_mutex_);
+
+    CollectFrameCommits();
+    for (std::future<void> &future : futures) {
+      frame_commit_futures_.push_back(std::move(future));
+    }
+  }
+
+  if (frame_callback) {
+    frame_callback(GenerateEvent(response));
+  }
+}
+
+void ClientImpl::UpdateFrameSubscription() {
+  bool subscribe = frame_callback_ != nullptr || frame_committers_ > 0;
+
+  if (subscribe == frame_subscribed_) {
+    return;
+  }
+
+  // Get every frame so each of them commits the write-behind windows
+  if (subscribe) {
+    event_manager_->SubscribeToEvent(
+        EventResponse::EventCase::kFrameEvent,
+        [this](EventResponse &response) { HandleFrameEvent(response); }, 0);
+  } else {
+    event_manager_->UnsubscribeEvent(EventResponse::EventCase::kFrameEvent);
+  }
+
+  frame_subscribed_ = subscribe;
+}
+
+void ClientImpl::CollectFrameCommits() {
+  auto future = frame_commit_futures_.begin();
+
+  // Drop the commits that completed, keeping the first failure
+  while (future != frame_commit_futures_.end()) {
+    if (future->wait_for(std::chrono::seconds(0)) !=
+        std::future_status::ready) {
+      future++;
+      continue;
+    }
+
+    try {
+      future->get();
+    } catch (...) {
+      if (!frame_commit_error_) {
+        frame_commit_error_ = std::current_exception();
+      }
+    }
+
+    future = frame_commit_futures_.erase(future);
+  }
+}
+
+void ClientImpl::RecordInputLatency(
+    const EventResponse::WindowEvent &window_event) {
+  uint64_t capture_time = 0, timestamp = 0;
+
+  switch (window_event.event_case()) {
+    case EventResponse::WindowEvent::EventCase::kKeyboardInputEvent:
+      capture_time = window_event.keyboardinputevent().capturetime();
+      break;
+
+    case EventResponse::WindowEvent::EventCase::kMouseInputEvent:
+      capture_time = window_event.mouseinputevent().capturetime();
+      break;
+
+    default:
+      return;
+  }
+
+  // The performance counter is shared with the overlay's process
+  timestamp = utils::timestamp::GetTimestamp();
+  if (!capture_time || timestamp < capture_time) {
+    return;
+  }
+
+  std::unique_lock input_latencies_lk(input_latencies_mutex_);
+
+  if (!input_latencies_measured_) {
+    return;
+  }
+
+  input_latencies_.push_back(
+      (uint32_t)std::min<uint64_t>(timestamp - capture_time, UINT32_MAX));
+
+  // Report a full batch without waiting for the next overlay stats event
+  if (input_latencies_.size() >= MAX_PENDING_INPUT_LATENCIES) {
+    input_latencies_lk.unlock();
+    ReportInputLatencies();
+  }
+}
+
+void ClientImpl::ReportInputLatencies() {
+  PingRequest request;
+  Events::Stub *stub = events_stub_.get();
+
+  {
+    std::lock_guard input_latencies_lk(input_latencies_mutex_);
+
+    if (input_latencies_.empty()) {
+      return;
+    }
+
+    request.mutable_inputlatencies()->Add(input_latencies_.begin(),
+                                          input_latencies_.end());
+    input_latencies_.clear();
+  }
+
+  // The reports don't block the events' thread, and they're sent in order
+  // under the null key that no window or window group uses
+  async_rpc_queue_->Call<PingRequest, PingResponse>(
+      GUID_NULL, std::move(request),
+      [stub](grpc::ClientContext *context, const PingRequest &request,
+             grpc::CompletionQueue *completion_queue) {
+        return stub->PrepareAsyncPing(context, request, completion_queue);
+      });
+}
+
 std::unique_ptr<Windows::Stub> &ClientImpl::get_windows_stub() {
   return windows_stub_;
 }
 
+std::unique_ptr<AsyncRpcQueue> &ClientImpl::get_async_rpc_queue() {
+  return async_rpc_queue_;
+}
+
+std::shared_ptr<BufferStream> ClientImpl::GetBufferStream() {
+  std::lock_guard buffer_stream_lk(buffer_stream_mutex_);
+
+  // If the client isn't connected
+  if (windows_stub_ == nullptr) {
+    throw Error(ErrorCode::NotConnected);
+  }
+
+  // Open a new stream if there isn't one or the last one was closed
+  if (buffer_stream_ == nullptr || buffer_stream_->is_broken()) {
+    buffer_stream_ = std::make_shared<BufferStream>(windows_stub_.get());
+  }
+
+  return buffer_stream_;
+}
+
 }  // namespace helper
 }  // namespace overlay
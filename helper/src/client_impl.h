@@ -3,17 +3,26 @@
 #include <overlay/client.h>
 #include <windows.h>
 
+#include <exception>
+#include <functional>
+#include <future>
 #include <memory>
 #include <mutex>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
+#include "async_rpc_queue.h"
 #include "authenticate_response.h"
+#include "buffer_stream.h"
 #include "event_manager.h"
 #include "utils/guid.h"
 #include "window_group_impl.h"
+#include "tracing.grpc.pb.h"
 #include "windows.grpc.pb.h"
 
+#define MAX_PENDING_INPUT_LATENCIES 4096
+
 namespace overlay {
 namespace helper {
 
@@ -21,33 +30,95 @@ class ClientImpl : public Client,
                    public std::enable_shared_from_this<ClientImpl> {
  public:
   ClientImpl() = delete;
-  ClientImpl(DWORD process_id);
+  ClientImpl(DWORD process_id, ClientTransport transport);
 
   virtual void Connect();
 
   virtual void SubscribeToEvent(
       EventType event_type,
-      std::function<void(std::shared_ptr<Event>)> callback);
+      std::function<void(std::shared_ptr<Event>)> callback,
+      uint32_t interval = 0);
   virtual void UnsubscribeEvent(EventType event_type);
 
   virtual std::shared_ptr<WindowGroup> CreateWindowGroup(
       const WindowGroupAttributes attributes);
 
+  virtual void WaitForAsyncCalls();
+  virtual std::future<void> Commit();
+
+  virtual void SetUploadBudget(uint64_t budget);
+  virtual void SetInputCoalesceInterval(uint32_t interval);
+
+  virtual void RegisterHotkey(uint32_t id, uint8_t virtual_key,
+                              HotkeyModifiers modifiers, bool block);
+  virtual void UnregisterHotkey(uint32_t id);
+
+  virtual double Ping();
+
+  virtual void StartTracing();
+  virtual void StopTracing(const std::string &path);
+
+  virtual void StartInputRecording();
+  virtual void StopInputRecording(const std::string &path);
+
+  virtual std::string CaptureOverlay(uint32_t &width, uint32_t &height);
+
   std::unique_ptr<Windows::Stub> &get_windows_stub();
+  std::unique_ptr<AsyncRpcQueue> &get_async_rpc_queue();
+  std::shared_ptr<BufferStream> GetBufferStream();
+
+  // Commits the write-behind windows on each of the game's frames while any
+  // window or window group is in the write-behind mode
+  void EnableFrameCommits();
+  void DisableFrameCommits();
 
  private:
   DWORD overlay_pid_;
+  ClientTransport transport_;
 
   std::shared_ptr<grpc::Channel> channel_;
   std::unique_ptr<Windows::Stub> windows_stub_;
+  std::unique_ptr<Tracing::Stub> tracing_stub_;
+  std::unique_ptr<Events::Stub> events_stub_;  // For the async reports
+
+  // Destroyed before the stubs, after its RPCs complete
+  std::unique_ptr<AsyncRpcQueue> async_rpc_queue_;
+
+  std::shared_ptr<BufferStream> buffer_stream_;
+  std::mutex buffer_stream_mutex_;
+
+  // The frame events are subscribed to with no interval while the client's
+  // callback or the write-behind objects need them, the client's interval is
+  // applied to its callback
+  std::function<void(std::shared_ptr<Event>)> frame_callback_;
+  uint64_t frame_callback_interval_;
+  uint64_t last_frame_callback_time_;
+  uint32_t frame_committers_;
+  bool frame_subscribed_;
+  std::mutex frame_mutex_;
+
+  // The futures of the frames' commits, their first failure is thrown by the
+  // next explicit commit
+  std::vector<std::future<void>> frame_commit_futures_;
+  std::exception_ptr frame_commit_error_;
+  std::mutex frame_commits_mutex_;
 
   std::unique_ptr<EventManager> event_manager_;
 
+  // Microseconds from capturing each input event to handling it, measured
+  // while the overlay stats are subscribed to and reported after each of
+  // their events
+  std::vector<uint32_t> input_latencies_;
+  bool input_latencies_measured_;
+  std::mutex input_latencies_mutex_;
+
   std::unordered_map<GUID, std::weak_ptr<WindowGroupImpl>> window_groups_;
   std::mutex window_groups_mutex_;
 
   AuthenticateResponse GetAuthInfo() const;
   std::shared_ptr<grpc::Channel> ConnectToServerChannel() const;
+  std::shared_ptr<grpc::Channel> CreateServerChannel(
+      const AuthenticateResponse &auth, std::string session_id) const;
 
   std::string FormatServerUrl(uint16_t port) const;
 
@@ -55,6 +126,14 @@ class ClientImpl : public Client,
   std::shared_ptr<Event> GenerateEvent(EventResponse &response) const;
 
   void HandleWindowEvent(EventResponse &response);
+  // Queues the commits of all the window groups and adds their futures
+  void QueueCommits(std::vector<std::future<void>> &futures);
+
+  void HandleFrameEvent(EventResponse &response);
+  void UpdateFrameSubscription();
+  void CollectFrameCommits();
+  void RecordInputLatency(const EventResponse::WindowEvent &window_event);
+  void ReportInputLatencies();
 };
 
 }  // namespace helper
@@ -45,6 +45,28 @@ std::string GetErrorCodeDescription(ErrorCode code) {
     case ErrorCode::InvalidCursor:
       return "The cursor type entered is invalid";
 
+    case ErrorCode::InvalidBufferEncoding:
+      return "The buffer encoding entered is invalid";
+
+    case ErrorCode::LocalTransportUnavailable:
+      return "The overlay doesn't support the local transport";
+
+    case ErrorCode::TracingFailed:
+      return "The overlay was unable to start or save the trace";
+
+    case ErrorCode::InputRecordingFailed:
+      return "The overlay was unable to record the input";
+
+    case ErrorCode::InvalidHotkey:
+      return "The hotkey is invalid or isn't registered, or the client isn't "
+             "subscribed to the hotkey events";
+
+    case ErrorCode::CaptureFailed:
+      return "The overlay was unable to capture its windows";
+
+    case ErrorCode::SettingsOwnedByAnotherClient:
+      return "Another client owns the overlay's settings";
+
     default:
     case ErrorCode::UnknownError:
       return "Unknown Error";
@@ -33,6 +33,15 @@ void EventManager::StartHandlingAsyncRpcs() {
 }
 
 void EventManager::HandleEvent(EventResponse &response) {
+  // Handle the events of a batch in the order they were sent
+  if (response.event_case() == EventResponse::EventCase::kEventBatch) {
+    for (auto &event : *response.mutable_eventbatch()->mutable_events()) {
+      HandleEvent(event);
+    }
+
+    return;
+  }
+
   std::unique_lock handlers_lk(event_handlers_mutex_);
 
   std::function<void(EventResponse &)> handler = nullptr;
@@ -49,12 +58,13 @@ void EventManager::HandleEvent(EventResponse &response) {
 
 void EventManager::SubscribeToEvent(
     EventResponse::EventCase event_type,
-    std::function<void(EventResponse &)> handler) {
+    std::function<void(EventResponse &)> handler, uint32_t interval) {
   EventSubscribeRequest request;
 
   std::lock_guard handlers_lk(event_handlers_mutex_);
 
   request.set_type(event_type);
+  request.set_interval(interval);
 
   // If there isn't a reader for the event, create one
   if (!event_handlers_.count(event_type)) {
@@ -80,6 +90,13 @@ void EventManager::UnsubscribeEvent(EventResponse::EventCase event_type) {
   }
 }
 
+grpc::Status EventManager::Ping(const PingRequest &request,
+                                PingResponse &response) {
+  grpc::ClientContext context;
+
+  return events_stub_->Ping(&context, request, &response);
+}
+
 AsyncEventListenerWorker::AsyncEventListenerWorker(
     EventManager *event_manager, Events::Stub *stub,
     grpc::CompletionQueue *completion_queue, EventSubscribeRequest &request)
@@ -24,9 +24,12 @@ class EventManager {
   void HandleEvent(EventResponse &response);
 
   void SubscribeToEvent(EventResponse::EventCase event_type,
-                        std::function<void(EventResponse &)> handler);
+                        std::function<void(EventResponse &)> handler,
+                        uint32_t interval);
   void UnsubscribeEvent(EventResponse::EventCase event_type);
 
+  grpc::Status Ping(const PingRequest &request, PingResponse &response);
+
  private:
   std::unique_ptr<Events::Stub> events_stub_;
 
@@ -0,0 +1,25 @@
+#include "session_interceptor.h"
+
+#include "utils/token.h"
+
+namespace overlay {
+namespace helper {
+
+SessionInterceptor::SessionInterceptor(std::string session_id)
+    : session_id_(session_id) {}
+
+void SessionInterceptor::Intercept(
+    grpc::experimental::InterceptorBatchMethods* methods) {
+  // Attach the session of the client to every call
+  if (methods->QueryInterceptionHookPoint(
+          grpc::experimental::InterceptionHookPoints::
+              PRE_SEND_INITIAL_METADATA)) {
+    methods->GetSendInitialMetadata()->insert(
+        std::make_pair(SESSION_METADATA_KEY, session_id_));
+  }
+
+  methods->Proceed();
+}
+
+}  // namespace helper
+}  // namespace overlay
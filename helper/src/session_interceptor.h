@@ -0,0 +1,36 @@
+#pragma once
+
+#include <grpcpp/support/client_interceptor.h>
+
+#include <string>
+
+namespace overlay {
+namespace helper {
+
+class SessionInterceptor : public grpc::experimental::Interceptor {
+ public:
+  SessionInterceptor(std::string session_id);
+
+  void Intercept(grpc::experimental::InterceptorBatchMethods* methods);
+
+ private:
+  std::string session_id_;
+};
+
+class SessionInterceptorFactory
+    : public grpc::experimental::ClientInterceptorFactoryInterface {
+ public:
+  SessionInterceptorFactory(std::string session_id)
+      : session_id_(session_id) {}
+
+  grpc::experimental::Interceptor* CreateClientInterceptor(
+      grpc::experimental::ClientRpcInfo* info) {
+    return new SessionInterceptor(session_id_);
+  }
+
+ private:
+  std::string session_id_;
+};
+
+}  // namespace helper
+}  // namespace overlay
@@ -4,7 +4,11 @@
 #include <overlay/error.h>
 
 #include <cstdint>
+#include <future>
+#include <string>
+#include <vector>
 
+#include "async_rpc_queue.h"
 #include "client_impl.h"
 #include "windows.grpc.pb.h"
 
@@ -15,58 +19,137 @@ WindowGroup::~WindowGroup() {}
 
 WindowGroupImpl::WindowGroupImpl(std::weak_ptr<ClientImpl> client, GUID id,
                                  const WindowGroupAttributes attributes)
-    : client_(client), id_(id), attributes_(attributes) {}
+    : client_(client),
+      id_(id),
+      attributes_(attributes),
+      applied_attributes_(attributes),
+      pending_attributes_calls_(0),
+      write_behind_(false),
+      attributes_changed_(false) {}
 
-void WindowGroupImpl::SetAttributes(const WindowGroupAttributes attributes) {
-  grpc::ClientContext context;
-  UpdateWindowGroupPropertiesRequest request;
-  UpdateWindowGroupPropertiesResponse response;
-
-  WindowGroupProperties* properties = nullptr;
-
-  std::shared_ptr<ClientImpl> client = client_.lock();
-  if (!client) {
-    throw Error(ErrorCode::ClientObjectDeallocated);
+WindowGroupImpl::~WindowGroupImpl() {
+  // Stop committing on each frame for the window group
+  if (write_behind_) {
+    if (std::shared_ptr<ClientImpl> client = client_.lock()) {
+      client->DisableFrameCommits();
+    }
   }
+}
+
+void WindowGroupImpl::SetAttributes(const WindowGroupAttributes attributes) {
+  SetAttributesAsync(attributes).get();
+}
 
+std::future<void> WindowGroupImpl::SetAttributesAsync(
+    const WindowGroupAttributes attributes) {
   // Verify attributes
   if (attributes.opacity < 0 || attributes.opacity > 1 ||
       attributes.buffer_opacity < 0 || attributes.buffer_opacity > 1) {
     throw Error(ErrorCode::InvalidAttributes);
   }
 
-  // Try to update the window group properties
-  properties = request.mutable_properties();
-  properties->set_z(attributes.z);
-  properties->set_opacity(attributes.opacity);
-  properties->set_hidden(attributes.hidden);
-  properties->set_has_buffer(attributes.has_buffer);
-  properties->set_buffer_color(attributes.buffer_color);
-  properties->set_buffer_opacity(attributes.buffer_opacity);
-  request.set_group_id((const char*)&id_, sizeof(id_));
-  if (!client->get_windows_stub()
-           ->UpdateWindowGroupProperties(&context, request, &response)
-           .ok()) {
-    throw Error(ErrorCode::UnknownError);
-  }
+  std::lock_guard write_behind_lk(write_behind_mutex_);
 
   // Set the new attributes
   attributes_ = attributes;
+
+  // Hold the attributes until the window group is committed
+  if (write_behind_) {
+    attributes_changed_ = true;
+    return MakeReadyFuture();
+  }
+
+  // Send the attributes while locked, so they're queued after the older ones
+  return SendAttributes(attributes);
 }
 
 const WindowGroupAttributes WindowGroupImpl::GetAttributes() const {
   return attributes_;
 }
 
+void WindowGroupImpl::SetWriteBehind(bool write_behind) {
+  std::future<void> future;
+
+  std::shared_ptr<ClientImpl> client = client_.lock();
+  if (!client) {
+    throw Error(ErrorCode::ClientObjectDeallocated);
+  }
+
+  std::unique_lock write_behind_lk(write_behind_mutex_);
+
+  // Let the client commit the window group on each frame while it's
+  // write-behind
+  if (write_behind_.exchange(write_behind) != write_behind) {
+    if (write_behind) {
+      client->EnableFrameCommits();
+    } else {
+      client->DisableFrameCommits();
+    }
+  }
+
+  // Send the held attributes when leaving the write-behind mode
+  if (!write_behind && attributes_changed_) {
+    future = SendAttributes(attributes_);
+    attributes_changed_ = false;
+  }
+  write_behind_lk.unlock();
+
+  // Wait for the held attributes like the other setters
+  if (future.valid()) {
+    future.get();
+  }
+}
+
+bool WindowGroupImpl::IsWriteBehind() const { return write_behind_; }
+
+std::future<void> WindowGroupImpl::Commit() {
+  std::vector<std::future<void>> futures;
+
+  QueueCommit(futures);
+
+  return WhenAll(std::move(futures));
+}
+
+void WindowGroupImpl::QueueCommit(std::vector<std::future<void>>& futures) {
+  std::vector<std::shared_ptr<WindowImpl>> windows;
+
+  std::unique_lock write_behind_lk(write_behind_mutex_);
+
+  // Send the group's attributes before its windows' properties
+  if (attributes_changed_) {
+    futures.push_back(SendAttributes(attributes_));
+    attributes_changed_ = false;
+  }
+  write_behind_lk.unlock();
+
+  // Get the windows of the group that weren't deallocated
+  {
+    std::lock_guard windows_lk(windows_mutex_);
+
+    for (auto& [window_id, window] : windows_) {
+      if (std::shared_ptr<WindowImpl> locked_window = window.lock()) {
+        windows.push_back(locked_window);
+      }
+    }
+  }
+
+  for (auto& window : windows) {
+    window->QueueCommit(futures);
+  }
+}
+
 std::shared_ptr<Window> WindowGroupImpl::CreateNewWindow(
     const Rect rect, const WindowAttributes attributes) {
-  std::shared_ptr<WindowImpl> window = nullptr;
+  return CreateNewWindowAsync(rect, attributes).get();
+}
 
-  GUID window_id;
+std::future<std::shared_ptr<Window>> WindowGroupImpl::CreateNewWindowAsync(
+    const Rect rect, const WindowAttributes attributes) {
+  std::shared_ptr<std::promise<std::shared_ptr<Window>>> promise =
+      std::make_shared<std::promise<std::shared_ptr<Window>>>();
+  std::shared_ptr<WindowGroupImpl> window_group = shared_from_this();
 
-  grpc::ClientContext context;
   CreateWindowRequest request;
-  CreateWindowResponse response;
 
   WindowRect* window_rect = nullptr;
   WindowProperties* properties = nullptr;
@@ -81,6 +164,8 @@ std::shared_ptr<Window> WindowGroupImpl::CreateNewWindow(
     throw Error(ErrorCode::InvalidAttributes);
   }
 
+  Windows::Stub* stub = client->get_windows_stub().get();
+
   // Try to create the new window
   properties = request.mutable_properties();
   window_rect = request.mutable_rect();
@@ -91,15 +176,39 @@ std::shared_ptr<Window> WindowGroupImpl::CreateNewWindow(
   window_rect->set_x(rect.x);
   window_rect->set_y(rect.y);
   request.set_group_id((const char*)&id_, sizeof(id_));
-  if (!client->get_windows_stub()
-           ->CreateWindowInGroup(&context, request, &response)
-           .ok() ||
-      response.id().size() != sizeof(window_id)) {
-    throw Error(ErrorCode::UnknownError);
-  }
+  client->get_async_rpc_queue()
+      ->Call<CreateWindowRequest, CreateWindowResponse>(
+          id_, std::move(request),
+          [stub](grpc::ClientContext* context,
+                 const CreateWindowRequest& request,
+                 grpc::CompletionQueue* completion_queue) {
+            return stub->PrepareAsyncCreateWindowInGroup(context, request,
+                                                         completion_queue);
+          },
+          [promise, window_group, rect, attributes](
+              const grpc::Status& status, CreateWindowResponse& response) {
+            if (!status.ok() || response.id().size() != sizeof(GUID)) {
+              promise->set_exception(
+                  std::make_exception_ptr(Error(ErrorCode::UnknownError)));
+              return;
+            }
+
+            promise->set_value(
+                window_group->AddWindow(response.id(), rect, attributes));
+          });
+
+  return promise->get_future();
+}
+
+std::shared_ptr<Window> WindowGroupImpl::AddWindow(
+    const std::string& id, const Rect rect,
+    const WindowAttributes attributes) {
+  std::shared_ptr<WindowImpl> window = nullptr;
+
+  GUID window_id;
 
   // Copy the window id
-  std::memcpy(&window_id, response.id().data(), sizeof(window_id));
+  std::memcpy(&window_id, id.data(), sizeof(window_id));
 
   window = std::make_shared<WindowImpl>(client_, shared_from_this(), window_id,
                                         id_, rect, attributes);
@@ -112,6 +221,63 @@ std::shared_ptr<Window> WindowGroupImpl::CreateNewWindow(
   return std::static_pointer_cast<Window>(window);
 }
 
+std::future<void> WindowGroupImpl::SendAttributes(
+    const WindowGroupAttributes& attributes) {
+  UpdateWindowGroupPropertiesRequest request;
+
+  WindowGroupProperties* properties = nullptr;
+
+  std::shared_ptr<ClientImpl> client = client_.lock();
+  if (!client) {
+    throw Error(ErrorCode::ClientObjectDeallocated);
+  }
+
+  Windows::Stub* stub = client->get_windows_stub().get();
+
+  // Try to update the window group properties after the group's previous
+  // calls
+  properties = request.mutable_properties();
+  properties->set_z(attributes.z);
+  properties->set_opacity(attributes.opacity);
+  properties->set_hidden(attributes.hidden);
+  properties->set_has_buffer(attributes.has_buffer);
+  properties->set_buffer_color(attributes.buffer_color);
+  properties->set_buffer_opacity(attributes.buffer_opacity);
+  request.set_group_id((const char*)&id_, sizeof(id_));
+  pending_attributes_calls_++;
+  return client->get_async_rpc_queue()
+      ->Call<UpdateWindowGroupPropertiesRequest,
+             UpdateWindowGroupPropertiesResponse>(
+          id_, std::move(request),
+          [stub](grpc::ClientContext* context,
+                 const UpdateWindowGroupPropertiesRequest& request,
+                 grpc::CompletionQueue* completion_queue) {
+            return stub->PrepareAsyncUpdateWindowGroupProperties(
+                context, request, completion_queue);
+          },
+          [window_group = weak_from_this(), attributes](bool ok) {
+            if (std::shared_ptr<WindowGroupImpl> locked_window_group =
+                    window_group.lock()) {
+              locked_window_group->CompleteAttributes(attributes, ok);
+            }
+          });
+}
+
+void WindowGroupImpl::CompleteAttributes(
+    const WindowGroupAttributes& attributes, bool ok) {
+  std::lock_guard write_behind_lk(write_behind_mutex_);
+
+  pending_attributes_calls_--;
+
+  // Roll back to the last accepted attributes unless newer ones are in
+  // flight or held by the write-behind mode
+  if (ok) {
+    applied_attributes_ = attributes;
+  } else if (pending_attributes_calls_ == 0 && !attributes_changed_) {
+    attributes_ = applied_attributes_;
+  }
+}
+
 std::shared_ptr<WindowImpl> WindowGroupImpl::GetWindowWithId(GUID id) {
   std::shared_ptr<WindowImpl> window = nullptr;
 
@@ -2,9 +2,13 @@
 #include <guiddef.h>
 #include <overlay/window.h>
 
+#include <atomic>
+#include <future>
 #include <memory>
 #include <mutex>
+#include <string>
 #include <unordered_map>
+#include <vector>
 
 #include "utils/guid.h"
 #include "window_impl.h"
@@ -19,12 +23,25 @@ class WindowGroupImpl : public WindowGroup,
  public:
   WindowGroupImpl(std::weak_ptr<ClientImpl> client, GUID id,
                   const WindowGroupAttributes attributes);
+  ~WindowGroupImpl();
 
   virtual void SetAttributes(const WindowGroupAttributes attributes);
+  virtual std::future<void> SetAttributesAsync(
+      const WindowGroupAttributes attributes);
   virtual const WindowGroupAttributes GetAttributes() const;
 
+  virtual void SetWriteBehind(bool write_behind);
+  virtual bool IsWriteBehind() const;
+  virtual std::future<void> Commit();
+
   virtual std::shared_ptr<Window> CreateNewWindow(
       const Rect rect, const WindowAttributes attributes);
+  virtual std::future<std::shared_ptr<Window>> CreateNewWindowAsync(
+      const Rect rect, const WindowAttributes attributes);
+
+  // Queues the held attributes and the windows' properties and adds their
+  // futures
+  void QueueCommit(std::vector<std::future<void>>& futures);
 
   std::shared_ptr<WindowImpl> GetWindowWithId(GUID id);
 
@@ -34,8 +51,26 @@ class WindowGroupImpl : public WindowGroup,
 
   WindowGroupAttributes attributes_;
 
+  // The last attributes the overlay accepted and the number of calls in
+  // flight, the attributes roll back to them when the last call fails
+  WindowGroupAttributes applied_attributes_;
+  uint32_t pending_attributes_calls_;
+
+  // Holds the attributes until the group is committed, like the windows'
+  // write-behind mode
+  std::atomic<bool> write_behind_;
+  bool attributes_changed_;
+  std::mutex write_behind_mutex_;
+
   std::unordered_map<GUID, std::weak_ptr<WindowImpl>> windows_;
   std::mutex windows_mutex_;
+
+  // The lock is held while sending the attributes, their result is applied
+  // when the call completes
+  std::future<void> SendAttributes(const WindowGroupAttributes& attributes);
+  void CompleteAttributes(const WindowGroupAttributes& attributes, bool ok);
+  std::shared_ptr<Window> AddWindow(const std::string& id, const Rect rect,
+                                    const WindowAttributes attributes);
 };
 
 }  // namespace helper
@@ -5,8 +5,12 @@
 
 #include <cstdint>
 #include <magic_enum.hpp>
+#include <vector>
 
+#include "async_rpc_queue.h"
+#include "buffer_stream.h"
 #include "client_impl.h"
+#include "utils/buffer_codec.h"
 #include "window_group_impl.h"
 #include "windows.grpc.pb.h"
 
@@ -25,12 +29,196 @@ WindowImpl::WindowImpl(std::weak_ptr<ClientImpl> client,
       group_id_(group_id),
       rect_(rect),
       attributes_(attributes),
-      cursor_(Cursor::Arrow) {}
+      cursor_(Cursor::Arrow),
+      applied_rect_(rect),
+      applied_attributes_(attributes),
+      applied_cursor_(Cursor::Arrow),
+      pending_rect_calls_(0),
+      pending_attributes_calls_(0),
+      pending_cursor_calls_(0),
+      write_behind_(false),
+      attributes_changed_(false),
+      rect_changed_(false),
+      cursor_changed_(false),
+      buffer_encoding_(BufferEncoding::Raw),
+      buffer_generation_(0),
+      last_buffer_width_(0),
+      last_buffer_generation_(0) {}
+
+WindowImpl::~WindowImpl() {
+  // Stop committing on each frame for the window
+  if (write_behind_) {
+    if (std::shared_ptr<ClientImpl> client = client_.lock()) {
+      client->DisableFrameCommits();
+    }
+  }
+}
 
 void WindowImpl::SetAttributes(const WindowAttributes attributes) {
-  grpc::ClientContext context;
+  SetAttributesAsync(attributes).get();
+}
+
+std::future<void> WindowImpl::SetAttributesAsync(
+    const WindowAttributes attributes) {
+  // Verify attributes
+  if (attributes.opacity < 0 || attributes.opacity > 1) {
+    throw Error(ErrorCode::InvalidAttributes);
+  }
+
+  std::unique_lock write_behind_lk(write_behind_mutex_);
+
+  // Set the new attributes
+  attributes_ = attributes;
+
+  // Hold the attributes until the window is committed
+  if (write_behind_) {
+    attributes_changed_ = true;
+    return MakeReadyFuture();
+  }
+
+  // Send the property while locked, so it's queued after the older values
+  return SendAttributes(attributes);
+}
+
+const WindowAttributes WindowImpl::GetAttributes() const { return attributes_; }
+
+void WindowImpl::SetRect(const Rect rect) { SetRectAsync(rect).get(); }
+
+std::future<void> WindowImpl::SetRectAsync(const Rect rect) {
+  std::unique_lock write_behind_lk(write_behind_mutex_);
+
+  // Set the new rect
+  rect_ = rect;
+
+  // Hold the rect until the window is committed
+  if (write_behind_) {
+    rect_changed_ = true;
+    return MakeReadyFuture();
+  }
+
+  return SendRect(rect);
+}
+
+const Rect WindowImpl::GetRect() const { return rect_; }
+
+void WindowImpl::SetCursor(const Cursor cursor) {
+  SetCursorAsync(cursor).get();
+}
+
+std::future<void> WindowImpl::SetCursorAsync(const Cursor cursor) {
+  if (!magic_enum::enum_contains<Cursor>(cursor)) {
+    throw Error(ErrorCode::InvalidCursor);
+  }
+
+  std::unique_lock write_behind_lk(write_behind_mutex_);
+
+  // Set the new cursor
+  cursor_ = cursor;
+
+  // Hold the cursor until the window is committed
+  if (write_behind_) {
+    cursor_changed_ = true;
+    return MakeReadyFuture();
+  }
+
+  return SendCursor(cursor);
+}
+
+const Cursor WindowImpl::GetCursor() const { return cursor_; }
+
+void WindowImpl::SetWriteBehind(bool write_behind) {
+  std::vector<std::future<void>> futures;
+
+  std::shared_ptr<ClientImpl> client = client_.lock();
+  if (!client) {
+    throw Error(ErrorCode::ClientObjectDeallocated);
+  }
+
+  std::unique_lock write_behind_lk(write_behind_mutex_);
+
+  // Let the client commit the window on each frame while it's write-behind
+  if (write_behind_.exchange(write_behind) != write_behind) {
+    if (write_behind) {
+      client->EnableFrameCommits();
+    } else {
+      client->DisableFrameCommits();
+    }
+  }
+
+  // Send the held properties when leaving the write-behind mode
+  if (!write_behind) {
+    SendChangedProperties(futures);
+  }
+  write_behind_lk.unlock();
+
+  // Wait for the held properties like the other setters
+  WhenAll(std::move(futures)).get();
+}
+
+bool WindowImpl::IsWriteBehind() const { return write_behind_; }
+
+std::future<void> WindowImpl::Commit() {
+  std::vector<std::future<void>> futures;
+
+  QueueCommit(futures);
+
+  return WhenAll(std::move(futures));
+}
+
+void WindowImpl::QueueCommit(std::vector<std::future<void>>& futures) {
+  // The properties are queued while locked, so a commit from another thread
+  // can't queue older values after them
+  std::lock_guard write_behind_lk(write_behind_mutex_);
+
+  SendChangedProperties(futures);
+}
+
+void WindowImpl::SetInputMask(const std::vector<Rect>& rects) {
+  SendInputMask(rects, 0);
+}
+
+void WindowImpl::SetInputMaskAlpha(uint8_t alpha_threshold) {
+  SendInputMask({}, alpha_threshold);
+}
+
+void WindowImpl::SendInputMask(const std::vector<Rect>& rects,
+                               uint8_t alpha_threshold) {
+  SetWindowInputMaskRequest request;
+
+  std::shared_ptr<ClientImpl> client = client_.lock();
+  if (!client) {
+    throw Error(ErrorCode::ClientObjectDeallocated);
+  }
+
+  Windows::Stub* stub = client->get_windows_stub().get();
+
+  // Try to set the input mask after the window's previous calls
+  for (const Rect& rect : rects) {
+    WindowRect* window_rect = request.add_rects();
+
+    window_rect->set_height(rect.height);
+    window_rect->set_width(rect.width);
+    window_rect->set_x(rect.x);
+    window_rect->set_y(rect.y);
+  }
+  request.set_alpha_threshold(alpha_threshold);
+  request.set_group_id((const char*)&group_id_, sizeof(group_id_));
+  request.set_window_id((const char*)&id_, sizeof(id_));
+  client->get_async_rpc_queue()
+      ->Call<SetWindowInputMaskRequest, SetWindowInputMaskResponse>(
+          id_, std::move(request),
+          [stub](grpc::ClientContext* context,
+                 const SetWindowInputMaskRequest& request,
+                 grpc::CompletionQueue* completion_queue) {
+            return stub->PrepareAsyncSetWindowInputMask(context, request,
+                                                        completion_queue);
+          })
+      .get();
+}
+
+std::future<void> WindowImpl::SendAttributes(
+    const WindowAttributes& attributes) {
   UpdateWindowPropertiesRequest request;
-  UpdateWindowPropertiesResponse response;
 
   WindowProperties* properties = nullptr;
 
@@ -39,33 +227,33 @@ void WindowImpl::SetAttributes(const WindowAttributes attributes) {
     throw Error(ErrorCode::ClientObjectDeallocated);
   }
 
-  // Verify attributes
-  if (attributes.opacity < 0 || attributes.opacity > 1) {
-    throw Error(ErrorCode::InvalidAttributes);
-  }
+  Windows::Stub* stub = client->get_windows_stub().get();
 
-  // Try to update the attributes
+  // Try to update the attributes after the window's previous calls
   properties = request.mutable_properties();
   properties->set_opacity(attributes.opacity);
   properties->set_hidden(attributes.hidden);
   request.set_group_id((const char*)&group_id_, sizeof(group_id_));
   request.set_window_id((const char*)&id_, sizeof(id_));
-  if (!client->get_windows_stub()
-           ->UpdateWindowProperties(&context, request, &response)
-           .ok()) {
-    throw Error(ErrorCode::UnknownError);
-  }
-
-  // Set the new attributes
-  attributes_ = attributes;
+  pending_attributes_calls_++;
+  return client->get_async_rpc_queue()
+      ->Call<UpdateWindowPropertiesRequest, UpdateWindowPropertiesResponse>(
+          id_, std::move(request),
+          [stub](grpc::ClientContext* context,
+                 const UpdateWindowPropertiesRequest& request,
+                 grpc::CompletionQueue* completion_queue) {
+            return stub->PrepareAsyncUpdateWindowProperties(context, request,
+                                                            completion_queue);
+          },
+          [window = weak_from_this(), attributes](bool ok) {
+            if (std::shared_ptr<WindowImpl> locked_window = window.lock()) {
+              locked_window->CompleteAttributes(attributes, ok);
+            }
+          });
 }
 
-const WindowAttributes WindowImpl::GetAttributes() const { return attributes_; }
-
-void WindowImpl::SetRect(const Rect rect) {
-  grpc::ClientContext context;
+std::future<void> WindowImpl::SendRect(const Rect& rect) {
   SetWindowRectRequest request;
-  SetWindowRectResponse response;
 
   WindowRect* window_rect = nullptr;
 
@@ -74,7 +262,9 @@ void WindowImpl::SetRect(const Rect rect) {
     throw Error(ErrorCode::ClientObjectDeallocated);
   }
 
-  // Try to set the rect
+  Windows::Stub* stub = client->get_windows_stub().get();
+
+  // Try to set the rect after the window's previous calls
   window_rect = request.mutable_rect();
   window_rect->set_height(rect.height);
   window_rect->set_width(rect.width);
@@ -82,52 +272,137 @@ void WindowImpl::SetRect(const Rect rect) {
   window_rect->set_y(rect.y);
   request.set_group_id((const char*)&group_id_, sizeof(group_id_));
   request.set_window_id((const char*)&id_, sizeof(id_));
-  if (!client->get_windows_stub()
-           ->SetWindowRect(&context, request, &response)
-           .ok()) {
-    throw Error(ErrorCode::UnknownError);
-  }
-
-  // Set the new rect
-  rect_ = rect;
+  pending_rect_calls_++;
+  return client->get_async_rpc_queue()
+      ->Call<SetWindowRectRequest, SetWindowRectResponse>(
+          id_, std::move(request),
+          [stub](grpc::ClientContext* context,
+                 const SetWindowRectRequest& request,
+                 grpc::CompletionQueue* completion_queue) {
+            return stub->PrepareAsyncSetWindowRect(context, request,
+                                                   completion_queue);
+          },
+          [window = weak_from_this(), rect](bool ok) {
+            if (std::shared_ptr<WindowImpl> locked_window = window.lock()) {
+              locked_window->CompleteRect(rect, ok);
+            }
+          });
 }
 
-const Rect WindowImpl::GetRect() const { return rect_; }
-
-void WindowImpl::SetCursor(const Cursor cursor) {
-  grpc::ClientContext context;
+std::future<void> WindowImpl::SendCursor(const Cursor cursor) {
   SetWindowCursorRequest request;
-  SetWindowCursorResponse response;
 
   std::shared_ptr<ClientImpl> client = client_.lock();
   if (!client) {
     throw Error(ErrorCode::ClientObjectDeallocated);
   }
 
-  if (!magic_enum::enum_contains<Cursor>(cursor)) {
-    throw Error(ErrorCode::InvalidCursor);
-  }
+  Windows::Stub* stub = client->get_windows_stub().get();
 
-  // Try to set the cursor
+  // Try to set the cursor after the window's previous calls
   request.set_cursor((overlay::Cursor)cursor);
   request.set_group_id((const char*)&group_id_, sizeof(group_id_));
   request.set_window_id((const char*)&id_, sizeof(id_));
-  if (!client->get_windows_stub()
-           ->SetWindowCursor(&context, request, &response)
-           .ok()) {
-    throw Error(ErrorCode::UnknownError);
+  pending_cursor_calls_++;
+  return client->get_async_rpc_queue()
+      ->Call<SetWindowCursorRequest, SetWindowCursorResponse>(
+          id_, std::move(request),
+          [stub](grpc::ClientContext* context,
+                 const SetWindowCursorRequest& request,
+                 grpc::CompletionQueue* completion_queue) {
+            return stub->PrepareAsyncSetWindowCursor(context, request,
+                                                     completion_queue);
+          },
+          [window = weak_from_this(), cursor](bool ok) {
+            if (std::shared_ptr<WindowImpl> locked_window = window.lock()) {
+              locked_window->CompleteCursor(cursor, ok);
+            }
+          });
+}
+
+void WindowImpl::CompleteAttributes(const WindowAttributes& attributes,
+                                    bool ok) {
+  std::lock_guard write_behind_lk(write_behind_mutex_);
+
+  pending_attributes_calls_--;
+
+  // Roll back to the last accepted attributes unless newer ones are in
+  // flight or held by the write-behind mode
+  if (ok) {
+    applied_attributes_ = attributes;
+  } else if (pending_attributes_calls_ == 0 && !attributes_changed_) {
+    attributes_ = applied_attributes_;
   }
+}
 
-  // Set the new rect
-  cursor_ = cursor;
+void WindowImpl::CompleteRect(const Rect& rect, bool ok) {
+  std::lock_guard write_behind_lk(write_behind_mutex_);
+
+  pending_rect_calls_--;
+
+  // Roll back to the last accepted rect unless a newer one is in flight or
+  // held by the write-behind mode
+  if (ok) {
+    applied_rect_ = rect;
+  } else if (pending_rect_calls_ == 0 && !rect_changed_) {
+    rect_ = applied_rect_;
+  }
+
+  // Let the buffers that wait for the rect be sent
+  rect_cv_.notify_all();
 }
 
-const Cursor WindowImpl::GetCursor() const { return cursor_; }
+void WindowImpl::CompleteCursor(const Cursor cursor, bool ok) {
+  std::lock_guard write_behind_lk(write_behind_mutex_);
+
+  pending_cursor_calls_--;
 
-void WindowImpl::UpdateBitmapBuffer(const void* buffer, size_t buffer_size) {
-  grpc::ClientContext context;
-  BufferForWindowRequest request;
-  BufferForWindowResponse response;
+  // Roll back to the last accepted cursor unless a newer one is in flight or
+  // held by the write-behind mode
+  if (ok) {
+    applied_cursor_ = cursor;
+  } else if (pending_cursor_calls_ == 0 && !cursor_changed_) {
+    cursor_ = applied_cursor_;
+  }
+}
+
+void WindowImpl::SendChangedProperties(
+    std::vector<std::future<void>>& futures) {
+  // Send only the last value of each property that changed
+  if (attributes_changed_) {
+    futures.push_back(SendAttributes(attributes_));
+    attributes_changed_ = false;
+  }
+  if (rect_changed_) {
+    futures.push_back(SendRect(rect_));
+    rect_changed_ = false;
+  }
+  if (cursor_changed_) {
+    futures.push_back(SendCursor(cursor_));
+    cursor_changed_ = false;
+  }
+}
+
+void WindowImpl::SetBufferEncoding(const BufferEncoding encoding) {
+  // Verify the encoding flags
+  if ((uint32_t)encoding & ~utils::kBufferEncodingAll) {
+    throw Error(ErrorCode::InvalidBufferEncoding);
+  }
+
+  buffer_encoding_ = encoding;
+  last_buffer_.clear();
+}
+
+const BufferEncoding WindowImpl::GetBufferEncoding() const {
+  return buffer_encoding_;
+}
+
+void WindowImpl::UpdateBitmapBuffer(const void* buffer, size_t buffer_size,
+                                    uint32_t width, uint32_t height) {
+  std::shared_ptr<BufferStream> buffer_stream = nullptr;
+  uint32_t encoding = (uint32_t)buffer_encoding_;
+  uint64_t generation = 0, base_generation = last_buffer_generation_;
+  std::string encoded_buffer;
 
   std::shared_ptr<ClientImpl> client = client_.lock();
   if (!client) {
@@ -142,21 +417,67 @@ void WindowImpl::UpdateBitmapBuffer(const void* buffer, size_t buffer_size) {
   }
 
   // Verify buffer size
-  if (buffer_size != rect_.width * rect_.height * sizeof(uint32_t)) {
+  if (width == 0 || height == 0 ||
+      buffer_size != (size_t)width * height * sizeof(uint32_t)) {
     throw Error(ErrorCode::InvalidBitmapBufferSize);
   }
 
-  // Fill the request
-  request.set_group_id((const char*)&group_id_, sizeof(group_id_));
-  request.set_window_id((const char*)&id_, sizeof(id_));
-  request.set_buffer(buffer, buffer_size);
+  // Wait for the window's rects in flight, so the overlay has the rect the
+  // buffer was drawn for before it gets the buffer
+  {
+    std::unique_lock write_behind_lk(write_behind_mutex_);
+
+    rect_cv_.wait(write_behind_lk,
+                  [this]() { return pending_rect_calls_ == 0; });
+  }
 
-  // Send the buffer to the overlay
-  if (!client->get_windows_stub()
-           ->BufferForWindow(&context, request, &response)
-           .ok()) {
+  buffer_stream = client->GetBufferStream();
+
+  // The overlay rejected an earlier buffer of the window as invalid
+  if (buffer_stream->TakeFailedWindow(id_)) {
     throw Error(ErrorCode::UnknownError);
   }
+
+  generation = ++buffer_generation_;
+
+  // Send a full buffer if the overlay doesn't have the same previous buffer
+  if ((encoding & utils::kBufferEncodingXorDelta) &&
+      (buffer_stream->TakeRejectedWindow(id_) ||
+       last_buffer_.size() != buffer_size || last_buffer_width_ != width ||
+       last_buffer_stream_.lock() != buffer_stream)) {
+    encoding &= ~utils::kBufferEncodingXorDelta;
+  }
+
+  // Encode the buffer
+  if (!utils::BufferCodec::Encode(encoding, buffer, buffer_size, &last_buffer_,
+                                  encoded_buffer)) {
+    throw Error(ErrorCode::UnknownError);
+  }
+
+  // Save the buffer for the next delta
+  if ((uint32_t)buffer_encoding_ & utils::kBufferEncodingXorDelta) {
+    last_buffer_.assign((const char*)buffer, buffer_size);
+    last_buffer_width_ = width;
+    last_buffer_generation_ = generation;
+    last_buffer_stream_ = buffer_stream;
+  }
+
+  // Send the buffer to the overlay through the client's buffer stream
+  if (!buffer_stream->SendBuffer(group_id_, id_, std::move(encoded_buffer),
+                                 encoding, buffer_size, width, height,
+                                 generation, base_generation)) {
+    last_buffer_.clear();
+    throw Error(ErrorCode::UnknownError);
+  }
+}
+
+const BufferStats WindowImpl::GetBufferStats() const {
+  std::shared_ptr<ClientImpl> client = client_.lock();
+  if (!client) {
+    throw Error(ErrorCode::ClientObjectDeallocated);
+  }
+
+  return client->GetBufferStream()->GetWindowStats(id_);
 }
 
 void WindowImpl::SubscribeToEvent(
@@ -208,8 +529,8 @@ std::shared_ptr<WindowEvent> WindowImpl::GenerateEvent(
   WindowEvent* window_event = nullptr;
 
   switch (event.event_case()) {
-    case EventResponse::WindowEvent::EventCase::kKeyboardInputEvent:
-      window_event =
+    case EventResponse::WindowEvent::EventCase::kKeyboardInputEvent: {
+      WindowKeyboardInputEvent* keyboard_event =
           event.keyboardinputevent().type() ==
                   EventResponse::WindowEvent::KeyboardInputEvent::CHAR
               ? new WindowKeyboardInputEvent(
@@ -224,16 +545,34 @@ std::shared_ptr<WindowEvent> WindowImpl::GenerateEvent(
                     (WindowKeyboardInputEvent::KeyCode)event
                         .keyboardinputevent()
                         .code());
+
+      keyboard_event->message_time = event.keyboardinputevent().messagetime();
+      keyboard_event->capture_time = event.keyboardinputevent().capturetime();
+      window_event = keyboard_event;
       break;
+    }
 
     case EventResponse::WindowEvent::EventCase::kMouseInputEvent:
       switch (event.mouseinputevent().type()) {
-        case EventResponse::WindowEvent::MouseInputEvent::MOUSE_MOVE:
-          window_event = new WindowMouseInputEvent(
+        case EventResponse::WindowEvent::MouseInputEvent::MOUSE_MOVE: {
+          WindowMouseInputEvent *mouse_event = new WindowMouseInputEvent(
               (WindowMouseInputEvent::InputType)event.mouseinputevent().type(),
               (size_t)event.mouseinputevent().x(),
               (size_t)event.mouseinputevent().y());
+
+          // Convert the samples to the window's coordinates
+          mouse_event->samples.reserve(
+              event.mouseinputevent().samples_size());
+          for (auto &sample : event.mouseinputevent().samples()) {
+            mouse_event->samples.push_back(
+                {event.mouseinputevent().x() + sample.deltax(),
+                 event.mouseinputevent().y() + sample.deltay(),
+                 sample.timestamp()});
+          }
+
+          window_event = mouse_event;
           break;
+        }
 
         case EventResponse::WindowEvent::MouseInputEvent::MOUSE_VERTICAL_WHEEL:
         case EventResponse::WindowEvent::MouseInputEvent::
@@ -260,6 +599,15 @@ std::shared_ptr<WindowEvent> WindowImpl::GenerateEvent(
           break;
       }
 
+      if (window_event) {
+        WindowMouseInputEvent* mouse_event =
+            static_cast<WindowMouseInputEvent*>(window_event);
+
+        mouse_event->message_time = event.mouseinputevent().messagetime();
+        mouse_event->capture_time = event.mouseinputevent().capturetime();
+        mouse_event->click_count = event.mouseinputevent().clickcount();
+        mouse_event->dragging = event.mouseinputevent().dragging();
+      }
       break;
 
     case EventResponse::WindowEvent::EventCase::kFocusEvent:
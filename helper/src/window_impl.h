@@ -2,41 +2,68 @@
 #include <guiddef.h>
 #include <overlay/window.h>
 
+#include <atomic>
+#include <condition_variable>
 #include <cstdint>
+#include <future>
 #include <memory>
 #include <mutex>
+#include <string>
 #include <unordered_map>
+#include <vector>
 
 #include "events.pb.h"
 
 namespace overlay {
 namespace helper {
 
+class BufferStream;
 class ClientImpl;
 class WindowGroupImpl;
 
-class WindowImpl : public Window {
+class WindowImpl : public Window,
+                   public std::enable_shared_from_this<WindowImpl> {
  public:
   WindowImpl(std::weak_ptr<ClientImpl> client,
              std::shared_ptr<WindowGroupImpl> window_group, GUID id,
              GUID group_id, const Rect rect, const WindowAttributes attributes);
+  ~WindowImpl();
 
   virtual void SetAttributes(const WindowAttributes attributes);
+  virtual std::future<void> SetAttributesAsync(
+      const WindowAttributes attributes);
   virtual const WindowAttributes GetAttributes() const;
 
   virtual void SetRect(const Rect rect);
+  virtual std::future<void> SetRectAsync(const Rect rect);
   virtual const Rect GetRect() const;
 
   virtual void SetCursor(const Cursor cursor);
+  virtual std::future<void> SetCursorAsync(const Cursor cursor);
   virtual const Cursor GetCursor() const;
 
-  virtual void UpdateBitmapBuffer(const void* buffer, size_t buffer_size);
+  virtual void SetWriteBehind(bool write_behind);
+  virtual bool IsWriteBehind() const;
+  virtual std::future<void> Commit();
+
+  virtual void SetInputMask(const std::vector<Rect>& rects);
+  virtual void SetInputMaskAlpha(uint8_t alpha_threshold);
+
+  virtual void SetBufferEncoding(const BufferEncoding encoding);
+  virtual const BufferEncoding GetBufferEncoding() const;
+
+  virtual void UpdateBitmapBuffer(const void* buffer, size_t buffer_size,
+                                  uint32_t width, uint32_t height);
+  virtual const BufferStats GetBufferStats() const;
 
   virtual void SubscribeToEvent(
       WindowEventType event_type,
       std::function<void(std::shared_ptr<WindowEvent>)> callback);
   virtual void UnsubscribeEvent(WindowEventType event_type);
 
+  // Queues the held properties and adds their futures
+  void QueueCommit(std::vector<std::future<void>>& futures);
+
   void HandleWindowEvent(const EventResponse::WindowEvent& event);
 
  private:
@@ -48,11 +75,49 @@ class WindowImpl : public Window {
   WindowAttributes attributes_;
   Cursor cursor_;
 
+  // The last values the overlay accepted and the number of calls in flight,
+  // the properties roll back to them when the last call fails
+  Rect applied_rect_;
+  WindowAttributes applied_attributes_;
+  Cursor applied_cursor_;
+  uint32_t pending_rect_calls_;
+  uint32_t pending_attributes_calls_;
+  uint32_t pending_cursor_calls_;
+  std::condition_variable rect_cv_;
+
+  // In the write-behind mode the properties only change locally until the
+  // window is committed, and then only their last values are sent
+  std::atomic<bool> write_behind_;
+  bool attributes_changed_;
+  bool rect_changed_;
+  bool cursor_changed_;
+  std::mutex write_behind_mutex_;
+
+  // The overlay applies a delta only to the buffer of its base generation
+  BufferEncoding buffer_encoding_;
+  uint64_t buffer_generation_;
+  std::string last_buffer_;
+  uint32_t last_buffer_width_;
+  uint64_t last_buffer_generation_;
+  std::weak_ptr<BufferStream> last_buffer_stream_;
+
   std::unordered_map<WindowEventType,
                      std::function<void(std::shared_ptr<WindowEvent>)>>
       event_handlers_;
   std::mutex event_handlers_mutex_;
 
+  // Sends the properties held by the write-behind mode, the lock is held
+  void SendChangedProperties(std::vector<std::future<void>>& futures);
+  // The lock is held while sending the properties, their results are
+  // applied when their calls complete
+  std::future<void> SendAttributes(const WindowAttributes& attributes);
+  std::future<void> SendRect(const Rect& rect);
+  std::future<void> SendCursor(const Cursor cursor);
+  void CompleteAttributes(const WindowAttributes& attributes, bool ok);
+  void CompleteRect(const Rect& rect, bool ok);
+  void CompleteCursor(const Cursor cursor, bool ok);
+  void SendInputMask(const std::vector<Rect>& rects, uint8_t alpha_threshold);
+
   std::shared_ptr<WindowEvent> GenerateEvent(
       const EventResponse::WindowEvent& event) const;
 
@@ -0,0 +1,533 @@
+#include "input_replayer.h"
+
+#include <Windows.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <set>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "graphics/mouse_routing.h"
+#include "input/input_recorder.h"
+#include "input/message_decoder.h"
+#include "utils/rect.h"
+#include "utils/timestamp.h"
+
+// The hover isn't recorded until the first mouse event
+#define REPLAY_UNKNOWN_WINDOW UINT32_MAX
+
+namespace overlay {
+namespace replayer {
+
+using core::graphics::InputMask;
+using core::graphics::InputMaskType;
+using core::graphics::MouseEventRoute;
+using core::graphics::Rect;
+using core::graphics::WindowInputRegion;
+using core::graphics::WindowUniqueId;
+using core::input::InputRecordType;
+
+namespace {
+
+// The window that got a mouse event and the focus and hover after it, the
+// windows are indexes, 0 being no window
+struct ReplayRoute {
+  uint32_t window;
+  int64_t x;
+  int64_t y;
+  uint32_t focused_window;
+  uint32_t hovered_window;
+};
+
+struct ReplayRecord {
+  InputRecordType type;
+  size_t index;  // The scene or the focused window
+  EventResponse::WindowEvent::MouseInputEvent::MouseInputType mouse_type;
+  POINT point;
+  bool buttons_down;
+  bool routed;  // False if the route of the mouse event was dropped
+  ReplayRoute route;
+};
+
+// A recorded window message, the keyboard messages don't have their keys
+struct ReplayMessage {
+  UINT message;
+  WPARAM word_param;
+};
+
+struct ReplayLog {
+  std::vector<ReplayRecord> records;
+  std::vector<ReplayMessage> messages;
+  std::vector<std::vector<WindowInputRegion>> scenes;
+  // The rects of each scene's windows with alpha masks, which are routed as
+  // if they had no mask since only the masks' hashes are recorded
+  std::vector<std::vector<Rect>> scenes_alpha_rects;
+  std::unordered_map<uint32_t, WindowUniqueId> windows;
+  std::unordered_map<uint32_t, uint32_t> window_clients;
+  std::unordered_map<uint32_t, std::shared_ptr<const InputMask>> masks;
+  std::set<uint32_t> alpha_masks;
+};
+
+class ReplayReader {
+ public:
+  inline ReplayReader(const std::string &data) : data_(data), offset_(0) {}
+
+  template <typename T>
+  inline bool Read(T &value) {
+    if (data_.size() - offset_ < sizeof(value)) {
+      return false;
+    }
+
+    std::memcpy(&value, data_.data() + offset_, sizeof(value));
+    offset_ += sizeof(value);
+
+    return true;
+  }
+
+  inline bool Done() const { return offset_ == data_.size(); }
+  inline size_t Remaining() const { return data_.size() - offset_; }
+
+ private:
+  const std::string &data_;
+  size_t offset_;
+};
+
+// The windows are replayed with ids made of their indexes, so the replay only
+// depends on the order of the windows and on who owns them
+WindowUniqueId GetReplayWindowId(ReplayLog &log, uint32_t window,
+                                 uint32_t client) {
+  GUID window_id = GUID_NULL;
+
+  if (!window) {
+    return WindowUniqueId();
+  }
+
+  window_id.Data1 = window;
+  log.window_clients.try_emplace(window, client);
+  return log.windows
+      .try_emplace(window, window_id, GUID_NULL, std::to_string(client))
+      .first->second;
+}
+
+inline uint32_t GetReplayWindowIndex(const WindowUniqueId *window_id) {
+  return window_id ? (uint32_t)window_id->window_id.Data1 : 0;
+}
+
+inline uint32_t GetReplayWindowClient(const ReplayLog &log, uint32_t window) {
+  auto client = log.window_clients.find(window);
+
+  return client != log.window_clients.end() ? client->second : 0;
+}
+
+bool ParseMask(ReplayReader &reader, ReplayLog &log) {
+  uint32_t index = 0, count = 0, width = 0, height = 0;
+  uint8_t type = 0, alpha_threshold = 0;
+  uint64_t bitmap_hash = 0;
+  std::shared_ptr<const InputMask> mask = nullptr;
+
+  if (!reader.Read(index) || !reader.Read(type) || !index) {
+    return false;
+  }
+
+  switch ((InputMaskType)type) {
+    case InputMaskType::Rects: {
+      std::vector<Rect> rects;
+
+      if (!reader.Read(count)) {
+        return false;
+      }
+
+      for (uint32_t i = 0; i < count; i++) {
+        Rect &rect = rects.emplace_back();
+
+        if (!reader.Read(rect.x) || !reader.Read(rect.y) ||
+            !reader.Read(rect.width) || !reader.Read(rect.height)) {
+          return false;
+        }
+      }
+
+      mask = InputMask::FromRects(std::move(rects));
+      break;
+    }
+
+    // Only the alpha mask's parameters are recorded, the windows using it
+    // take input on all of their rects
+    case InputMaskType::Alpha:
+      if (!reader.Read(width) || !reader.Read(height) ||
+          !reader.Read(alpha_threshold) || !reader.Read(bitmap_hash)) {
+        return false;
+      }
+
+      log.alpha_masks.insert(index);
+      break;
+
+    default:
+      return false;
+  }
+
+  log.masks[index] = mask;
+
+  return true;
+}
+
+bool ParseRecord(ReplayReader &reader, ReplayLog &log) {
+  uint8_t type = 0;
+  uint64_t timestamp = 0;
+  ReplayRecord record = {};
+
+  if (!reader.Read(type) || !reader.Read(timestamp)) {
+    return false;
+  }
+
+  record.type = (InputRecordType)type;
+  switch (record.type) {
+    case InputRecordType::Scene: {
+      uint32_t count = 0;
+
+      if (!reader.Read(count)) {
+        return false;
+      }
+
+      auto &scene = log.scenes.emplace_back();
+      auto &scene_alpha_rects = log.scenes_alpha_rects.emplace_back();
+      for (uint32_t i = 0; i < count; i++) {
+        uint32_t window = 0, client = 0, mask = 0;
+        Rect rect = {};
+
+        if (!reader.Read(window) || !reader.Read(client) ||
+            !reader.Read(rect.x) || !reader.Read(rect.y) ||
+            !reader.Read(rect.width) || !reader.Read(rect.height) ||
+            !reader.Read(mask) || (mask && !log.masks.count(mask))) {
+          return false;
+        }
+
+        scene.push_back({GetReplayWindowId(log, window, client), rect,
+                         mask ? log.masks[mask] : nullptr});
+        if (log.alpha_masks.count(mask)) {
+          scene_alpha_rects.push_back(rect);
+        }
+      }
+
+      record.index = log.scenes.size() - 1;
+      break;
+    }
+
+    case InputRecordType::Focus: {
+      uint32_t window = 0;
+
+      if (!reader.Read(window)) {
+        return false;
+      }
+
+      record.index = window;
+      break;
+    }
+
+    case InputRecordType::MouseInput: {
+      uint8_t mouse_type = 0, buttons_down = 0;
+      int32_t x = 0, y = 0;
+
+      if (!reader.Read(mouse_type) || !reader.Read(x) || !reader.Read(y) ||
+          !reader.Read(buttons_down) ||
+          !EventResponse::WindowEvent::MouseInputEvent::MouseInputType_IsValid(
+              mouse_type)) {
+        return false;
+      }
+
+      record.mouse_type =
+          (EventResponse::WindowEvent::MouseInputEvent::MouseInputType)
+              mouse_type;
+      record.point = {x, y};
+      record.buttons_down = buttons_down != 0;
+      break;
+    }
+
+    case InputRecordType::Route: {
+      ReplayRoute route = {};
+
+      if (!reader.Read(route.window) || !reader.Read(route.x) ||
+          !reader.Read(route.y) || !reader.Read(route.focused_window) ||
+          !reader.Read(route.hovered_window)) {
+        return false;
+      }
+
+      // The route belongs to the last mouse event, any scene or focus change
+      // between them was caused by the event or came from another thread
+      for (auto record_it = log.records.rbegin();
+           record_it != log.records.rend(); record_it++) {
+        if (record_it->type == InputRecordType::MouseInput) {
+          if (record_it->routed) {
+            return false;
+          }
+
+          record_it->routed = true;
+          record_it->route = route;
+          return true;
+        }
+      }
+
+      return false;
+    }
+
+    case InputRecordType::Mask:
+      return ParseMask(reader, log);
+
+    // The messages are decoded on their own, so they aren't routing records
+    case InputRecordType::Message: {
+      uint32_t message = 0;
+      uint64_t word_param = 0;
+
+      if (!reader.Read(message) || !reader.Read(word_param)) {
+        return false;
+      }
+
+      log.messages.push_back({message, (WPARAM)word_param});
+      return true;
+    }
+
+    default:
+      return false;
+  }
+
+  log.records.push_back(record);
+
+  return true;
+}
+
+bool ParseLog(const std::string &path, ReplayLog &log) {
+  std::ifstream file(path, std::ios::in | std::ios::binary);
+  std::string data;
+  ReplayReader reader(data);
+  char magic[sizeof(INPUT_RECORDING_MAGIC) - 1] = {};
+  uint32_t version = 0;
+
+  if (!file.is_open()) {
+    fprintf(stderr, "Unable to open input recording file '%s'!\n",
+            path.c_str());
+    return false;
+  }
+
+  data.assign(std::istreambuf_iterator<char>(file),
+              std::istreambuf_iterator<char>());
+
+  // Verify the header
+  if (!reader.Read(magic) || !reader.Read(version) ||
+      std::memcmp(magic, INPUT_RECORDING_MAGIC, sizeof(magic)) ||
+      version != INPUT_RECORDING_VERSION) {
+    fprintf(stderr, "Invalid input recording file '%s'!\n", path.c_str());
+    return false;
+  }
+
+  while (!reader.Done()) {
+    if (!ParseRecord(reader, log)) {
+      fprintf(stderr, "Corrupted input recording file '%s'!\n",
+              path.c_str());
+      return false;
+    }
+  }
+
+  return true;
+}
+
+// Compares the events each client got from the recorded route to the ones it
+// gets from the replayed route, both starting from the same focus and hover.
+// Returns whether they match and counts the recorded events
+bool CompareRoutes(const ReplayLog &log, const ReplayRoute &recorded_route,
+                   const ReplayRoute &replayed_route, uint32_t focused_window,
+                   uint32_t hovered_window, InputReplayResult &result) {
+  std::set<uint32_t> mismatched_windows;
+
+  // The mouse event
+  if (recorded_route.window) {
+    result.clients[GetReplayWindowClient(log, recorded_route.window)]
+        .mouse_events++;
+  }
+  if (recorded_route.window != replayed_route.window ||
+      (recorded_route.window && (recorded_route.x != replayed_route.x ||
+                                 recorded_route.y != replayed_route.y))) {
+    mismatched_windows.insert({recorded_route.window, replayed_route.window});
+  }
+
+  // The blur of the focused window and the focus of the new one
+  if (recorded_route.focused_window != focused_window) {
+    if (focused_window) {
+      result.clients[GetReplayWindowClient(log, focused_window)]
+          .blur_events++;
+    }
+    if (recorded_route.focused_window) {
+      result.clients[GetReplayWindowClient(log, recorded_route.focused_window)]
+          .focus_events++;
+    }
+  }
+  if (recorded_route.focused_window != replayed_route.focused_window) {
+    mismatched_windows.insert(
+        {recorded_route.focused_window, replayed_route.focused_window});
+  }
+
+  // The left window and the hovered one
+  if (recorded_route.hovered_window != hovered_window) {
+    for (uint32_t window : {hovered_window, recorded_route.hovered_window}) {
+      if (window) {
+        result.clients[GetReplayWindowClient(log, window)].hover_changes++;
+      }
+    }
+  }
+  if (recorded_route.hovered_window != replayed_route.hovered_window) {
+    mismatched_windows.insert(
+        {recorded_route.hovered_window, replayed_route.hovered_window});
+  }
+
+  // Count the mismatch once for each client that got other events
+  mismatched_windows.erase(0);
+  std::set<uint32_t> mismatched_clients;
+  for (uint32_t window : mismatched_windows) {
+    mismatched_clients.insert(GetReplayWindowClient(log, window));
+  }
+  for (uint32_t client : mismatched_clients) {
+    result.clients[client].mismatches++;
+  }
+
+  return mismatched_windows.empty();
+}
+
+}  // namespace
+
+bool InputReplayer::Replay(const std::string &path, uint32_t iterations,
+                           InputReplayResult &result) {
+  static const std::vector<WindowInputRegion> empty_scene;
+  static const std::vector<Rect> empty_alpha_rects;
+
+  ReplayLog log;
+  MouseEventRoute route = {};
+  uint64_t start_timestamp = 0;
+
+  result = {0, 0, -1, 0, 0, 0, 0, 0, {}};
+
+  if (!iterations || !ParseLog(path, log)) {
+    return false;
+  }
+
+  start_timestamp = utils::timestamp::GetTimestamp();
+  for (uint32_t iteration = 0; iteration < iterations; iteration++) {
+    const std::vector<WindowInputRegion> *scene = &empty_scene;
+    const std::vector<Rect> *alpha_rects = &empty_alpha_rects;
+    WindowUniqueId focused_window_id, captured_window_id;
+    uint32_t hovered_window = REPLAY_UNKNOWN_WINDOW;
+    int64_t mouse_event = 0;
+
+    for (const ReplayRecord &record : log.records) {
+      switch (record.type) {
+        case InputRecordType::Scene:
+          scene = &log.scenes[record.index];
+          alpha_rects = &log.scenes_alpha_rects[record.index];
+          break;
+
+        case InputRecordType::Focus:
+          focused_window_id = GetReplayWindowId(log, (uint32_t)record.index, 0);
+          break;
+
+        case InputRecordType::MouseInput:
+          core::graphics::RouteMouseEvent(
+              *scene, focused_window_id, captured_window_id,
+              record.mouse_type, record.point, record.buttons_down, route);
+
+          // Only check the first iteration, the others are for measuring
+          if (iteration == 0 && record.routed) {
+            if (hovered_window == REPLAY_UNKNOWN_WINDOW) {
+              hovered_window = record.route.hovered_window;
+            }
+
+            ReplayRoute replayed_route = {
+                GetReplayWindowIndex(route.window_id),
+                route.window_id ? route.x : 0,
+                route.window_id ? route.y : 0,
+                GetReplayWindowIndex(&focused_window_id), hovered_window};
+
+            // Apply the route like the window manager does, pressing an
+            // empty region like a group's buffer doesn't change the focus
+            if (route.blur_focused_window) {
+              replayed_route.focused_window = 0;
+            }
+            if (route.focus_window_id && *route.focus_window_id) {
+              replayed_route.focused_window =
+                  GetReplayWindowIndex(route.focus_window_id);
+            }
+            if (record.mouse_type ==
+                EventResponse::WindowEvent::MouseInputEvent::MOUSE_MOVE) {
+              replayed_route.hovered_window =
+                  GetReplayWindowIndex(route.hovered_window_id);
+            }
+
+            // The routes over alpha masks can't be compared
+            result.mouse_events++;
+            if (std::any_of(alpha_rects->begin(), alpha_rects->end(),
+                            [&record](const Rect &rect) {
+                              return utils::Rect::PointInRect(record.point,
+                                                              rect);
+                            })) {
+              result.unverified_events++;
+            } else if (!CompareRoutes(log, record.route, replayed_route,
+                                      GetReplayWindowIndex(&focused_window_id),
+                                      hovered_window, result)) {
+              result.mismatches++;
+              if (result.first_mismatch == -1) {
+                result.first_mismatch = mouse_event;
+              }
+            }
+          }
+
+          // Continue from the recorded hover so a mismatch isn't repeated,
+          // the recorded focus follows in its own record
+          if (record.routed) {
+            hovered_window = record.route.hovered_window;
+          }
+
+          // The replayed clients' ids are short, so copying doesn't allocate
+          captured_window_id =
+              route.capture_window_id ? *route.capture_window_id
+                                      : WindowUniqueId();
+
+          mouse_event++;
+          break;
+
+        default:
+          break;
+      }
+    }
+  }
+  result.routing_time = utils::timestamp::GetTimestamp() - start_timestamp;
+
+  // Decode the recorded messages like the input manager's window hook does
+  result.messages = log.messages.size();
+  start_timestamp = utils::timestamp::GetTimestamp();
+  for (uint32_t iteration = 0; iteration < iterations; iteration++) {
+    uint64_t decoded_messages = 0;
+
+    for (const ReplayMessage &message : log.messages) {
+      EventResponse::WindowEvent::KeyboardInputEvent::KeyboardInputType
+          keyboard_type;
+      core::input::DecodedMouseMessage mouse_message;
+
+      if (core::input::DecodeKeyboardMessage(message.message,
+                                             keyboard_type) ||
+          core::input::DecodeMouseMessage(message.message,
+                                          message.word_param, mouse_message)) {
+        decoded_messages++;
+      }
+    }
+
+    result.decoded_messages = decoded_messages;
+  }
+  result.decoding_time = utils::timestamp::GetTimestamp() - start_timestamp;
+
+  return true;
+}
+
+}  // namespace replayer
+}  // namespace overlay
@@ -0,0 +1,44 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <string>
+
+namespace overlay {
+namespace replayer {
+
+// The events the windows of a recorded client got
+struct ClientReplayResult {
+  uint64_t mouse_events;
+  uint64_t focus_events;
+  uint64_t blur_events;
+  uint64_t hover_changes;  // The client's windows were hovered or left
+  uint64_t mismatches;     // Mouse events after which it got other events
+};
+
+struct InputReplayResult {
+  uint64_t mouse_events;
+  uint64_t mismatches;     // Mouse events after which any client got other
+                           // events than it got while recording
+  int64_t first_mismatch;  // The index of the first mismatched mouse event
+  uint64_t unverified_events;  // Mouse events over alpha masks, which only
+                               // have their hashes recorded
+  uint64_t routing_time;   // Microseconds for all the iterations
+  uint64_t messages;       // The recorded keyboard and mouse messages
+  uint64_t decoded_messages;  // The messages that decoded to input events
+  uint64_t decoding_time;     // Microseconds for all the iterations
+
+  std::map<uint32_t, ClientReplayResult> clients;  // By the client's index
+};
+
+// Replays an input recording through the core's mouse routing without an
+// overlay, checks that each client gets the mouse, focus, blur and hover
+// events it got while recording, and measures the routing throughput and
+// the decoding throughput of the recorded messages
+class InputReplayer {
+ public:
+  static bool Replay(const std::string &path, uint32_t iterations,
+                     InputReplayResult &result);
+};
+
+}  // namespace replayer
+}  // namespace overlay
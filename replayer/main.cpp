@@ -0,0 +1,74 @@
+#include <cstdio>
+#include <cxxopts.hpp>
+#include <iostream>
+#include <string>
+
+#include "input_replayer.h"
+
+namespace ovrp = overlay::replayer;
+
+int main(int argc, char *argv[]) {
+  cxxopts::Options options(
+      "OverlayInputReplayer",
+      "Replays an overlay input recording and benchmarks its routing");
+  ovrp::InputReplayResult result;
+
+  options.add_options()  //
+      ("i,input", "The input recording to replay",
+       cxxopts::value<std::string>())  // -i input.bin
+      ("n,iterations", "Times to replay the input recording",
+       cxxopts::value<unsigned int>()->default_value("100"))  // -n 100
+      ("h,help", "Show this help")                            // -h
+      ;
+
+  auto args = options.parse(argc, argv);
+
+  if (args.count("help") || !args.count("input")) {
+    std::cout << options.help() << std::endl;
+    return 0;
+  }
+
+  if (!ovrp::InputReplayer::Replay(args["input"].as<std::string>(),
+                                   args["iterations"].as<unsigned int>(),
+                                   result)) {
+    return 1;
+  }
+
+  printf(
+      "Replayed %llu mouse events %u times in %f ms, %f events per second, "
+      "%llu mismatches, %llu unverified",
+      result.mouse_events, args["iterations"].as<unsigned int>(),
+      result.routing_time / 1000.0,
+      result.routing_time > 0
+          ? result.mouse_events * args["iterations"].as<unsigned int>() /
+                (result.routing_time / 1000000.0)
+          : 0.0,
+      result.mismatches, result.unverified_events);
+  if (result.first_mismatch != -1) {
+    printf(" (first at mouse event %lld)", result.first_mismatch);
+  }
+  printf("\n");
+
+  // The decoding of the recorded keyboard and mouse messages
+  printf(
+      "Decoded %llu of %llu messages %u times in %f ms, %f messages per "
+      "second\n",
+      result.decoded_messages, result.messages,
+      args["iterations"].as<unsigned int>(), result.decoding_time / 1000.0,
+      result.decoding_time > 0
+          ? result.messages * args["iterations"].as<unsigned int>() /
+                (result.decoding_time / 1000000.0)
+          : 0.0);
+
+  // The events each client got while recording
+  for (auto &[client, client_result] : result.clients) {
+    printf(
+        "Client %u: %llu mouse, %llu focus, %llu blur and %llu hover events, "
+        "%llu mismatches\n",
+        client, client_result.mouse_events, client_result.focus_events,
+        client_result.blur_events, client_result.hover_changes,
+        client_result.mismatches);
+  }
+
+  return result.mismatches ? 2 : 0;
+}
@@ -10,6 +10,7 @@ struct AuthenticateResponse {
   uint16_t rpc_server_port;
   GUID token;
   char server_certificate[SERVER_CERTIFICATE_MAX_SIZE];
+  char local_socket_path[MAX_PATH];  // Empty if the local transport is off
 };
 
 }  // namespace overlay
\ No newline at end of file
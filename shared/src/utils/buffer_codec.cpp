@@ -0,0 +1,225 @@
+#include "utils/buffer_codec.h"
+
+#include <lz4.h>
+
+#include <cstring>
+
+namespace overlay {
+namespace utils {
+
+struct TransparentRunHeader {
+  uint32_t transparent_pixels;
+  uint32_t literal_pixels;
+};
+
+bool BufferCodec::Encode(uint32_t encoding, const void *buffer,
+                         size_t buffer_size, const std::string *previous_buffer,
+                         std::string &encoded) {
+  std::string stage;
+
+  if ((encoding & ~kBufferEncodingAll) || buffer_size % sizeof(uint32_t)) {
+    return false;
+  }
+
+  encoded.assign((const char *)buffer, buffer_size);
+
+  // XOR the buffer with the previous buffer so unchanged pixels become zero
+  if (encoding & kBufferEncodingXorDelta) {
+    if (previous_buffer == nullptr ||
+        !ApplyXorDelta(encoded, *previous_buffer)) {
+      return false;
+    }
+  }
+
+  // Collapse runs of zero pixels (transparent or unchanged)
+  if (encoding & kBufferEncodingTransparentRle) {
+    EncodeTransparentRuns(encoded, stage);
+    encoded.swap(stage);
+  }
+
+  if (encoding & kBufferEncodingLz4) {
+    if (!CompressLz4(encoded, stage)) {
+      return false;
+    }
+    encoded.swap(stage);
+  }
+
+  return true;
+}
+
+bool BufferCodec::Decode(uint32_t encoding, const std::string &encoded,
+                         size_t raw_size, std::string &decoded) {
+  std::string stage;
+  const std::string *input = &encoded;
+
+  if (encoding & ~kBufferEncodingAll) {
+    return false;
+  }
+
+  // The transparent runs encoding adds at most two run headers to the raw
+  // buffer since every literal run is followed by at least two transparent
+  // pixels
+  if (encoding & kBufferEncodingLz4) {
+    if (!DecompressLz4(*input,
+                       (encoding & kBufferEncodingTransparentRle)
+                           ? raw_size + 2 * sizeof(TransparentRunHeader)
+                           : raw_size,
+                       stage)) {
+      return false;
+    }
+    input = &stage;
+  }
+
+  if (encoding & kBufferEncodingTransparentRle) {
+    return DecodeTransparentRuns(*input, raw_size, decoded);
+  }
+
+  if (input->size() != raw_size) {
+    return false;
+  }
+
+  if (input == &encoded) {
+    decoded = encoded;
+  } else {
+    decoded.swap(stage);
+  }
+
+  return true;
+}
+
+bool BufferCodec::ApplyXorDelta(std::string &buffer,
+                                const std::string &previous) {
+  uint64_t *words = (uint64_t *)buffer.data();
+  const uint64_t *previous_words = (const uint64_t *)previous.data();
+  size_t word_count = buffer.size() / sizeof(uint64_t);
+
+  if (buffer.size() != previous.size() || buffer.size() % sizeof(uint32_t)) {
+    return false;
+  }
+
+  // XOR two pixels at a time
+  for (size_t i = 0; i < word_count; i++) {
+    words[i] ^= previous_words[i];
+  }
+
+  // XOR the last pixel if the pixel count is odd
+  if (buffer.size() % sizeof(uint64_t)) {
+    *((uint32_t *)(words + word_count)) ^=
+        *((const uint32_t *)(previous_words + word_count));
+  }
+
+  return true;
+}
+
+void BufferCodec::EncodeTransparentRuns(const std::string &buffer,
+                                        std::string &encoded) {
+  const uint32_t *pixels = (const uint32_t *)buffer.data();
+  size_t pixel_count = buffer.size() / sizeof(uint32_t);
+  size_t i = 0;
+
+  TransparentRunHeader header;
+
+  encoded.clear();
+  encoded.reserve(buffer.size() / 4);
+
+  while (i < pixel_count) {
+    size_t literal_start = 0;
+
+    header.transparent_pixels = 0;
+    header.literal_pixels = 0;
+
+    // Count transparent pixels
+    while (i < pixel_count && pixels[i] == 0) {
+      header.transparent_pixels++;
+      i++;
+    }
+
+    // Count literal pixels, a single transparent pixel doesn't end the run
+    literal_start = i;
+    while (i < pixel_count &&
+           !(pixels[i] == 0 && (i + 1 == pixel_count || pixels[i + 1] == 0))) {
+      header.literal_pixels++;
+      i++;
+    }
+
+    encoded.append((const char *)&header, sizeof(header));
+    encoded.append((const char *)(pixels + literal_start),
+                   header.literal_pixels * sizeof(uint32_t));
+  }
+}
+
+bool BufferCodec::DecodeTransparentRuns(const std::string &encoded,
+                                        size_t raw_size, std::string &decoded) {
+  const char *data = encoded.data();
+  const char *end = encoded.data() + encoded.size();
+  size_t offset = 0;
+
+  TransparentRunHeader header;
+
+  decoded.resize(raw_size);
+
+  while (data < end) {
+    // Read the run header
+    if ((size_t)(end - data) < sizeof(header)) {
+      return false;
+    }
+    std::memcpy(&header, data, sizeof(header));
+    data += sizeof(header);
+
+    // Verify the run fits in the buffer
+    if (((uint64_t)header.transparent_pixels + header.literal_pixels) *
+                sizeof(uint32_t) >
+            raw_size - offset ||
+        (size_t)(end - data) < header.literal_pixels * sizeof(uint32_t)) {
+      return false;
+    }
+
+    std::memset(&decoded[offset], 0,
+                header.transparent_pixels * sizeof(uint32_t));
+    offset += header.transparent_pixels * sizeof(uint32_t);
+
+    std::memcpy(&decoded[offset], data,
+                header.literal_pixels * sizeof(uint32_t));
+    offset += header.literal_pixels * sizeof(uint32_t);
+    data += header.literal_pixels * sizeof(uint32_t);
+  }
+
+  return offset == raw_size;
+}
+
+bool BufferCodec::CompressLz4(const std::string &buffer,
+                              std::string &compressed) {
+  int compressed_size = 0;
+
+  compressed.resize(LZ4_compressBound((int)buffer.size()));
+  compressed_size = LZ4_compress_default(buffer.data(), compressed.data(),
+                                         (int)buffer.size(),
+                                         (int)compressed.size());
+  if (compressed_size <= 0) {
+    return false;
+  }
+
+  compressed.resize(compressed_size);
+
+  return true;
+}
+
+bool BufferCodec::DecompressLz4(const std::string &compressed,
+                                size_t raw_size, std::string &decompressed) {
+  int decompressed_size = 0;
+
+  decompressed.resize(raw_size);
+  decompressed_size =
+      LZ4_decompress_safe(compressed.data(), decompressed.data(),
+                          (int)compressed.size(), (int)decompressed.size());
+  if (decompressed_size < 0) {
+    return false;
+  }
+
+  decompressed.resize(decompressed_size);
+
+  return true;
+}
+
+}  // namespace utils
+}  // namespace overlay
@@ -0,0 +1,42 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+namespace overlay {
+namespace utils {
+
+// Encodings are flags that are applied in the order they're declared
+enum BufferEncodingFlags : uint32_t {
+  kBufferEncodingRaw = 0,
+  kBufferEncodingXorDelta = 1 << 0,
+  kBufferEncodingTransparentRle = 1 << 1,
+  kBufferEncodingLz4 = 1 << 2,
+  kBufferEncodingAll = kBufferEncodingXorDelta | kBufferEncodingTransparentRle |
+                       kBufferEncodingLz4
+};
+
+class BufferCodec {
+ public:
+  static bool Encode(uint32_t encoding, const void *buffer, size_t buffer_size,
+                     const std::string *previous_buffer, std::string &encoded);
+
+  // Reverses every encoding except for the XOR delta, which needs the previous
+  // buffer of the receiver
+  static bool Decode(uint32_t encoding, const std::string &encoded,
+                     size_t raw_size, std::string &decoded);
+
+  static bool ApplyXorDelta(std::string &buffer, const std::string &previous);
+
+ private:
+  static void EncodeTransparentRuns(const std::string &buffer,
+                                    std::string &encoded);
+  static bool DecodeTransparentRuns(const std::string &encoded,
+                                    size_t raw_size, std::string &decoded);
+
+  static bool CompressLz4(const std::string &buffer, std::string &compressed);
+  static bool DecompressLz4(const std::string &compressed, size_t raw_size,
+                            std::string &decompressed);
+};
+
+}  // namespace utils
+}  // namespace overlay
@@ -0,0 +1,30 @@
+#include "utils/timestamp.h"
+
+namespace overlay {
+namespace utils {
+namespace timestamp {
+
+uint64_t GetTimestamp() { return CounterToTimestamp(GetCounter()); }
+
+uint64_t GetCounter() {
+  LARGE_INTEGER counter;
+  QueryPerformanceCounter(&counter);
+
+  return counter.QuadPart;
+}
+
+uint64_t CounterToTimestamp(uint64_t counter) {
+  static uint64_t frequency = []() {
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    return (uint64_t)frequency.QuadPart;
+  }();
+
+  // Split the conversion to avoid overflowing on long uptimes
+  return (counter / frequency) * 1000000 +
+         (counter % frequency) * 1000000 / frequency;
+}
+
+}  // namespace timestamp
+}  // namespace utils
+}  // namespace overlay
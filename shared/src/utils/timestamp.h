@@ -0,0 +1,22 @@
+#pragma once
+#include <windows.h>
+
+#include <cstdint>
+
+namespace overlay {
+namespace utils {
+namespace timestamp {
+
+// Returns the current time in microseconds, based on the performance counter
+// so it can be compared between processes on the same machine
+uint64_t GetTimestamp();
+
+// Returns the current value of the performance counter
+uint64_t GetCounter();
+
+// Converts a performance counter value to a timestamp
+uint64_t CounterToTimestamp(uint64_t counter);
+
+}  // namespace timestamp
+}  // namespace utils
+}  // namespace overlay
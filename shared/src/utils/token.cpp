@@ -15,6 +15,17 @@ std::string GeneratePipeName(DWORD pid) {
   return ss.str();
 }
 
+std::string GenerateLocalSocketPath(DWORD pid) {
+  char temp_path[MAX_PATH] = {0};
+  std::stringstream ss;
+
+  GetTempPathA(sizeof(temp_path), temp_path);
+
+  ss << temp_path << LOCAL_SOCKET_IDENTIFIER << "-" << pid << ".sock";
+
+  return ss.str();
+}
+
 }  // namespace token
 }  // namespace utils
 }  // namespace overlay
\ No newline at end of file
@@ -4,12 +4,16 @@
 #include <string>
 
 #define PIPE_IDENTIFIER "overlay-token-generator"
+#define LOCAL_SOCKET_IDENTIFIER "overlay-rpc"
+#define SESSION_METADATA_KEY "overlay-session"
+#define TOKEN_PIPE_WAIT_TIMEOUT 5000
 
 namespace overlay {
 namespace utils {
 namespace token {
 
 std::string GeneratePipeName(DWORD pid);
+std::string GenerateLocalSocketPath(DWORD pid);
 
 }  // namespace token
 }  // namespace utils